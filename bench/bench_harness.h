@@ -0,0 +1,82 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include "bench_report.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// keeps the compiler from optimizing a value (and the work that produced it) away
+template<typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    volatile const char *sink = reinterpret_cast<volatile const char*>(&value);
+    (void)*sink;
+#endif
+}
+
+// makes the compiler assume all memory was read and written, so stores into output arrays can't be dropped
+inline void clobberMemory()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+// minimal microbenchmark runner: each case runs a few untimed warmup repetitions, then a number of timed ones; every
+// repetition processes `items` items and the summary is in nanoseconds per item
+class BenchHarness
+{
+public:
+    unsigned int Warmup;
+    unsigned int Repetitions;
+    BenchReport Report;
+
+    BenchHarness(const std::string &name, unsigned int warmup = 3, unsigned int repetitions = 15) : Warmup(warmup), Repetitions(repetitions)
+    {
+        Report.Benchmark = name;
+        std::printf("%-36s %10s %10s %10s %10s %8s\n", "case", "mean ns", "p50 ns", "min ns", "stddev", "items");
+    }
+
+    // runs one case and returns its summary; body is one repetition over all items
+    BenchStats run(const std::string &name, size_t items, const std::function<void()> &body)
+    {
+        for(unsigned int i = 0; i < Warmup; i++)
+        {
+            body();
+            clobberMemory();
+        }
+
+        std::vector<double> samples;
+        samples.reserve(Repetitions);
+        for(unsigned int i = 0; i < Repetitions; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            clobberMemory();
+            double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            samples.push_back(nanoseconds / items);
+        }
+
+        BenchStats stats = BenchStats::of(samples);
+        BenchRecord &record = Report.add(name);
+        record.set("items", static_cast<double>(items));
+        record.setStats("ns_per_item", stats);
+        std::printf("%-36s %10.3f %10.3f %10.3f %10.3f %8zu\n", name.c_str(), stats.mean, stats.p50, stats.min, stats.stddev, items);
+        return stats;
+    }
+
+    // adds a metric to the record of the case that ran last, e.g. the error against a reference
+    void annotate(const std::string &metric, double value)
+    {
+        if(!Report.Records.empty())
+            Report.Records.back().set(metric, value);
+    }
+};
+#endif
\ No newline at end of file
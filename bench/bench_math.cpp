@@ -0,0 +1,286 @@
+// math microbenchmarks: the glm calls the renderer makes per object and per camera (translate, rotate, lookAt, perspective,
+// the trig in Camera::updateCameraVectors), each one item at a time through glm ("scalar") and over structure of arrays
+// through BatchMath ("batched"). Batched cases also report their largest difference from the scalar results.
+// The transform cases compare glm against each path of TransformKernel, writing model + model-view-projection per object.
+//
+//   bench_math [--count N] [--warmup N] [--reps N] [--out file.json] [--baseline file.json] [--threshold 0.10]
+//
+// needs no window or GL context
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <math/batch_math.h>
+#include <math/transform_kernel.h>
+
+#include "bench_harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+const char *USAGE = "usage: bench_math [--count N] [--warmup N] [--reps N] [--out file.json] [--baseline file.json] [--threshold 0.10]";
+
+struct MathOptions
+{
+    size_t count = 1 << 18;
+    unsigned int warmup = 3;
+    unsigned int repetitions = 15;
+    std::string out = "bench_math.json";
+    std::string baseline;
+    double threshold = 0.10;
+};
+
+// the same random values as an array of structures for glm and as a structure of arrays for BatchMath
+struct Vec3Data
+{
+    std::vector<glm::vec3> aos;
+    std::vector<float> x, y, z;
+
+    void fill(size_t count, std::mt19937 &random, float low, float high)
+    {
+        std::uniform_real_distribution<float> value(low, high);
+        aos.resize(count);
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        for(size_t i = 0; i < count; i++)
+        {
+            aos[i] = glm::vec3(value(random), value(random), value(random));
+            x[i] = aos[i].x;
+            y[i] = aos[i].y;
+            z[i] = aos[i].z;
+        }
+    }
+
+    Vec3Arrays arrays() const
+    {
+        return Vec3Arrays{ x.data(), y.data(), z.data() };
+    }
+};
+
+bool parseOptions(int argc, char *argv[], MathOptions &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool valid = true;
+        if(arg == "--count" && hasValue)
+            valid = parseUnsigned(argv[++i], options.count);
+        else if(arg == "--warmup" && hasValue)
+            valid = parseUnsigned(argv[++i], options.warmup);
+        else if(arg == "--reps" && hasValue)
+            valid = parseUnsigned(argv[++i], options.repetitions);
+        else if(arg == "--out" && hasValue)
+            options.out = argv[++i];
+        else if(arg == "--baseline" && hasValue)
+            options.baseline = argv[++i];
+        else if(arg == "--threshold" && hasValue)
+            valid = parseDouble(argv[++i], options.threshold);
+        else
+        {
+            std::cout << "ERROR::BENCH::UNKNOWN_ARGUMENT " << arg << std::endl << USAGE << std::endl;
+            return false;
+        }
+        if(!valid)
+        {
+            std::cout << "ERROR::BENCH::BAD_VALUE " << arg << " " << argv[i] << std::endl << USAGE << std::endl;
+            return false;
+        }
+    }
+    if(options.count == 0 || options.repetitions == 0)
+    {
+        std::cout << "ERROR::BENCH::BAD_VALUE --count and --reps have to be at least 1" << std::endl << USAGE << std::endl;
+        return false;
+    }
+    return true;
+}
+
+float maxDifference(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b)
+{
+    float largest = 0.0f;
+    for(size_t i = 0; i < a.size(); i++)
+        for(int column = 0; column < 4; column++)
+            for(int row = 0; row < 4; row++)
+                largest = std::max(largest, std::fabs(a[i][column][row] - b[i][column][row]));
+    return largest;
+}
+
+float maxDifference(const std::vector<float> &a, const std::vector<float> &b)
+{
+    float largest = 0.0f;
+    for(size_t i = 0; i < a.size(); i++)
+        largest = std::max(largest, std::fabs(a[i] - b[i]));
+    return largest;
+}
+
+int main(int argc, char *argv[])
+{
+    MathOptions options;
+    if(!parseOptions(argc, argv, options))
+        return 2;
+    size_t n = options.count;
+
+    std::mt19937 random(42);
+    Vec3Data positions, axes, eyes, centers, ups;
+    positions.fill(n, random, -100.0f, 100.0f);
+    axes.fill(n, random, -1.0f, 1.0f);
+    eyes.fill(n, random, -50.0f, 50.0f);
+    centers.fill(n, random, -50.0f, 50.0f);
+    ups.fill(n, random, -0.1f, 0.1f);
+    for(size_t i = 0; i < n; i++)
+    {
+        // keep the up vectors well away from the view direction
+        ups.aos[i].y = ups.y[i] = 1.0f;
+    }
+    std::vector<float> angles(n), yaws(n), pitches(n), fovys(n), aspects(n);
+    std::uniform_real_distribution<float> angle(-10.0f, 10.0f), yaw(-360.0f, 360.0f), pitch(-89.0f, 89.0f), fovy(0.1f, 2.5f), aspect(0.5f, 2.5f);
+    for(size_t i = 0; i < n; i++)
+    {
+        angles[i] = angle(random);
+        yaws[i] = yaw(random);
+        pitches[i] = pitch(random);
+        fovys[i] = fovy(random);
+        aspects[i] = aspect(random);
+    }
+
+    std::vector<glm::mat4> scalarOut(n), batchedOut(n);
+    std::vector<float> sines(n), cosines(n), batchedSines(n), batchedCosines(n);
+    std::vector<float> vectorsOut(9 * n), batchedVectorsOut(9 * n);
+    const glm::mat4 identity(1.0f);
+    const glm::vec3 worldUp(0.0f, 1.0f, 0.0f);
+
+    BenchHarness bench("bench_math", options.warmup, options.repetitions);
+
+    bench.run("sincos/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            sines[i] = std::sin(angles[i]);
+            cosines[i] = std::cos(angles[i]);
+        }
+    });
+    bench.run("sincos/batched", n, [&]() { BatchMath::sinCos(angles.data(), batchedSines.data(), batchedCosines.data(), n); });
+    bench.annotate("max_error", std::max(maxDifference(sines, batchedSines), maxDifference(cosines, batchedCosines)));
+
+    bench.run("translate/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+            scalarOut[i] = glm::translate(identity, positions.aos[i]);
+    });
+    bench.run("translate/batched", n, [&]() { BatchMath::translate(positions.arrays(), batchedOut.data(), n); });
+    bench.annotate("max_error", maxDifference(scalarOut, batchedOut));
+
+    std::vector<float> zeros(n, 0.0f);
+    Vec3Arrays origin = { zeros.data(), zeros.data(), zeros.data() };
+    bench.run("rotate/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+            scalarOut[i] = glm::rotate(identity, angles[i], axes.aos[i]);
+    });
+    bench.run("rotate/batched", n, [&]() { BatchMath::translateRotate(origin, angles.data(), axes.arrays(), batchedOut.data(), n); });
+    bench.annotate("max_error", maxDifference(scalarOut, batchedOut));
+
+    // the per cube model matrix
+    bench.run("translate_rotate/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+            scalarOut[i] = glm::rotate(glm::translate(identity, positions.aos[i]), angles[i], axes.aos[i]);
+    });
+    bench.run("translate_rotate/batched", n, [&]() { BatchMath::translateRotate(positions.arrays(), angles.data(), axes.arrays(), batchedOut.data(), n); });
+    bench.annotate("max_error", maxDifference(scalarOut, batchedOut));
+
+    bench.run("look_at/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+            scalarOut[i] = glm::lookAt(eyes.aos[i], centers.aos[i], ups.aos[i]);
+    });
+    bench.run("look_at/batched", n, [&]() { BatchMath::lookAt(eyes.arrays(), centers.arrays(), ups.arrays(), batchedOut.data(), n); });
+    bench.annotate("max_error", maxDifference(scalarOut, batchedOut));
+
+    bench.run("perspective/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+            scalarOut[i] = glm::perspective(fovys[i], aspects[i], 0.1f, 100.0f);
+    });
+    bench.run("perspective/batched", n, [&]() { BatchMath::perspective(fovys.data(), aspects.data(), 0.1f, 100.0f, batchedOut.data(), n); });
+    bench.annotate("max_error", maxDifference(scalarOut, batchedOut));
+
+    // Camera::updateCameraVectors, outputs stored front/right/up as nine floats per camera for the scalar version
+    bench.run("camera_vectors/scalar", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            glm::vec3 front;
+            front.x = cos(glm::radians(yaws[i])) * cos(glm::radians(pitches[i]));
+            front.y = sin(glm::radians(pitches[i]));
+            front.z = sin(glm::radians(yaws[i])) * cos(glm::radians(pitches[i]));
+            front = glm::normalize(front);
+            glm::vec3 right = glm::normalize(glm::cross(front, worldUp));
+            glm::vec3 up = glm::normalize(glm::cross(right, front));
+            float *out = &vectorsOut[9 * i];
+            out[0] = front.x; out[1] = front.y; out[2] = front.z;
+            out[3] = right.x; out[4] = right.y; out[5] = right.z;
+            out[6] = up.x; out[7] = up.y; out[8] = up.z;
+        }
+    });
+    std::vector<float> soa(9 * n);
+    Vec3ArraysOut fronts = { &soa[0], &soa[n], &soa[2 * n] };
+    Vec3ArraysOut rights = { &soa[3 * n], &soa[4 * n], &soa[5 * n] };
+    Vec3ArraysOut upsOut = { &soa[6 * n], &soa[7 * n], &soa[8 * n] };
+    bench.run("camera_vectors/batched", n, [&]() { BatchMath::cameraVectors(yaws.data(), pitches.data(), worldUp, fronts, rights, upsOut, n); });
+    for(size_t i = 0; i < n; i++)
+        for(size_t component = 0; component < 9; component++)
+            batchedVectorsOut[9 * i + component] = soa[component * n + i];
+    bench.annotate("max_error", maxDifference(vectorsOut, batchedVectorsOut));
+
+    // model = translate * rotate * scale plus mvp, 32 floats per object like an instance buffer holding both
+    Vec3Data scales;
+    scales.fill(n, random, 0.5f, 2.0f);
+    std::vector<float> qx(n), qy(n), qz(n), qw(n);
+    TransformKernel::axisAngleToQuaternions(angles.data(), axes.arrays(), qx.data(), qy.data(), qz.data(), qw.data(), n);
+    TransformArrays transforms = { positions.arrays(), qx.data(), qy.data(), qz.data(), qw.data(), scales.arrays() };
+    glm::mat4 viewProjection = glm::perspective(0.8f, 1.6f, 0.1f, 100.0f) * glm::lookAt(glm::vec3(3.0f, 4.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<float> reference(32 * n), transformStorage(32 * n + 8);
+    // mapped buffers are at least 64 byte aligned, line the output up the same way
+    float *transformOut = transformStorage.data() + (32 - reinterpret_cast<uintptr_t>(transformStorage.data()) % 32) % 32 / sizeof(float);
+    bench.run("transform_mvp/glm", n, [&]()
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            glm::mat4 model = glm::scale(glm::rotate(glm::translate(identity, positions.aos[i]), angles[i], axes.aos[i]), scales.aos[i]);
+            glm::mat4 mvp = viewProjection * model;
+            std::copy(&model[0][0], &model[0][0] + 16, &reference[32 * i]);
+            std::copy(&mvp[0][0], &mvp[0][0] + 16, &reference[32 * i + 16]);
+        }
+    });
+    Transform_Isa best = TransformKernel::isa();
+    for(int path = TRANSFORM_SCALAR; path <= best; path++)
+    {
+        Transform_Isa isa = static_cast<Transform_Isa>(path);
+        bench.run(std::string("transform_mvp/") + TransformKernel::isaName(isa), n, [&]() { TransformKernel::compose(isa, transforms, n, transformOut, 32, &viewProjection); });
+        float largest = 0.0f;
+        for(size_t i = 0; i < 32 * n; i++)
+            largest = std::max(largest, std::fabs(reference[i] - transformOut[i]) / (1.0f + std::fabs(reference[i])));
+        bench.annotate("max_error", largest);
+    }
+
+    doNotOptimize(scalarOut.data());
+    doNotOptimize(batchedOut.data());
+
+    bench.Report.write(options.out);
+    std::cout << "results written to " << options.out << std::endl;
+
+    if(options.baseline.empty())
+        return 0;
+    BenchReport baseline;
+    if(!baseline.read(options.baseline))
+        return 2;
+    std::vector<BenchGate> gates = { { "ns_per_item_p50", options.threshold } };
+    int regressions = compareReports(bench.Report, baseline, gates);
+    std::cout << regressions << " regression(s) against " << options.baseline << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
\ No newline at end of file
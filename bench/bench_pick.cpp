@@ -0,0 +1,180 @@
+// picking benchmark: a grid of randomly rotated cubes under a Bvh, and random pixels of a camera looking into it picked
+// through ScenePicker. Reports the time to build and refit the tree and the time per pick (plus picks per second),
+// and checks a few picks against a linear scan over every cube, which is also timed for comparison.
+//
+//   bench_pick [--count N] [--picks N] [--warmup N] [--reps N] [--out file.json] [--baseline file.json] [--threshold 0.10]
+//
+// needs no window or GL context
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <camera/camera.h>
+#include <scene/bvh.h>
+#include <scene/picking.h>
+
+#include "bench_harness.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// spacing between cube centres in the generated grid, and how many picks the linear scan gets (it is slow)
+const float CUBE_SPACING = 3.0f;
+const size_t LINEAR_PICKS = 16;
+const char *USAGE = "usage: bench_pick [--count N] [--picks N] [--warmup N] [--reps N] [--out file.json] [--baseline file.json] [--threshold 0.10]";
+
+struct PickOptions
+{
+    size_t count = 1000000;
+    size_t picks = 100000;
+    unsigned int warmup = 3;
+    unsigned int repetitions = 15;
+    std::string out = "bench_pick.json";
+    std::string baseline;
+    double threshold = 0.10;
+};
+
+bool parseOptions(int argc, char *argv[], PickOptions &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool valid = true;
+        if(arg == "--count" && hasValue)
+            valid = parseUnsigned(argv[++i], options.count);
+        else if(arg == "--picks" && hasValue)
+            valid = parseUnsigned(argv[++i], options.picks);
+        else if(arg == "--warmup" && hasValue)
+            valid = parseUnsigned(argv[++i], options.warmup);
+        else if(arg == "--reps" && hasValue)
+            valid = parseUnsigned(argv[++i], options.repetitions);
+        else if(arg == "--out" && hasValue)
+            options.out = argv[++i];
+        else if(arg == "--baseline" && hasValue)
+            options.baseline = argv[++i];
+        else if(arg == "--threshold" && hasValue)
+            valid = parseDouble(argv[++i], options.threshold);
+        else
+        {
+            std::cout << "ERROR::BENCH::UNKNOWN_ARGUMENT " << arg << std::endl << USAGE << std::endl;
+            return false;
+        }
+        if(!valid)
+        {
+            std::cout << "ERROR::BENCH::BAD_VALUE " << arg << " " << argv[i] << std::endl << USAGE << std::endl;
+            return false;
+        }
+    }
+    if(options.count == 0 || options.picks == 0 || options.repetitions == 0)
+    {
+        std::cout << "ERROR::BENCH::BAD_VALUE --count, --picks and --reps have to be at least 1" << std::endl << USAGE << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the nearest cube along the ray by testing every one of them
+BvhHit pickLinear(const std::vector<glm::mat4> &models, const Aabb &localBox, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+{
+    BvhHit hit = { Bvh::NO_OBJECT, maxDistance };
+    for(size_t i = 0; i < models.size(); i++)
+    {
+        float distance = ScenePicker::rayOrientedBox(models[i], localBox, origin, direction);
+        if(distance >= 0.0f && distance <= hit.distance)
+        {
+            hit.object = static_cast<uint32_t>(i);
+            hit.distance = distance;
+        }
+    }
+    return hit;
+}
+
+int main(int argc, char *argv[])
+{
+    PickOptions options;
+    if(!parseOptions(argc, argv, options))
+        return 2;
+    size_t n = options.count;
+
+    // cubes on a grid, each turned some random way
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f), axis(-1.0f, 1.0f), unit(0.0f, 1.0f);
+    const Aabb localBox(glm::vec3(-0.5f), glm::vec3(0.5f));
+    size_t side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(n))));
+    std::vector<glm::mat4> models(n);
+    std::vector<Aabb> boxes(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        glm::vec3 position(static_cast<float>(i % side), static_cast<float>(i / side % side), -static_cast<float>(i / (side * side)));
+        glm::vec3 rotationAxis(axis(random), axis(random), axis(random) + 2.0f);
+        models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position * CUBE_SPACING), angle(random), rotationAxis);
+        boxes[i] = Aabb::transformed(models[i], localBox);
+    }
+
+    // looking down the grid from in front of it, far enough back to see all of it
+    float extent = side * CUBE_SPACING;
+    Camera camera(glm::vec3(extent * 0.5f, extent * 0.5f, extent * 0.75f));
+    camera.SetPerspective(16.0f / 9.0f, 0.1f, extent * 4.0f);
+    const float width = 1920.0f, height = 1080.0f;
+    std::vector<glm::vec2> pixels(options.picks);
+    for(glm::vec2 &pixel : pixels)
+        pixel = glm::vec2(unit(random) * width, unit(random) * height);
+
+    BenchHarness bench("bench_pick", options.warmup, options.repetitions);
+
+    Bvh bvh;
+    bench.run("bvh/build", n, [&]() { bvh.build(boxes); });
+    bench.annotate("nodes", static_cast<double>(bvh.nodeCount()));
+    bench.run("bvh/refit", n, [&]() { bvh.refit(boxes); });
+
+    size_t hits = 0;
+    std::vector<BvhHit> results(options.picks);
+    BenchStats picks = bench.run("pick/bvh", options.picks, [&]()
+    {
+        hits = 0;
+        for(size_t i = 0; i < pixels.size(); i++)
+        {
+            if(ScenePicker::pick(bvh, camera, pixels[i].x, pixels[i].y, width, height, models.data(), localBox, results[i]))
+                hits++;
+        }
+    });
+    bench.annotate("picks_per_second", picks.mean > 0.0 ? 1.0e9 / picks.mean : 0.0);
+    bench.annotate("hit_rate", static_cast<double>(hits) / options.picks);
+
+    // the same first few picks by brute force, which has to agree with the tree
+    size_t linearPicks = std::min(LINEAR_PICKS, pixels.size());
+    std::vector<BvhHit> reference(linearPicks);
+    bench.run("pick/linear", linearPicks, [&]()
+    {
+        for(size_t i = 0; i < linearPicks; i++)
+        {
+            glm::vec3 origin, direction;
+            camera.GetRay(pixels[i].x / width * 2.0f - 1.0f, 1.0f - pixels[i].y / height * 2.0f, origin, direction);
+            reference[i] = pickLinear(models, localBox, origin, direction, camera.FarPlane);
+        }
+    });
+    size_t mismatches = 0;
+    for(size_t i = 0; i < linearPicks; i++)
+    {
+        if(reference[i].object != results[i].object && std::fabs(reference[i].distance - results[i].distance) > 1.0e-4f)
+            mismatches++;
+    }
+    bench.annotate("mismatches", static_cast<double>(mismatches));
+    std::cout << hits << " of " << options.picks << " picks hit a cube, " << mismatches << " of " << linearPicks << " differ from the linear scan" << std::endl;
+
+    bench.Report.write(options.out);
+    std::cout << "results written to " << options.out << std::endl;
+
+    if(options.baseline.empty())
+        return mismatches > 0 ? 1 : 0;
+    BenchReport baseline;
+    if(!baseline.read(options.baseline))
+        return 2;
+    std::vector<BenchGate> gates = { { "ns_per_item_p50", options.threshold } };
+    int regressions = compareReports(bench.Report, baseline, gates);
+    std::cout << regressions << " regression(s) against " << options.baseline << std::endl;
+    return regressions > 0 || mismatches > 0 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,296 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// summary of a set of timing samples
+struct BenchStats
+{
+    double mean;
+    double stddev;
+    double min;
+    double p50;
+    double p95;
+    double max;
+
+    static BenchStats of(std::vector<double> samples)
+    {
+        BenchStats stats = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+        if(samples.empty())
+            return stats;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for(double sample : samples)
+            sum += sample;
+        stats.mean = sum / samples.size();
+        double squares = 0.0;
+        for(double sample : samples)
+            squares += (sample - stats.mean) * (sample - stats.mean);
+        stats.stddev = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0.0;
+        stats.min = samples.front();
+        stats.max = samples.back();
+        stats.p50 = percentile(samples, 0.50);
+        stats.p95 = percentile(samples, 0.95);
+        return stats;
+    }
+
+    // nearest rank on already sorted samples
+    static double percentile(const std::vector<double> &sorted, double fraction)
+    {
+        size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+};
+
+// one row of results: a name plus numeric metrics, in the order they were added
+struct BenchRecord
+{
+    std::string name;
+    std::vector<std::pair<std::string, double>> metrics;
+
+    void set(const std::string &metric, double value)
+    {
+        for(auto &entry : metrics)
+        {
+            if(entry.first == metric)
+            {
+                entry.second = value;
+                return;
+            }
+        }
+        metrics.push_back(std::make_pair(metric, value));
+    }
+
+    void setStats(const std::string &prefix, const BenchStats &stats)
+    {
+        set(prefix + "_mean", stats.mean);
+        set(prefix + "_stddev", stats.stddev);
+        set(prefix + "_min", stats.min);
+        set(prefix + "_p50", stats.p50);
+        set(prefix + "_p95", stats.p95);
+        set(prefix + "_max", stats.max);
+    }
+
+    // returns false if the metric isn't there
+    bool get(const std::string &metric, double &value) const
+    {
+        for(const auto &entry : metrics)
+        {
+            if(entry.first == metric)
+            {
+                value = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// results files look like {"benchmark": "...", "records": [{"name": "...", "metric": 1.0, ...}, ...]}.
+// the reader only understands what the writer produces, it isn't a general JSON parser
+class BenchReport
+{
+public:
+    std::string Benchmark;
+    std::vector<BenchRecord> Records;
+
+    BenchRecord &add(const std::string &name)
+    {
+        Records.push_back(BenchRecord());
+        Records.back().name = name;
+        return Records.back();
+    }
+
+    const BenchRecord *find(const std::string &name) const
+    {
+        for(const BenchRecord &record : Records)
+        {
+            if(record.name == name)
+                return &record;
+        }
+        return nullptr;
+    }
+
+    bool write(const std::string &path) const
+    {
+        std::ofstream file(path);
+        if(!file)
+        {
+            std::cout << "ERROR::BENCH::FILE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        file << "{\n  \"benchmark\": \"" << Benchmark << "\",\n  \"records\": [";
+        for(size_t i = 0; i < Records.size(); i++)
+        {
+            file << (i ? ",\n" : "\n") << "    {\"name\": \"" << Records[i].name << "\"";
+            for(const auto &metric : Records[i].metrics)
+                file << ", \"" << metric.first << "\": " << number(metric.second);
+            file << "}";
+        }
+        file << "\n  ]\n}\n";
+        return true;
+    }
+
+    bool read(const std::string &path)
+    {
+        std::ifstream file(path);
+        if(!file)
+        {
+            std::cout << "ERROR::BENCH::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        std::string text = stream.str();
+
+        Records.clear();
+        size_t pos = 0;
+        std::string key;
+        if(findString(text, pos, key) && key == "benchmark")
+            findString(text, pos, Benchmark);
+        pos = text.find('[', pos);
+        if(pos == std::string::npos)
+        {
+            std::cout << "ERROR::BENCH::BAD_RESULTS_FILE " << path << std::endl;
+            return false;
+        }
+        for(size_t open = text.find('{', pos); open != std::string::npos; open = text.find('{', pos))
+        {
+            size_t close = text.find('}', open);
+            if(close == std::string::npos)
+                break;
+            BenchRecord record;
+            size_t field = open;
+            while(findString(text, field, key) && field < close)
+            {
+                size_t colon = text.find(':', field);
+                if(key == "name")
+                {
+                    field = colon + 1;
+                    findString(text, field, record.name);
+                }
+                else
+                {
+                    record.set(key, std::strtod(text.c_str() + colon + 1, nullptr));
+                    field = colon + 1;
+                }
+            }
+            Records.push_back(record);
+            pos = close + 1;
+        }
+        return true;
+    }
+
+private:
+    static std::string number(double value)
+    {
+        if(!std::isfinite(value))
+            return "0";
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+
+    // reads the next quoted string starting at pos and moves pos past it
+    static bool findString(const std::string &text, size_t &pos, std::string &out)
+    {
+        size_t open = text.find('"', pos);
+        if(open == std::string::npos)
+            return false;
+        size_t close = text.find('"', open + 1);
+        if(close == std::string::npos)
+            return false;
+        out = text.substr(open + 1, close - open - 1);
+        pos = close + 1;
+        return true;
+    }
+};
+
+// a metric where bigger is worse, and how much worse (as a fraction of the baseline) is still acceptable
+struct BenchGate
+{
+    std::string metric;
+    double threshold;
+};
+
+// compares every record of current against the baseline record with the same name and prints a line per gated metric.
+// returns the number of regressions
+inline int compareReports(const BenchReport &current, const BenchReport &baseline, const std::vector<BenchGate> &gates)
+{
+    int regressions = 0;
+    for(const BenchRecord &record : current.Records)
+    {
+        const BenchRecord *base = baseline.find(record.name);
+        if(!base)
+        {
+            std::cout << record.name << ": not in baseline, skipped" << std::endl;
+            continue;
+        }
+        for(const BenchGate &gate : gates)
+        {
+            double now, before;
+            if(!record.get(gate.metric, now) || !base->get(gate.metric, before))
+                continue;
+            double change = before > 0.0 ? (now - before) / before : 0.0;
+            bool regressed = change > gate.threshold;
+            regressions += regressed;
+            std::printf("%-24s %-16s %12.4f -> %12.4f  %+7.1f%%  %s\n", record.name.c_str(), gate.metric.c_str(), before, now, change * 100.0, regressed ? "REGRESSION" : "ok");
+        }
+    }
+    return regressions;
+}
+// checked parsing of command line values: true only if all of text is a number that fits, so "--frames abc" is reported
+// as a bad value instead of throwing or quietly turning into 0
+template<typename T>
+inline bool parseUnsigned(const char *text, T &value)
+{
+    // strtoull skips blanks and takes "-1" as a huge number, so insist on a digit up front
+    if(!std::isdigit(static_cast<unsigned char>(text[0])))
+        return false;
+    char *end;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if(*end != '\0' || errno == ERANGE || parsed > std::numeric_limits<T>::max())
+        return false;
+    value = static_cast<T>(parsed);
+    return true;
+}
+
+inline bool parseInt(const char *text, int &value)
+{
+    if(text[0] == '\0' || std::isspace(static_cast<unsigned char>(text[0])))
+        return false;
+    char *end;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    if(*end != '\0' || errno == ERANGE || parsed < std::numeric_limits<int>::min() || parsed > std::numeric_limits<int>::max())
+        return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+inline bool parseDouble(const char *text, double &value)
+{
+    if(text[0] == '\0' || std::isspace(static_cast<unsigned char>(text[0])))
+        return false;
+    char *end;
+    errno = 0;
+    double parsed = std::strtod(text, &end);
+    if(*end != '\0' || errno == ERANGE || !std::isfinite(parsed))
+        return false;
+    value = parsed;
+    return true;
+}
+#endif
\ No newline at end of file
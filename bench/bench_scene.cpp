@@ -0,0 +1,494 @@
+// scene benchmark: procedural cube scenes of increasing size pushed through the real render path (culling, render queue,
+// command buffers, state cache) into an offscreen framebuffer. Per scene it records CPU and GPU frame times, draw calls,
+// driver calls and memory to a JSON file, and can compare the run against a stored baseline.
+// --instanced swaps the render queue for one instanced draw fed by TransformKernel through a mapped instance buffer.
+//
+//   bench_scene [--frames N] [--warmup N] [--counts 1000,10000,...] [--out file.json] [--instanced]
+//               [--baseline file.json] [--threshold 0.10] [--width W] [--height H]
+//
+// with --baseline the exit code is non zero if any gated metric got worse by more than the threshold (0.10 = 10%)
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <shaders/shader.h>
+#include <shaders/shader_preprocessor.h>
+#include <camera/camera.h>
+#include <renderer/gl_state.h>
+#include <renderer/render_queue.h>
+#include <renderer/late_latch.h>
+#include <renderer/instance_buffer.h>
+#include <math/transform_kernel.h>
+#include <threading/thread_pool.h>
+
+#include "bench_report.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const unsigned int DEFAULT_COUNTS[] = { 1000, 10000, 100000, 1000000 };
+const unsigned int QUERY_RING = 4;
+// spacing between cube centres in the generated grid
+const float CUBE_SPACING = 3.0f;
+// cubes per partition when their draws are recorded across the thread pool
+const size_t RECORD_PARTITION_SIZE = 1024;
+const char *USAGE = "usage: bench_scene [--frames N] [--warmup N] [--counts 1000,10000,...] [--out file.json] [--instanced]\n"
+    "                   [--baseline file.json] [--threshold 0.10] [--width W] [--height H]";
+
+struct BenchOptions
+{
+    unsigned int frames = 120;
+    unsigned int warmup = 10;
+    std::vector<unsigned int> counts;
+    std::string out = "bench_scene.json";
+    std::string baseline;
+    double threshold = 0.10;
+    int width = 1280;
+    int height = 720;
+    bool instanced = false;
+};
+
+// one generated scene; positions and spin never change, the model matrices are rebuilt every frame like the app does
+struct BenchScene
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> axes;
+    std::vector<float> speeds;
+    float extent;
+
+    // the same as structure of arrays for the instanced path, plus per frame scratch
+    std::vector<float> x, y, z, axisX, axisY, axisZ, ones;
+    std::vector<float> angles, qx, qy, qz, qw;
+};
+
+GLStateCache glState;
+RenderQueue renderQueue;
+CameraUniformRing cameraUniforms;
+InstanceBufferRing instanceBuffer;
+// created in main(), so no threads start during static initialization
+ThreadPool *threadPool = nullptr;
+
+bool parseOptions(int argc, char *argv[], BenchOptions &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool valid = true;
+        if(arg == "--frames" && hasValue)
+            valid = parseUnsigned(argv[++i], options.frames);
+        else if(arg == "--warmup" && hasValue)
+            valid = parseUnsigned(argv[++i], options.warmup);
+        else if(arg == "--out" && hasValue)
+            options.out = argv[++i];
+        else if(arg == "--baseline" && hasValue)
+            options.baseline = argv[++i];
+        else if(arg == "--threshold" && hasValue)
+            valid = parseDouble(argv[++i], options.threshold);
+        else if(arg == "--width" && hasValue)
+            valid = parseInt(argv[++i], options.width) && options.width > 0;
+        else if(arg == "--height" && hasValue)
+            valid = parseInt(argv[++i], options.height) && options.height > 0;
+        else if(arg == "--instanced")
+            options.instanced = true;
+        else if(arg == "--counts" && hasValue)
+        {
+            std::stringstream list(argv[++i]);
+            std::string count;
+            while(valid && std::getline(list, count, ','))
+            {
+                unsigned int parsed = 0;
+                valid = parseUnsigned(count.c_str(), parsed) && parsed > 0;
+                options.counts.push_back(parsed);
+            }
+        }
+        else
+        {
+            std::cout << "ERROR::BENCH::UNKNOWN_ARGUMENT " << arg << std::endl << USAGE << std::endl;
+            return false;
+        }
+        if(!valid)
+        {
+            std::cout << "ERROR::BENCH::BAD_VALUE " << arg << " " << argv[i] << std::endl << USAGE << std::endl;
+            return false;
+        }
+    }
+    if(options.counts.empty())
+        options.counts.assign(std::begin(DEFAULT_COUNTS), std::end(DEFAULT_COUNTS));
+    return true;
+}
+
+// cubes on a jittered grid filling a box around the origin, same seed every run
+BenchScene generateScene(unsigned int count)
+{
+    BenchScene scene;
+    unsigned int side = static_cast<unsigned int>(std::ceil(std::cbrt(static_cast<double>(count))));
+    scene.extent = side * CUBE_SPACING * 0.5f;
+
+    std::mt19937 random(count);
+    std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> speed(0.2f, 2.0f);
+    scene.positions.reserve(count);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        unsigned int x = i % side, y = (i / side) % side, z = i / (side * side);
+        glm::vec3 cell = glm::vec3(x, y, z) * CUBE_SPACING - glm::vec3(scene.extent);
+        scene.positions.push_back(cell + glm::vec3(jitter(random), jitter(random), jitter(random)));
+        glm::vec3 axis(unit(random), unit(random), unit(random));
+        scene.axes.push_back(glm::length(axis) > 0.001f ? glm::normalize(axis) : glm::vec3(0.0f, 1.0f, 0.0f));
+        scene.speeds.push_back(speed(random));
+
+        scene.x.push_back(scene.positions[i].x);
+        scene.y.push_back(scene.positions[i].y);
+        scene.z.push_back(scene.positions[i].z);
+        scene.axisX.push_back(scene.axes[i].x);
+        scene.axisY.push_back(scene.axes[i].y);
+        scene.axisZ.push_back(scene.axes[i].z);
+    }
+    scene.ones.assign(count, 1.0f);
+    scene.angles.resize(count);
+    scene.qx.resize(count);
+    scene.qy.resize(count);
+    scene.qz.resize(count);
+    scene.qw.resize(count);
+    return scene;
+}
+
+unsigned int createCube()
+{
+    float vertices[] = {
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,   0.5f, -0.5f, -0.5f,  1.0f, 0.0f,   0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+         0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,  -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,   0.5f, -0.5f,  0.5f,  1.0f, 0.0f,   0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 1.0f,  -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,  -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,  -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,  -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,  -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,   0.5f,  0.5f, -0.5f,  1.0f, 1.0f,   0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+         0.5f, -0.5f, -0.5f,  0.0f, 1.0f,   0.5f, -0.5f,  0.5f,  0.0f, 0.0f,   0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,   0.5f, -0.5f, -0.5f,  1.0f, 1.0f,   0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 0.0f,  -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,  -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,   0.5f,  0.5f, -0.5f,  1.0f, 1.0f,   0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 0.0f,  -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,  -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+    };
+
+    unsigned int VBO, VAO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glState.bindVertexArray(VAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    return VAO;
+}
+
+// 1x1 white, the benchmark is about the render path rather than texture sampling
+unsigned int createTexture()
+{
+    unsigned char white[4] = { 255, 255, 255, 255 };
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glState.bindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+// colour + depth target so nothing depends on the window being shown or its size
+unsigned int createFramebuffer(int width, int height)
+{
+    unsigned int framebuffer, color, depth;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::BENCH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+    glViewport(0, 0, width, height);
+    return framebuffer;
+}
+
+// resident and peak resident set size in MB, from /proc (0 where that doesn't exist)
+void readMemory(double &residentMB, double &peakMB)
+{
+    residentMB = 0.0;
+    peakMB = 0.0;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+    {
+        if(line.compare(0, 6, "VmRSS:") == 0)
+            residentMB = std::strtod(line.c_str() + 6, nullptr) / 1024.0;
+        else if(line.compare(0, 6, "VmHWM:") == 0)
+            peakMB = std::strtod(line.c_str() + 6, nullptr) / 1024.0;
+    }
+}
+
+// drops the process's peak resident size back to what is resident now, so the next readMemory() peak belongs to whatever
+// ran in between and not to the heaviest scene so far. False where the kernel can't do that
+bool resetPeakMemory()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return static_cast<bool>(clearRefs);
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runScene(unsigned int count, const BenchOptions &options, const Shader &shader, unsigned int cubeVAO, unsigned int texture, BenchReport &report)
+{
+    // the scene's memory is measured from here, before it is generated
+    double residentBeforeMB, peakBeforeMB;
+    bool peakReset = resetPeakMemory();
+    readMemory(residentBeforeMB, peakBeforeMB);
+    BenchScene scene = generateScene(count);
+
+    // standing in the middle of the scene and turning once around over the run, so culling has real work to do
+    Camera camera(glm::vec3(0.0f));
+    camera.SetPerspective(static_cast<float>(options.width) / options.height, 0.1f, scene.extent * 2.0f);
+    float turnPerFrame = 360.0f / options.frames / camera.MouseSensitivity;
+
+    unsigned int queries[QUERY_RING];
+    glGenQueries(QUERY_RING, queries);
+    unsigned int queriesIssued = 0;
+
+    std::vector<double> cpuTimes, frameTimes, gpuTimes;
+    double drawCalls = 0.0, driverCalls = 0.0;
+    auto collectQuery = [&](unsigned int index)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[index % QUERY_RING], GL_QUERY_RESULT, &elapsed);
+        if(index >= options.warmup)
+            gpuTimes.push_back(elapsed / 1.0e6);
+    };
+
+    unsigned int totalFrames = options.warmup + options.frames;
+    auto frameStart = std::chrono::steady_clock::now();
+    for(unsigned int frame = 0; frame < totalFrames; frame++)
+    {
+        // reusing a query object means waiting for the frame that used it QUERY_RING frames ago
+        if(frame >= QUERY_RING)
+            collectQuery(frame - QUERY_RING);
+
+        auto cpuStart = std::chrono::steady_clock::now();
+        if(frame >= options.warmup)
+            camera.ProcessMouseMovement(turnPerFrame, 0.0f);
+        float time = frame / 60.0f;
+
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame % QUERY_RING]);
+        queriesIssued++;
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shader.use(glState);
+        cameraUniforms.beginFrame();
+        cameraUniforms.write(camera.GetViewMatrix(), camera.GetProjectionMatrix(), glState);
+
+        unsigned int frameDraws;
+        if(options.instanced)
+        {
+            // everything in one draw, the GPU clips what is off screen
+            for(unsigned int i = 0; i < count; i++)
+                scene.angles[i] = time * scene.speeds[i];
+            TransformKernel::axisAngleToQuaternions(scene.angles.data(), Vec3Arrays{ scene.axisX.data(), scene.axisY.data(), scene.axisZ.data() },
+                scene.qx.data(), scene.qy.data(), scene.qz.data(), scene.qw.data(), count);
+            TransformArrays transforms = { Vec3Arrays{ scene.x.data(), scene.y.data(), scene.z.data() }, scene.qx.data(), scene.qy.data(), scene.qz.data(), scene.qw.data(),
+                Vec3Arrays{ scene.ones.data(), scene.ones.data(), scene.ones.data() } };
+            TransformKernel::compose(transforms, count, instanceBuffer.beginFrame());
+
+            glState.bindVertexArray(cubeVAO);
+            glState.bindTexture(0, GL_TEXTURE_2D, texture);
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, count, instanceBuffer.baseInstance());
+            instanceBuffer.endFrame();
+            frameDraws = 1;
+        }
+        else
+        {
+            // culling, transforms and sort keys are recorded across the pool, the partitions only read the camera
+            renderQueue.clear();
+            camera.GetFrustumPlanes();
+            renderQueue.submitPartitioned(count, RECORD_PARTITION_SIZE, threadPool, [&](std::vector<DrawItem> &bucket, size_t, size_t begin, size_t end)
+            {
+                for(size_t i = begin; i < end; i++)
+                {
+                    if(!camera.IsSphereVisible(scene.positions[i], 0.87f))
+                        continue;
+                    glm::mat4 model = glm::translate(glm::mat4(1.0f), scene.positions[i]);
+                    model = glm::rotate(model, time * scene.speeds[i], scene.axes[i]);
+                    float depth = glm::length(scene.positions[i] - camera.Position);
+                    DrawItem item = { SortKey::make(PASS_WORLD, false, shader.ID, 0, texture, depth, camera.NearPlane, camera.FarPlane), shader.ID, cubeVAO, texture, GL_TRIANGLES, 0, 36, model, 0, 0 };
+                    bucket.push_back(item);
+                }
+            });
+            renderQueue.flush(glState, threadPool);
+            frameDraws = static_cast<unsigned int>(renderQueue.size());
+        }
+        cameraUniforms.endFrame();
+        glEndQuery(GL_TIME_ELAPSED);
+        double cpuTime = millisecondsSince(cpuStart);
+
+        // nothing is presented, flushing keeps the driver from batching frames up indefinitely
+        glFlush();
+        double frameTime = millisecondsSince(frameStart);
+        frameStart = std::chrono::steady_clock::now();
+
+        if(frame >= options.warmup)
+        {
+            cpuTimes.push_back(cpuTime);
+            frameTimes.push_back(frameTime);
+            drawCalls += frameDraws;
+            driverCalls += glState.issuedCalls();
+        }
+        glState.resetFrameCounters();
+    }
+    for(unsigned int index = queriesIssued > QUERY_RING ? queriesIssued - QUERY_RING : 0; index < queriesIssued; index++)
+        collectQuery(index);
+    glDeleteQueries(QUERY_RING, queries);
+
+    double residentMB, peakMB;
+    readMemory(residentMB, peakMB);
+    // without the reset the process peak would carry over from earlier scenes, the larger of the two samples is the
+    // best per scene figure left
+    if(!peakReset)
+        peakMB = std::max(residentBeforeMB, residentMB);
+
+    BenchRecord &record = report.add((options.instanced ? "instanced_cubes_" : "cubes_") + std::to_string(count));
+    record.set("instances", count);
+    record.set("frames", options.frames);
+    record.setStats("cpu_ms", BenchStats::of(cpuTimes));
+    record.setStats("frame_ms", BenchStats::of(frameTimes));
+    record.setStats("gpu_ms", BenchStats::of(gpuTimes));
+    record.set("draw_calls", drawCalls / options.frames);
+    record.set("gl_calls", driverCalls / options.frames);
+    record.set("rss_mb", residentMB);
+    record.set("rss_delta_mb", residentMB - residentBeforeMB);
+    record.set("peak_rss_mb", peakMB);
+
+    double value = 0.0;
+    record.get("cpu_ms_mean", value);
+    std::cout << record.name << ": cpu " << value << " ms";
+    record.get("gpu_ms_mean", value);
+    std::cout << ", gpu " << value << " ms, " << drawCalls / options.frames << " draws/frame, rss " << residentMB << " MB" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    if(!parseOptions(argc, argv, options))
+        return 2;
+    if(options.frames == 0)
+    {
+        std::cout << "ERROR::BENCH::BAD_VALUE --frames 0" << std::endl << USAGE << std::endl;
+        return 2;
+    }
+
+    ThreadPool pool;
+    threadPool = &pool;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(options.width, options.height, "bench_scene", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 2;
+    }
+    glfwMakeContextCurrent(window);
+    // never wait for a display
+    glfwSwapInterval(0);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 2;
+    }
+
+    createFramebuffer(options.width, options.height);
+    glState.enable(GL_DEPTH_TEST);
+    cameraUniforms.create(glState);
+
+    ShaderDefines defines;
+    if(options.instanced)
+        defines.push_back(ShaderDefine{ "INSTANCED", "" });
+    ExpandedSource vertex = ShaderPreprocessor::expand("../include/shaders/cube_shader.vs", defines);
+    ExpandedSource fragment = ShaderPreprocessor::expand("../include/shaders/cube_shader.fs", defines);
+    Shader shader;
+    if(!vertex.ok || !fragment.ok || !shader.build(vertex.code, fragment.code))
+    {
+        glfwTerminate();
+        return 2;
+    }
+    shader.use(glState);
+    shader.setInt("texture1", 0);
+    unsigned int cubeVAO = createCube();
+    unsigned int texture = createTexture();
+    if(options.instanced)
+    {
+        unsigned int largest = *std::max_element(options.counts.begin(), options.counts.end());
+        instanceBuffer.create(glState, largest);
+        instanceBuffer.attachMatrix(glState, cubeVAO, 2);
+        std::cout << "instanced, transforms on the " << TransformKernel::isaName(TransformKernel::isa()) << " path" << std::endl;
+    }
+
+    BenchReport report;
+    report.Benchmark = "bench_scene";
+    for(unsigned int count : options.counts)
+        runScene(count, options, shader, cubeVAO, texture, report);
+    report.write(options.out);
+    std::cout << "results written to " << options.out << std::endl;
+
+    int regressions = 0;
+    if(!options.baseline.empty())
+    {
+        BenchReport baseline;
+        if(!baseline.read(options.baseline))
+        {
+            glfwTerminate();
+            return 2;
+        }
+        std::vector<BenchGate> gates = {
+            { "cpu_ms_mean", options.threshold },
+            { "cpu_ms_p95", options.threshold },
+            { "gpu_ms_mean", options.threshold },
+            { "frame_ms_mean", options.threshold },
+            { "draw_calls", options.threshold },
+            { "gl_calls", options.threshold },
+            { "peak_rss_mb", options.threshold }
+        };
+        regressions = compareReports(report, baseline, gates);
+        std::cout << regressions << " regression(s) against " << options.baseline << std::endl;
+    }
+
+    glfwTerminate();
+    return regressions > 0 ? 1 : 0;
+}
\ No newline at end of file
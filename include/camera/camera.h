@@ -19,8 +19,23 @@ const float PITCH = 0.0f;
 const float SPEED = 2.5f;
 const float SENSITIVITY = 0.05f;
 const float ZOOM = 45.0F;
+const float ASPECT_RATIO = 800.0f / 600.0f;
+const float NEAR_CLIP = 0.1f;
+const float FAR_CLIP = 100.0f;
 
-// an abstract camera class that processes input and calculates the corresponding Euler angles, Vectors and Matrices for use in OpenGL
+// indices into the frustum planes returned by GetFrustumPlanes
+enum Frustum_Plane {
+    PLANE_LEFT,
+    PLANE_RIGHT,
+    PLANE_BOTTOM,
+    PLANE_TOP,
+    PLANE_NEAR,
+    PLANE_FAR
+};
+
+// an abstract camera class that processes input and calculates the corresponding Euler angles, Vectors and Matrices for use in OpenGL.
+// the view, projection, view-projection (and its inverse) and frustum planes are cached and only rebuilt when something they
+// depend on changed; if you write to the public attributes directly call Invalidate() afterwards
 class Camera
 {
 public:
@@ -37,9 +52,13 @@ public:
     float MovementSpeed;
     float MouseSensitivity;
     float Zoom;
+    // projection options
+    float AspectRatio;
+    float NearPlane;
+    float FarPlane;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)),  MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)),  MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), AspectRatio(ASPECT_RATIO), NearPlane(NEAR_CLIP), FarPlane(FAR_CLIP)
     {
         Position = position;
         WorldUp = up;
@@ -49,7 +68,7 @@ public:
     
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM), AspectRatio(ASPECT_RATIO), NearPlane(NEAR_CLIP), FarPlane(FAR_CLIP)
     {
         Position = glm::vec3(posX, posY, posZ);
         WorldUp = glm::vec3(upX, upY, upZ);
@@ -60,9 +79,90 @@ public:
     }
 
     // returns the view matrix caculated using Euler angles and the LookAt matrix
-    glm::mat4 GetViewMatrix()
+    const glm::mat4 &GetViewMatrix()
+    {
+        update();
+        return view;
+    }
+
+    const glm::mat4 &GetProjectionMatrix()
+    {
+        update();
+        return projection;
+    }
+
+    // projection * view
+    const glm::mat4 &GetViewProjectionMatrix()
+    {
+        update();
+        return viewProjection;
+    }
+
+    // maps clip space back to world space, used for unprojecting the cursor
+    const glm::mat4 &GetInverseViewProjectionMatrix()
+    {
+        update();
+        return inverseViewProjection;
+    }
+
+    // world space ray through a point in normalized device coordinates (-1 to 1, y up), starting on the near plane.
+    // direction is normalized
+    void GetRay(float ndcX, float ndcY, glm::vec3 &origin, glm::vec3 &direction)
+    {
+        update();
+        glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+        glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+        origin = glm::vec3(nearPoint) / nearPoint.w;
+        direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    }
+
+    // six normalized world space planes (see Frustum_Plane), pointing inwards
+    const glm::vec4 *GetFrustumPlanes()
+    {
+        update();
+        return frustumPlanes;
+    }
+
+    // true if any part of the sphere is inside the view frustum
+    bool IsSphereVisible(const glm::vec3 &center, float radius)
+    {
+        update();
+        for(unsigned int i = 0; i < 6; i++)
+        {
+            if(glm::dot(glm::vec3(frustumPlanes[i]), center) + frustumPlanes[i].w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // bumped every time the cached matrices are rebuilt, so uniform uploads can be skipped when nothing changed
+    unsigned int GetVersion()
+    {
+        update();
+        return version;
+    }
+
+    void SetPerspective(float aspectRatio, float nearPlane, float farPlane)
+    {
+        AspectRatio = aspectRatio;
+        NearPlane = nearPlane;
+        FarPlane = farPlane;
+        projectionDirty = true;
+    }
+
+    void SetAspectRatio(float aspectRatio)
+    {
+        if(aspectRatio == AspectRatio)
+            return;
+        AspectRatio = aspectRatio;
+        projectionDirty = true;
+    }
+
+    // call after changing public attributes directly
+    void Invalidate()
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        updateCameraVectors();
+        projectionDirty = true;
     }
 
     // process input recieved from any keyboard-like input system. Accepts input parameter in the form of a camera defined ENUM
@@ -78,7 +178,8 @@ public:
         if(directon == RIGHT)
             Position += Right * velocity;
 
-        
+        if(velocity != 0.0f)
+            viewDirty = true;
     }
 
     // processes input recieved from a mouse input system. Expects the offset value in the both x and y direction
@@ -107,14 +208,64 @@ public:
 
     void ProcessMouseScroll(float yoffset)
     {
+        float previousZoom = Zoom;
         Zoom -= (float)yoffset;
         if(Zoom < 1.0f)
             Zoom = 1.0f;
         if(Zoom > 45.0f)
             Zoom = 45.0f;
+        if(Zoom != previousZoom)
+            projectionDirty = true;
     }
 
 private:
+    // cached matrices
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::mat4 inverseViewProjection;
+    glm::vec4 frustumPlanes[6];
+    bool viewDirty = true;
+    bool projectionDirty = true;
+    unsigned int version = 0;
+
+    // rebuilds whatever is out of date
+    void update()
+    {
+        if(!viewDirty && !projectionDirty)
+            return;
+        if(viewDirty)
+            view = glm::lookAt(Position, Position + Front, Up);
+        if(projectionDirty)
+            projection = glm::perspective(glm::radians(Zoom), AspectRatio, NearPlane, FarPlane);
+        viewDirty = false;
+        projectionDirty = false;
+
+        viewProjection = projection * view;
+        inverseViewProjection = glm::inverse(viewProjection);
+        extractFrustumPlanes();
+        version++;
+    }
+
+    // Gribb/Hartmann: each plane is the last row of the view-projection matrix plus or minus one of the others
+    void extractFrustumPlanes()
+    {
+        const glm::mat4 &m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        frustumPlanes[PLANE_LEFT] = row3 + row0;
+        frustumPlanes[PLANE_RIGHT] = row3 - row0;
+        frustumPlanes[PLANE_BOTTOM] = row3 + row1;
+        frustumPlanes[PLANE_TOP] = row3 - row1;
+        frustumPlanes[PLANE_NEAR] = row3 + row2;
+        frustumPlanes[PLANE_FAR] = row3 - row2;
+        for(unsigned int i = 0; i < 6; i++)
+            frustumPlanes[i] /= glm::length(glm::vec3(frustumPlanes[i]));
+    }
+
     // Calculates the front vector from the Camera's (updated) Euler angles
     void updateCameraVectors()
     {
@@ -134,6 +285,7 @@ private:
         // also recalculate the Right and Up vector
         Right = glm::normalize(glm::cross(Front, WorldUp));
         Up = glm::normalize(glm::cross(Right, Front));
+        viewDirty = true;
     }
 };
 #endif
\ No newline at end of file
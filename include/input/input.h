@@ -0,0 +1,255 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <GLFW/glfw3.h>
+
+#include <threading/spsc_ring.h>
+#include <threading/triple_buffer.h>
+
+#include <cstdint>
+#include <vector>
+
+enum Input_Event_Type {
+    INPUT_KEY,
+    INPUT_MOUSE_BUTTON,
+    INPUT_CURSOR,
+    INPUT_SCROLL
+};
+
+// one raw event as it came out of GLFW, stamped with glfwGetTime() when the callback ran
+struct InputEvent
+{
+    double time;
+    uint8_t type;
+    // key or mouse button, and GLFW_PRESS/GLFW_RELEASE/GLFW_REPEAT
+    int16_t code;
+    int16_t action;
+    // cursor position or scroll offset
+    double x;
+    double y;
+};
+
+// the newest cursor position, available to another thread without going through the event queue
+struct CursorSample
+{
+    double time;
+    double x;
+    double y;
+    bool valid;
+};
+
+// event driven input. GLFW callbacks push timestamped events into a lock-free ring; once per frame beginFrame() drains it,
+// keeping the events in order for anything that cares about sub-frame ordering and folding them into an action map
+// (held / pressed this frame / released this frame). Nothing polls GLFW per key per frame
+class InputSystem
+{
+public:
+    static const unsigned int MAX_ACTIONS = 32;
+    static const size_t RING_SIZE = 1024;
+
+    InputSystem()
+    {
+        for(unsigned int i = 0; i < MAX_ACTIONS; i++)
+        {
+            down[i] = 0;
+            pressed[i] = false;
+            released[i] = false;
+        }
+        dropped = 0;
+    }
+
+    // installs the callbacks on the window, the window's user pointer is used to find us again
+    void attach(GLFWwindow *window)
+    {
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
+        glfwSetCursorPosCallback(window, cursorCallback);
+        glfwSetScrollCallback(window, scrollCallback);
+    }
+
+    // maps a GLFW key / mouse button to an action; several inputs may map to the same action
+    void bindKey(unsigned int action, int key)
+    {
+        bindings.push_back(Binding{ INPUT_KEY, key, action });
+    }
+
+    void bindMouseButton(unsigned int action, int button)
+    {
+        bindings.push_back(Binding{ INPUT_MOUSE_BUTTON, button, action });
+    }
+
+    // adds an event as if it had come from a callback (must be on the producer thread)
+    void push(const InputEvent &event)
+    {
+        if(!ring.push(event))
+            dropped++;
+    }
+
+    // drains everything that arrived since the last call and updates the action map
+    void beginFrame()
+    {
+        resetFrame();
+        InputEvent event;
+        while(ring.pop(event))
+            apply(event);
+    }
+
+    // same, but the frame's events are given (replaying a recording); whatever arrived live is thrown away
+    void beginFrame(const std::vector<InputEvent> &replayed)
+    {
+        resetFrame();
+        InputEvent event;
+        while(ring.pop(event))
+        {
+        }
+        for(const InputEvent &replayedEvent : replayed)
+            apply(replayedEvent);
+    }
+
+    // the raw events of this frame in the order they happened
+    const std::vector<InputEvent> &events() const
+    {
+        return frameEvents;
+    }
+
+    // true if the event comes from an input bound to the action, for handling actions in event order
+    bool matches(const InputEvent &event, unsigned int action) const
+    {
+        for(const Binding &binding : bindings)
+        {
+            if(binding.action == action && binding.type == event.type && binding.code == event.code)
+                return true;
+        }
+        return false;
+    }
+
+    bool isDown(unsigned int action) const
+    {
+        return down[action] > 0;
+    }
+
+    // went down at some point this frame (still true if it was released again within the same frame)
+    bool wasPressed(unsigned int action) const
+    {
+        return pressed[action];
+    }
+
+    bool wasReleased(unsigned int action) const
+    {
+        return released[action];
+    }
+
+    // total vertical scroll this frame
+    double scrollOffset() const
+    {
+        return scrollY;
+    }
+
+    // the newest cursor position seen by the callbacks, for the render thread to late latch from (single reader).
+    // returns false until the first cursor event arrived
+    bool latestCursor(CursorSample &sample)
+    {
+        cursor.acquire();
+        sample = cursor.read();
+        return sample.valid;
+    }
+
+    // events lost because the ring was full
+    unsigned int droppedEvents() const
+    {
+        return dropped;
+    }
+
+private:
+    struct Binding
+    {
+        uint8_t type;
+        int code;
+        unsigned int action;
+    };
+
+    SpscRing<InputEvent, RING_SIZE> ring;
+    TripleBuffer<CursorSample> cursor;
+    std::vector<Binding> bindings;
+    std::vector<InputEvent> frameEvents;
+    unsigned int down[MAX_ACTIONS];
+    bool pressed[MAX_ACTIONS];
+    bool released[MAX_ACTIONS];
+    double scrollY = 0.0;
+    unsigned int dropped;
+
+    void resetFrame()
+    {
+        for(unsigned int i = 0; i < MAX_ACTIONS; i++)
+        {
+            pressed[i] = false;
+            released[i] = false;
+        }
+        frameEvents.clear();
+        scrollY = 0.0;
+    }
+
+    // records the event for this frame and folds it into the action map
+    void apply(const InputEvent &event)
+    {
+        frameEvents.push_back(event);
+        if(event.type == INPUT_SCROLL)
+        {
+            scrollY += event.y;
+            return;
+        }
+        if(event.type == INPUT_CURSOR || event.action == GLFW_REPEAT)
+            return;
+        for(const Binding &binding : bindings)
+        {
+            if(binding.type != event.type || binding.code != event.code)
+                continue;
+            if(event.action == GLFW_PRESS)
+            {
+                // counted so two inputs bound to one action don't release each other
+                if(down[binding.action]++ == 0)
+                    pressed[binding.action] = true;
+            }
+            else if(down[binding.action] > 0)
+            {
+                if(--down[binding.action] == 0)
+                    released[binding.action] = true;
+            }
+        }
+    }
+
+    static void pushFrom(GLFWwindow *window, uint8_t type, int code, int action, double x, double y)
+    {
+        InputSystem *input = static_cast<InputSystem*>(glfwGetWindowUserPointer(window));
+        if(input)
+            input->push(InputEvent{ glfwGetTime(), type, (int16_t)code, (int16_t)action, x, y });
+    }
+
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+    {
+        pushFrom(window, INPUT_KEY, key, action, 0.0, 0.0);
+    }
+
+    static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+    {
+        pushFrom(window, INPUT_MOUSE_BUTTON, button, action, 0.0, 0.0);
+    }
+
+    static void cursorCallback(GLFWwindow *window, double xpos, double ypos)
+    {
+        pushFrom(window, INPUT_CURSOR, 0, 0, xpos, ypos);
+        InputSystem *input = static_cast<InputSystem*>(glfwGetWindowUserPointer(window));
+        if(input)
+        {
+            input->cursor.write() = CursorSample{ glfwGetTime(), xpos, ypos, true };
+            input->cursor.publish();
+        }
+    }
+
+    static void scrollCallback(GLFWwindow *window, double xoffset, double yoffset)
+    {
+        pushFrom(window, INPUT_SCROLL, 0, 0, xoffset, yoffset);
+    }
+};
+#endif
@@ -0,0 +1,201 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <input/input.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// file layout, little endian as written by the machine that recorded it:
+//   header: "IREC", uint32 version, float step size (seconds per frame)
+//   then one record per event: uint32 frame, uint8 type, int16 code, int16 action, double x, double y
+//   closed by a record of type INPUT_RECORDING_END whose frame is the number of frames recorded
+// event times aren't stored, on replay the frame index is the clock
+const char INPUT_RECORDING_MAGIC[4] = { 'I', 'R', 'E', 'C' };
+const uint32_t INPUT_RECORDING_VERSION = 1;
+const uint8_t INPUT_RECORDING_END = 0xFF;
+
+// writes every event the input system saw, tagged with the frame it was handled in
+class InputRecorder
+{
+public:
+    bool open(const std::string &path, float stepSize)
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            std::cout << "ERROR::INPUT_RECORDER::FILE_NOT_OPENED " << path << std::endl;
+            return false;
+        }
+        file.write(INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC));
+        write(INPUT_RECORDING_VERSION);
+        write(stepSize);
+        recorded = 0;
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return file.is_open();
+    }
+
+    // call once per frame after InputSystem::beginFrame() with its events()
+    void record(uint32_t frame, const std::vector<InputEvent> &events)
+    {
+        if(!file.is_open())
+            return;
+        for(const InputEvent &event : events)
+            writeRecord(frame, event);
+        recorded += events.size();
+    }
+
+    size_t recordedEvents() const
+    {
+        return recorded;
+    }
+
+    // frameCount lets the replay run on through trailing frames without any input
+    void close(uint32_t frameCount)
+    {
+        if(!file.is_open())
+            return;
+        InputEvent end = { 0.0, INPUT_RECORDING_END, 0, 0, 0.0, 0.0 };
+        writeRecord(frameCount, end);
+        file.close();
+    }
+
+private:
+    std::ofstream file;
+    size_t recorded = 0;
+
+    template<typename T>
+    void write(const T &value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeRecord(uint32_t frame, const InputEvent &event)
+    {
+        write(frame);
+        write(event.type);
+        write(event.code);
+        write(event.action);
+        write(event.x);
+        write(event.y);
+    }
+};
+
+// plays a recording back one frame at a time; run with the recorded step size and the same frames come out
+class InputReplay
+{
+public:
+    bool load(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[sizeof(INPUT_RECORDING_MAGIC)];
+        uint32_t version = 0;
+        if(!file || !file.read(magic, sizeof(magic)) || std::memcmp(magic, INPUT_RECORDING_MAGIC, sizeof(magic)) != 0
+            || !read(file, version) || version != INPUT_RECORDING_VERSION || !read(file, step))
+        {
+            std::cout << "ERROR::INPUT_REPLAY::NOT_A_RECORDING " << path << std::endl;
+            return false;
+        }
+        // the replay runs at 1 / step frames per second
+        if(!std::isfinite(step) || step <= 0.0f)
+        {
+            std::cout << "ERROR::INPUT_REPLAY::BAD_STEP_SIZE " << path << std::endl;
+            return false;
+        }
+
+        events.clear();
+        frames.clear();
+        frameCount = 0;
+        uint32_t frame;
+        while(read(file, frame))
+        {
+            InputEvent event;
+            event.time = 0.0;
+            if(!read(file, event.type) || !read(file, event.code) || !read(file, event.action) || !read(file, event.x) || !read(file, event.y))
+            {
+                std::cout << "ERROR::INPUT_REPLAY::TRUNCATED " << path << std::endl;
+                return false;
+            }
+            // eventsFor walks the frames in order
+            if(!frames.empty() && frame < frames.back())
+            {
+                std::cout << "ERROR::INPUT_REPLAY::FRAMES_OUT_OF_ORDER " << path << std::endl;
+                return false;
+            }
+            if(event.type == INPUT_RECORDING_END)
+            {
+                frameCount = frame;
+                break;
+            }
+            events.push_back(event);
+            frames.push_back(frame);
+        }
+        // a recording that wasn't closed properly still plays up to its last event
+        if(frameCount == 0 && !frames.empty())
+            frameCount = frames.back() + 1;
+        next = 0;
+        return true;
+    }
+
+    // seconds per frame the recording was made with
+    float stepSize() const
+    {
+        return step;
+    }
+
+    // the events of the given frame; frames must be asked for in increasing order
+    const std::vector<InputEvent> &eventsFor(uint32_t frame, double now)
+    {
+        current.clear();
+        while(next < events.size() && frames[next] < frame)
+            next++;
+        while(next < events.size() && frames[next] == frame)
+        {
+            current.push_back(events[next]);
+            // stamped as if they had just arrived, so latency numbers still make sense
+            current.back().time = now;
+            next++;
+        }
+        return current;
+    }
+
+    // true once every recorded frame has been handed out
+    bool finished(uint32_t frame) const
+    {
+        return frame >= frameCount;
+    }
+
+    uint32_t recordedFrames() const
+    {
+        return frameCount;
+    }
+
+    size_t eventCount() const
+    {
+        return events.size();
+    }
+
+private:
+    float step = 0.0f;
+    std::vector<InputEvent> events;
+    std::vector<uint32_t> frames;
+    std::vector<InputEvent> current;
+    size_t next = 0;
+    uint32_t frameCount = 0;
+
+    template<typename T>
+    static bool read(std::ifstream &file, T &value)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+#ifndef BATCH_MATH_H
+#define BATCH_MATH_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+// read-only view of n vectors stored as three separate float arrays (structure of arrays)
+struct Vec3Arrays
+{
+    const float *x;
+    const float *y;
+    const float *z;
+};
+
+// writable version of the same
+struct Vec3ArraysOut
+{
+    float *x;
+    float *y;
+    float *z;
+};
+
+// batched versions of the glm calls the renderer makes per object or per camera. Inputs are structure of arrays and every
+// loop is branch free, so the compiler can vectorize them (build with optimizations and -fno-math-errno, otherwise sqrt
+// stays a call). Results match glm to float precision; angles are in radians unless the name says otherwise
+class BatchMath
+{
+public:
+    // sin and cos of every angle: Cody-Waite reduction to [-pi/4, pi/4] and the Cephes single precision polynomials.
+    // accurate to a few ulp for |angle| up to about 8000
+    static void sinCos(const float *angles, float *sines, float *cosines, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+            sinCos(angles[i], sines[i], cosines[i]);
+    }
+
+    // glm::translate(glm::mat4(1.0f), position)
+    static void translate(Vec3Arrays positions, glm::mat4 *out, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            float *m = &out[i][0][0];
+            m[0] = 1.0f;  m[1] = 0.0f;  m[2] = 0.0f;  m[3] = 0.0f;
+            m[4] = 0.0f;  m[5] = 1.0f;  m[6] = 0.0f;  m[7] = 0.0f;
+            m[8] = 0.0f;  m[9] = 0.0f;  m[10] = 1.0f; m[11] = 0.0f;
+            m[12] = positions.x[i]; m[13] = positions.y[i]; m[14] = positions.z[i]; m[15] = 1.0f;
+        }
+    }
+
+    // glm::rotate(glm::translate(glm::mat4(1.0f), position), angle, axis), the model matrix of a spinning object.
+    // axes don't need to be normalized (glm normalizes them too). With all positions zero this is just glm::rotate
+    static void translateRotate(Vec3Arrays positions, const float *angles, Vec3Arrays axes, glm::mat4 *out, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            float s, c;
+            sinCos(angles[i], s, c);
+            float invLength = 1.0f / std::sqrt(axes.x[i] * axes.x[i] + axes.y[i] * axes.y[i] + axes.z[i] * axes.z[i]);
+            float x = axes.x[i] * invLength, y = axes.y[i] * invLength, z = axes.z[i] * invLength;
+            float t = 1.0f - c;
+
+            float *m = &out[i][0][0];
+            m[0] = c + t * x * x;      m[1] = t * x * y + s * z;  m[2] = t * x * z - s * y;  m[3] = 0.0f;
+            m[4] = t * y * x - s * z;  m[5] = c + t * y * y;      m[6] = t * y * z + s * x;  m[7] = 0.0f;
+            m[8] = t * z * x + s * y;  m[9] = t * z * y - s * x;  m[10] = c + t * z * z;     m[11] = 0.0f;
+            m[12] = positions.x[i]; m[13] = positions.y[i]; m[14] = positions.z[i]; m[15] = 1.0f;
+        }
+    }
+
+    // glm::lookAt(eye, center, up), right handed
+    static void lookAt(Vec3Arrays eyes, Vec3Arrays centers, Vec3Arrays ups, glm::mat4 *out, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            float fx = centers.x[i] - eyes.x[i], fy = centers.y[i] - eyes.y[i], fz = centers.z[i] - eyes.z[i];
+            float invF = 1.0f / std::sqrt(fx * fx + fy * fy + fz * fz);
+            fx *= invF; fy *= invF; fz *= invF;
+
+            // s = normalize(cross(f, up))
+            float sx = fy * ups.z[i] - fz * ups.y[i], sy = fz * ups.x[i] - fx * ups.z[i], sz = fx * ups.y[i] - fy * ups.x[i];
+            float invS = 1.0f / std::sqrt(sx * sx + sy * sy + sz * sz);
+            sx *= invS; sy *= invS; sz *= invS;
+
+            // u = cross(s, f)
+            float ux = sy * fz - sz * fy, uy = sz * fx - sx * fz, uz = sx * fy - sy * fx;
+
+            float ex = eyes.x[i], ey = eyes.y[i], ez = eyes.z[i];
+            float *m = &out[i][0][0];
+            m[0] = sx;  m[1] = ux;  m[2] = -fx;  m[3] = 0.0f;
+            m[4] = sy;  m[5] = uy;  m[6] = -fy;  m[7] = 0.0f;
+            m[8] = sz;  m[9] = uz;  m[10] = -fz; m[11] = 0.0f;
+            m[12] = -(sx * ex + sy * ey + sz * ez);
+            m[13] = -(ux * ex + uy * ey + uz * ez);
+            m[14] = fx * ex + fy * ey + fz * ez;
+            m[15] = 1.0f;
+        }
+    }
+
+    // glm::perspective(fovy, aspect, nearPlane, farPlane), right handed with a -1..1 depth range
+    static void perspective(const float *fovys, const float *aspects, float nearPlane, float farPlane, glm::mat4 *out, size_t count)
+    {
+        float depthScale = -(farPlane + nearPlane) / (farPlane - nearPlane);
+        float depthOffset = -(2.0f * farPlane * nearPlane) / (farPlane - nearPlane);
+        for(size_t i = 0; i < count; i++)
+        {
+            float s, c;
+            sinCos(fovys[i] * 0.5f, s, c);
+            // 1 / tan(fovy / 2)
+            float focal = c / s;
+
+            float *m = &out[i][0][0];
+            m[0] = focal / aspects[i]; m[1] = 0.0f;  m[2] = 0.0f;         m[3] = 0.0f;
+            m[4] = 0.0f;               m[5] = focal; m[6] = 0.0f;         m[7] = 0.0f;
+            m[8] = 0.0f;               m[9] = 0.0f;  m[10] = depthScale;  m[11] = -1.0f;
+            m[12] = 0.0f;              m[13] = 0.0f; m[14] = depthOffset; m[15] = 0.0f;
+        }
+    }
+
+    // what Camera::updateCameraVectors does: front from yaw/pitch (degrees), then right and up against the world up.
+    // none of the output arrays may overlap each other or the inputs
+    static void cameraVectors(const float *yawDegrees, const float *pitchDegrees, glm::vec3 worldUp, Vec3ArraysOut fronts, Vec3ArraysOut rights, Vec3ArraysOut ups, size_t count)
+    {
+        cameraVectorsKernel(yawDegrees, pitchDegrees, worldUp.x, worldUp.y, worldUp.z, fronts.x, fronts.y, fronts.z, rights.x, rights.y, rights.z, ups.x, ups.y, ups.z, count);
+    }
+
+    // single angle version, inlined into the loops above
+    static inline void sinCos(float angle, float &sine, float &cosine)
+    {
+        // nearest multiple of pi/2, then subtract it in three parts so the reduction stays exact
+        float quadrantF = angle * 0.63661977236758134308f;
+        int quadrant = static_cast<int>(quadrantF + (quadrantF >= 0.0f ? 0.5f : -0.5f));
+        float q = static_cast<float>(quadrant);
+        float r = angle - q * 1.5703125f;
+        r = r - q * 4.837512969970703125e-4f;
+        r = r - q * 7.54978995489188216e-8f;
+
+        float r2 = r * r;
+        float s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+        float c = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+        // rotate the result by the quadrant
+        int k = quadrant & 3;
+        float swappedSine = (k & 1) ? c : s;
+        float swappedCosine = (k & 1) ? s : c;
+        sine = (k & 2) ? -swappedSine : swappedSine;
+        cosine = ((k + 1) & 2) ? -swappedCosine : swappedCosine;
+    }
+
+private:
+    // nine output streams are too many for the compiler's runtime overlap checks, so the no overlap promise is spelled out
+    // with restrict parameters
+    static void cameraVectorsKernel(const float *__restrict yawDegrees, const float *__restrict pitchDegrees, float worldX, float worldY, float worldZ,
+        float *__restrict frontX, float *__restrict frontY, float *__restrict frontZ,
+        float *__restrict rightX, float *__restrict rightY, float *__restrict rightZ,
+        float *__restrict upX, float *__restrict upY, float *__restrict upZ, size_t count)
+    {
+        const float toRadians = 0.01745329251994329577f;
+        for(size_t i = 0; i < count; i++)
+        {
+            float sinYaw, cosYaw, sinPitch, cosPitch;
+            sinCos(yawDegrees[i] * toRadians, sinYaw, cosYaw);
+            sinCos(pitchDegrees[i] * toRadians, sinPitch, cosPitch);
+
+            float fx = cosYaw * cosPitch, fy = sinPitch, fz = sinYaw * cosPitch;
+            float invF = 1.0f / std::sqrt(fx * fx + fy * fy + fz * fz);
+            fx *= invF; fy *= invF; fz *= invF;
+
+            float rx = fy * worldZ - fz * worldY, ry = fz * worldX - fx * worldZ, rz = fx * worldY - fy * worldX;
+            float invR = 1.0f / std::sqrt(rx * rx + ry * ry + rz * rz);
+            rx *= invR; ry *= invR; rz *= invR;
+
+            float ux = ry * fz - rz * fy, uy = rz * fx - rx * fz, uz = rx * fy - ry * fx;
+            float invU = 1.0f / std::sqrt(ux * ux + uy * uy + uz * uz);
+
+            frontX[i] = fx; frontY[i] = fy; frontZ[i] = fz;
+            rightX[i] = rx; rightY[i] = ry; rightZ[i] = rz;
+            upX[i] = ux * invU; upY[i] = uy * invU; upZ[i] = uz * invU;
+        }
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,295 @@
+#ifndef TRANSFORM_KERNEL_H
+#define TRANSFORM_KERNEL_H
+
+#include <glm/glm.hpp>
+
+#include <math/batch_math.h>
+
+#include <cmath>
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TRANSFORM_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+enum Transform_Isa {
+    TRANSFORM_SCALAR,
+    TRANSFORM_SSE,
+    TRANSFORM_AVX2
+};
+
+// per object transforms as structure of arrays: position, rotation as a unit quaternion (x, y, z, w) and per axis scale
+struct TransformArrays
+{
+    Vec3Arrays positions;
+    const float *qx;
+    const float *qy;
+    const float *qz;
+    const float *qw;
+    Vec3Arrays scales;
+};
+
+// builds model matrices (translate * rotate * scale, column major like glm) for many objects at once and writes them straight
+// to their destination, typically a persistently mapped instance buffer. With a view-projection matrix it also writes each
+// object's model-view-projection right after its model matrix. Uses AVX2+FMA (8 objects per step) or SSE (4 per step) when
+// the CPU has them, checked once at runtime, and plain C++ everywhere else and for the leftovers
+class TransformKernel
+{
+public:
+    // the best path this CPU supports
+    static Transform_Isa detectIsa()
+    {
+#ifdef TRANSFORM_KERNEL_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return TRANSFORM_AVX2;
+        if(__builtin_cpu_supports("sse2"))
+            return TRANSFORM_SSE;
+#endif
+        return TRANSFORM_SCALAR;
+    }
+
+    static Transform_Isa isa()
+    {
+        static const Transform_Isa detected = detectIsa();
+        return detected;
+    }
+
+    static const char *isaName(Transform_Isa isa)
+    {
+        switch(isa)
+        {
+            case TRANSFORM_AVX2: return "avx2";
+            case TRANSFORM_SSE: return "sse";
+            default: return "scalar";
+        }
+    }
+
+    // the quaternions of glm::rotate(angle, axis); axes don't need to be normalized
+    static void axisAngleToQuaternions(const float *angles, Vec3Arrays axes, float *qx, float *qy, float *qz, float *qw, size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            float s, c;
+            BatchMath::sinCos(angles[i] * 0.5f, s, c);
+            float scale = s / std::sqrt(axes.x[i] * axes.x[i] + axes.y[i] * axes.y[i] + axes.z[i] * axes.z[i]);
+            qx[i] = axes.x[i] * scale;
+            qy[i] = axes.y[i] * scale;
+            qz[i] = axes.z[i] * scale;
+            qw[i] = c;
+        }
+    }
+
+    // writes count model matrices to out, one every stride floats (16 when tightly packed). If viewProjection isn't null
+    // the model-view-projection goes to out + 16 of each object, so stride has to be at least 32. out needs no alignment
+    static void compose(const TransformArrays &in, size_t count, float *out, size_t stride = 16, const glm::mat4 *viewProjection = nullptr)
+    {
+        compose(isa(), in, count, out, stride, viewProjection);
+    }
+
+    // same with a forced path (must be supported by the CPU), for benchmarks and for checking the paths against each other
+    static void compose(Transform_Isa path, const TransformArrays &in, size_t count, float *out, size_t stride = 16, const glm::mat4 *viewProjection = nullptr)
+    {
+        size_t done = 0;
+#ifdef TRANSFORM_KERNEL_X86
+        if(path == TRANSFORM_AVX2)
+            done = composeAvx2(in, count, out, stride, viewProjection);
+        else if(path == TRANSFORM_SSE)
+            done = composeSse(in, count, out, stride, viewProjection);
+#endif
+        composeScalar(in, done, count, out, stride, viewProjection);
+    }
+
+private:
+    // objects [first, last)
+    static void composeScalar(const TransformArrays &in, size_t first, size_t last, float *out, size_t stride, const glm::mat4 *viewProjection)
+    {
+        for(size_t i = first; i < last; i++)
+        {
+            float x = in.qx[i], y = in.qy[i], z = in.qz[i], w = in.qw[i];
+            float sx = in.scales.x[i], sy = in.scales.y[i], sz = in.scales.z[i];
+
+            glm::mat4 model;
+            model[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f);
+            model[1] = glm::vec4(2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f);
+            model[2] = glm::vec4(2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f);
+            model[3] = glm::vec4(in.positions.x[i], in.positions.y[i], in.positions.z[i], 1.0f);
+
+            float *dst = out + i * stride;
+            const float *m = &model[0][0];
+            for(int e = 0; e < 16; e++)
+                dst[e] = m[e];
+            if(viewProjection)
+            {
+                glm::mat4 mvp = *viewProjection * model;
+                const float *p = &mvp[0][0];
+                for(int e = 0; e < 16; e++)
+                    dst[16 + e] = p[e];
+            }
+        }
+    }
+
+#ifdef TRANSFORM_KERNEL_X86
+    // returns how many objects it handled (a multiple of 8), the rest is left to the scalar loop
+    __attribute__((target("avx2,fma")))
+    static size_t composeAvx2(const TransformArrays &in, size_t count, float *out, size_t stride, const glm::mat4 *viewProjection)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        size_t blocks = count / 8 * 8;
+        for(size_t i = 0; i < blocks; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(in.qx + i), y = _mm256_loadu_ps(in.qy + i), z = _mm256_loadu_ps(in.qz + i), w = _mm256_loadu_ps(in.qw + i);
+            __m256 sx = _mm256_loadu_ps(in.scales.x + i), sy = _mm256_loadu_ps(in.scales.y + i), sz = _mm256_loadu_ps(in.scales.z + i);
+            __m256 x2 = _mm256_mul_ps(x, two), y2 = _mm256_mul_ps(y, two), z2 = _mm256_mul_ps(z, two);
+            __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+            __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+            __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+            // element c * 4 + r is column c, row r for all 8 objects
+            __m256 m[16];
+            m[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+            m[1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+            m[2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+            m[3] = zero;
+            m[4] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+            m[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+            m[6] = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+            m[7] = zero;
+            m[8] = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+            m[9] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+            m[10] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+            m[11] = zero;
+            m[12] = _mm256_loadu_ps(in.positions.x + i);
+            m[13] = _mm256_loadu_ps(in.positions.y + i);
+            m[14] = _mm256_loadu_ps(in.positions.z + i);
+            m[15] = one;
+            storeTransposed8(m, out + i * stride, stride);
+
+            if(viewProjection)
+            {
+                // mvp column c = viewProjection * model column c, with the view-projection elements broadcast
+                const glm::mat4 &vp = *viewProjection;
+                __m256 p[16];
+                for(int c = 0; c < 4; c++)
+                {
+                    for(int r = 0; r < 4; r++)
+                    {
+                        __m256 sum = _mm256_mul_ps(_mm256_set1_ps(vp[0][r]), m[c * 4]);
+                        sum = _mm256_fmadd_ps(_mm256_set1_ps(vp[1][r]), m[c * 4 + 1], sum);
+                        sum = _mm256_fmadd_ps(_mm256_set1_ps(vp[2][r]), m[c * 4 + 2], sum);
+                        p[c * 4 + r] = _mm256_fmadd_ps(_mm256_set1_ps(vp[3][r]), m[c * 4 + 3], sum);
+                    }
+                }
+                storeTransposed8(p, out + i * stride + 16, stride);
+            }
+        }
+        return blocks;
+    }
+
+    // element-major (16 vectors of 8 objects) to 8 consecutive column major matrices, each written front to back
+    __attribute__((target("avx2,fma")))
+    static void storeTransposed8(const __m256 *m, float *out, size_t stride)
+    {
+        // 4x4 transpose of each column within the 128 bit halves: t[c * 4 + k] holds column c of object k (low half)
+        // and of object k + 4 (high half)
+        __m256 t[16];
+        for(int c = 0; c < 4; c++)
+        {
+            __m256 a = _mm256_unpacklo_ps(m[c * 4], m[c * 4 + 1]);
+            __m256 b = _mm256_unpackhi_ps(m[c * 4], m[c * 4 + 1]);
+            __m256 d = _mm256_unpacklo_ps(m[c * 4 + 2], m[c * 4 + 3]);
+            __m256 e = _mm256_unpackhi_ps(m[c * 4 + 2], m[c * 4 + 3]);
+            t[c * 4] = _mm256_shuffle_ps(a, d, 0x44);
+            t[c * 4 + 1] = _mm256_shuffle_ps(a, d, 0xEE);
+            t[c * 4 + 2] = _mm256_shuffle_ps(b, e, 0x44);
+            t[c * 4 + 3] = _mm256_shuffle_ps(b, e, 0xEE);
+        }
+        for(int k = 0; k < 4; k++)
+        {
+            float *low = out + k * stride;
+            float *high = out + (k + 4) * stride;
+            __m256 lowFront = _mm256_permute2f128_ps(t[k], t[4 + k], 0x20), lowBack = _mm256_permute2f128_ps(t[8 + k], t[12 + k], 0x20);
+            __m256 highFront = _mm256_permute2f128_ps(t[k], t[4 + k], 0x31), highBack = _mm256_permute2f128_ps(t[8 + k], t[12 + k], 0x31);
+            _mm256_storeu_ps(low, lowFront);
+            _mm256_storeu_ps(low + 8, lowBack);
+            _mm256_storeu_ps(high, highFront);
+            _mm256_storeu_ps(high + 8, highBack);
+        }
+    }
+
+    // SSE2 is part of x86-64, so this needs no target attribute
+    static size_t composeSse(const TransformArrays &in, size_t count, float *out, size_t stride, const glm::mat4 *viewProjection)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 zero = _mm_setzero_ps();
+        size_t blocks = count / 4 * 4;
+        for(size_t i = 0; i < blocks; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(in.qx + i), y = _mm_loadu_ps(in.qy + i), z = _mm_loadu_ps(in.qz + i), w = _mm_loadu_ps(in.qw + i);
+            __m128 sx = _mm_loadu_ps(in.scales.x + i), sy = _mm_loadu_ps(in.scales.y + i), sz = _mm_loadu_ps(in.scales.z + i);
+            __m128 x2 = _mm_mul_ps(x, two), y2 = _mm_mul_ps(y, two), z2 = _mm_mul_ps(z, two);
+            __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+            __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+            __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+            __m128 m[16];
+            m[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+            m[1] = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+            m[2] = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+            m[3] = zero;
+            m[4] = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+            m[5] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+            m[6] = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+            m[7] = zero;
+            m[8] = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+            m[9] = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+            m[10] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+            m[11] = zero;
+            m[12] = _mm_loadu_ps(in.positions.x + i);
+            m[13] = _mm_loadu_ps(in.positions.y + i);
+            m[14] = _mm_loadu_ps(in.positions.z + i);
+            m[15] = one;
+            storeTransposed4(m, out + i * stride, stride);
+
+            if(viewProjection)
+            {
+                const glm::mat4 &vp = *viewProjection;
+                __m128 p[16];
+                for(int c = 0; c < 4; c++)
+                {
+                    for(int r = 0; r < 4; r++)
+                    {
+                        __m128 sum = _mm_mul_ps(_mm_set1_ps(vp[0][r]), m[c * 4]);
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vp[1][r]), m[c * 4 + 1]));
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vp[2][r]), m[c * 4 + 2]));
+                        p[c * 4 + r] = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vp[3][r]), m[c * 4 + 3]));
+                    }
+                }
+                storeTransposed4(p, out + i * stride + 16, stride);
+            }
+        }
+        return blocks;
+    }
+
+    static void storeTransposed4(const __m128 *elements, float *out, size_t stride)
+    {
+        __m128 m[16];
+        for(int e = 0; e < 16; e++)
+            m[e] = elements[e];
+        for(int c = 0; c < 4; c++)
+            _MM_TRANSPOSE4_PS(m[c * 4], m[c * 4 + 1], m[c * 4 + 2], m[c * 4 + 3]);
+        // after the transposes m[c * 4 + k] is column c of object k
+        for(int k = 0; k < 4; k++)
+        {
+            float *dst = out + k * stride;
+            for(int c = 0; c < 4; c++)
+                _mm_storeu_ps(dst + c * 4, m[c * 4 + k]);
+        }
+    }
+#endif
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,406 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <mesh/json.h>
+#include <mesh/mesh_data.h>
+#include <threading/thread_pool.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// glTF 2.0 geometry from .gltf (buffers in files next to it or in base64 data uris) or .glb. Every triangle primitive of
+// every mesh the default scene reaches is baked with its node transform into one mesh; POSITION, NORMAL and TEXCOORD_0
+// are read, materials, skins, morph targets and sparse accessors are not. Vertex ranges of big primitives are decoded
+// in parallel
+class GltfLoader
+{
+public:
+    static const size_t MIN_BATCH = 16 << 10;
+
+    static bool load(const std::string &path, MeshData &mesh, ThreadPool *pool = nullptr)
+    {
+        std::string file;
+        if(!readFile(path, file))
+        {
+            std::cout << "ERROR::GLTF_LOADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+
+        GltfDocument document;
+        document.directory = directoryOf(path);
+        std::string json;
+        if(file.size() >= 12 && std::memcmp(file.data(), "glTF", 4) == 0)
+        {
+            if(!splitBinary(file, json, document.binaryChunk))
+            {
+                std::cout << "ERROR::GLTF_LOADER::BAD_GLB " << path << std::endl;
+                return false;
+            }
+        }
+        else
+            json.swap(file);
+
+        if(!JsonParser::parse(json, document.json))
+        {
+            std::cout << "ERROR::GLTF_LOADER::BAD_JSON " << path << std::endl;
+            return false;
+        }
+        if(!loadBuffers(document))
+        {
+            std::cout << "ERROR::GLTF_LOADER::MISSING_BUFFER " << path << std::endl;
+            return false;
+        }
+
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        const JsonValue &scenes = document.json["scenes"];
+        if(scenes.size() > 0)
+        {
+            const JsonValue &nodes = scenes[static_cast<size_t>(document.json["scene"].asInt(0))]["nodes"];
+            for(size_t i = 0; i < nodes.size(); i++)
+                if(!addNode(document, static_cast<size_t>(nodes[i].asInt()), glm::mat4(1.0f), mesh, pool, 0))
+                    return fail(path);
+        }
+        else
+        {
+            // no scene, every mesh as it is
+            const JsonValue &meshes = document.json["meshes"];
+            for(size_t i = 0; i < meshes.size(); i++)
+                if(!addMesh(document, meshes[i], glm::mat4(1.0f), mesh, pool))
+                    return fail(path);
+        }
+
+        if(mesh.indices.empty())
+        {
+            std::cout << "ERROR::GLTF_LOADER::NO_TRIANGLES " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const int MAX_NODE_DEPTH = 64;
+
+    enum Gltf_Component {
+        GLTF_BYTE = 5120,
+        GLTF_UNSIGNED_BYTE = 5121,
+        GLTF_SHORT = 5122,
+        GLTF_UNSIGNED_SHORT = 5123,
+        GLTF_UNSIGNED_INT = 5125,
+        GLTF_FLOAT = 5126
+    };
+
+    static const int GLTF_TRIANGLES = 4;
+
+    struct GltfDocument
+    {
+        JsonValue json;
+        std::string directory;
+        std::string binaryChunk;
+        std::vector<std::string> buffers;
+    };
+
+    // where an accessor's elements are: element i starts at data + i * stride
+    struct AccessorView
+    {
+        const unsigned char *data;
+        size_t stride;
+        size_t count;
+        int components;
+        int componentType;
+        bool normalized;
+    };
+
+    static bool fail(const std::string &path)
+    {
+        std::cout << "ERROR::GLTF_LOADER::BAD_ACCESSOR " << path << std::endl;
+        return false;
+    }
+
+    static bool readFile(const std::string &path, std::string &out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+            return false;
+        out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // .glb: 12 byte header, then a JSON chunk and an optional BIN chunk
+    static bool splitBinary(const std::string &file, std::string &json, std::string &binary)
+    {
+        size_t offset = 12;
+        while(offset + 8 <= file.size())
+        {
+            uint32_t length, type;
+            std::memcpy(&length, file.data() + offset, 4);
+            std::memcpy(&type, file.data() + offset + 4, 4);
+            offset += 8;
+            if(offset + length > file.size())
+                return false;
+            if(type == 0x4E4F534A)
+                json.assign(file, offset, length);
+            else if(type == 0x004E4942)
+                binary.assign(file, offset, length);
+            offset += (length + 3) & ~3u;
+        }
+        return !json.empty();
+    }
+
+    static bool decodeBase64(const std::string &text, size_t start, std::string &out)
+    {
+        auto value = [](char c) -> int
+        {
+            if(c >= 'A' && c <= 'Z') return c - 'A';
+            if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if(c >= '0' && c <= '9') return c - '0' + 52;
+            if(c == '+' || c == '-') return 62;
+            if(c == '/' || c == '_') return 63;
+            return -1;
+        };
+        out.clear();
+        out.reserve((text.size() - start) * 3 / 4);
+        uint32_t bits = 0;
+        int count = 0;
+        for(size_t i = start; i < text.size() && text[i] != '='; i++)
+        {
+            int v = value(text[i]);
+            if(v < 0)
+                return false;
+            bits = (bits << 6) | static_cast<uint32_t>(v);
+            count += 6;
+            if(count >= 8)
+            {
+                count -= 8;
+                out += static_cast<char>((bits >> count) & 0xFF);
+            }
+        }
+        return true;
+    }
+
+    static bool loadBuffers(GltfDocument &document)
+    {
+        const JsonValue &buffers = document.json["buffers"];
+        document.buffers.resize(buffers.size());
+        for(size_t i = 0; i < buffers.size(); i++)
+        {
+            const JsonValue &uri = buffers[i]["uri"];
+            if(uri.type != JSON_STRING)
+            {
+                // the glb's own chunk
+                document.buffers[i] = document.binaryChunk;
+                continue;
+            }
+            if(uri.string.compare(0, 5, "data:") == 0)
+            {
+                size_t comma = uri.string.find(";base64,");
+                if(comma == std::string::npos || !decodeBase64(uri.string, comma + 8, document.buffers[i]))
+                    return false;
+            }
+            else if(!readFile(document.directory + uri.string, document.buffers[i]))
+                return false;
+        }
+        return true;
+    }
+
+    static int componentSize(int componentType)
+    {
+        switch(componentType)
+        {
+        case GLTF_BYTE:
+        case GLTF_UNSIGNED_BYTE: return 1;
+        case GLTF_SHORT:
+        case GLTF_UNSIGNED_SHORT: return 2;
+        case GLTF_UNSIGNED_INT:
+        case GLTF_FLOAT: return 4;
+        }
+        return 0;
+    }
+
+    static int componentCount(const std::string &type)
+    {
+        if(type == "SCALAR") return 1;
+        if(type == "VEC2") return 2;
+        if(type == "VEC3") return 3;
+        if(type == "VEC4") return 4;
+        return 0;
+    }
+
+    static bool view(const GltfDocument &document, int accessorIndex, AccessorView &out)
+    {
+        const JsonValue &accessor = document.json["accessors"][static_cast<size_t>(accessorIndex)];
+        if(accessor.type != JSON_OBJECT || accessor.has("sparse") || !accessor.has("bufferView"))
+            return false;
+        const JsonValue &bufferView = document.json["bufferViews"][static_cast<size_t>(accessor["bufferView"].asInt())];
+        size_t buffer = static_cast<size_t>(bufferView["buffer"].asInt(-1));
+        if(buffer >= document.buffers.size())
+            return false;
+
+        out.componentType = accessor["componentType"].asInt();
+        out.components = componentCount(accessor["type"].string);
+        out.count = static_cast<size_t>(accessor["count"].asNumber());
+        out.normalized = accessor["normalized"].asBool();
+        size_t elementSize = static_cast<size_t>(componentSize(out.componentType) * out.components);
+        out.stride = static_cast<size_t>(bufferView["byteStride"].asNumber(static_cast<double>(elementSize)));
+        size_t offset = static_cast<size_t>(bufferView["byteOffset"].asNumber() + accessor["byteOffset"].asNumber());
+        if(elementSize == 0)
+            return false;
+
+        const std::string &bytes = document.buffers[buffer];
+        size_t viewEnd = static_cast<size_t>(bufferView["byteOffset"].asNumber() + bufferView["byteLength"].asNumber());
+        if(viewEnd > bytes.size() || (out.count > 0 && offset + (out.count - 1) * out.stride + elementSize > viewEnd))
+            return false;
+        out.data = reinterpret_cast<const unsigned char*>(bytes.data()) + offset;
+        return true;
+    }
+
+    // component c of element i as a float, normalized integers mapped to [0, 1] or [-1, 1]
+    static float component(const AccessorView &accessor, size_t i, int c)
+    {
+        const unsigned char *p = accessor.data + i * accessor.stride;
+        switch(accessor.componentType)
+        {
+        case GLTF_FLOAT: { float v; std::memcpy(&v, p + c * 4, 4); return v; }
+        case GLTF_UNSIGNED_BYTE: { float v = p[c]; return accessor.normalized ? v / 255.0f : v; }
+        case GLTF_BYTE: { float v = static_cast<int8_t>(p[c]); return accessor.normalized ? std::max(v / 127.0f, -1.0f) : v; }
+        case GLTF_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p + c * 2, 2); return accessor.normalized ? v / 65535.0f : v; }
+        case GLTF_SHORT: { int16_t v; std::memcpy(&v, p + c * 2, 2); return accessor.normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+        case GLTF_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p + c * 4, 4); return static_cast<float>(v); }
+        }
+        return 0.0f;
+    }
+
+    static uint32_t index(const AccessorView &accessor, size_t i)
+    {
+        const unsigned char *p = accessor.data + i * accessor.stride;
+        switch(accessor.componentType)
+        {
+        case GLTF_UNSIGNED_BYTE: return p[0];
+        case GLTF_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+        case GLTF_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+        }
+        return 0;
+    }
+
+    static glm::mat4 nodeTransform(const JsonValue &node)
+    {
+        const JsonValue &matrix = node["matrix"];
+        if(matrix.size() == 16)
+        {
+            glm::mat4 m;
+            for(int i = 0; i < 16; i++)
+                glm::value_ptr(m)[i] = static_cast<float>(matrix[static_cast<size_t>(i)].asNumber());
+            return m;
+        }
+        const JsonValue &t = node["translation"];
+        const JsonValue &r = node["rotation"];
+        const JsonValue &s = node["scale"];
+        glm::mat4 m(1.0f);
+        if(t.size() == 3)
+            m = glm::translate(m, glm::vec3(t[0].asNumber(), t[1].asNumber(), t[2].asNumber()));
+        if(r.size() == 4)
+            m *= glm::mat4_cast(glm::quat(static_cast<float>(r[3].asNumber()), static_cast<float>(r[0].asNumber()), static_cast<float>(r[1].asNumber()), static_cast<float>(r[2].asNumber())));
+        if(s.size() == 3)
+            m = glm::scale(m, glm::vec3(s[0].asNumber(), s[1].asNumber(), s[2].asNumber()));
+        return m;
+    }
+
+    static bool addNode(const GltfDocument &document, size_t nodeIndex, const glm::mat4 &parent, MeshData &mesh, ThreadPool *pool, int depth)
+    {
+        const JsonValue &node = document.json["nodes"][nodeIndex];
+        if(node.type != JSON_OBJECT || depth > MAX_NODE_DEPTH)
+            return false;
+        glm::mat4 transform = parent * nodeTransform(node);
+        if(node.has("mesh") && !addMesh(document, document.json["meshes"][static_cast<size_t>(node["mesh"].asInt())], transform, mesh, pool))
+            return false;
+        const JsonValue &children = node["children"];
+        for(size_t i = 0; i < children.size(); i++)
+            if(!addNode(document, static_cast<size_t>(children[i].asInt()), transform, mesh, pool, depth + 1))
+                return false;
+        return true;
+    }
+
+    static bool addMesh(const GltfDocument &document, const JsonValue &gltfMesh, const glm::mat4 &transform, MeshData &mesh, ThreadPool *pool)
+    {
+        const JsonValue &primitives = gltfMesh["primitives"];
+        for(size_t p = 0; p < primitives.size(); p++)
+        {
+            const JsonValue &primitive = primitives[p];
+            // points, lines and strips aren't imported
+            if(primitive["mode"].asInt(GLTF_TRIANGLES) != GLTF_TRIANGLES)
+                continue;
+
+            const JsonValue &attributes = primitive["attributes"];
+            AccessorView positions, normals, texCoords, indices;
+            if(!view(document, attributes["POSITION"].asInt(-1), positions) || positions.components != 3)
+                return false;
+            bool hasNormals = attributes.has("NORMAL");
+            bool hasTexCoords = attributes.has("TEXCOORD_0");
+            if(hasNormals && (!view(document, attributes["NORMAL"].asInt(), normals) || normals.components != 3 || normals.count != positions.count))
+                return false;
+            if(hasTexCoords && (!view(document, attributes["TEXCOORD_0"].asInt(), texCoords) || texCoords.components != 2 || texCoords.count != positions.count))
+                return false;
+            size_t base = mesh.vertices.size();
+            size_t firstIndex = mesh.indices.size();
+            mesh.vertices.resize(base + positions.count);
+            glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+            auto decode = [&](size_t first, size_t last)
+            {
+                for(size_t i = first; i < last; i++)
+                {
+                    MeshVertex &vertex = mesh.vertices[base + i];
+                    glm::vec3 position(component(positions, i, 0), component(positions, i, 1), component(positions, i, 2));
+                    vertex.position = glm::vec3(transform * glm::vec4(position, 1.0f));
+                    vertex.normal = glm::vec3(0.0f);
+                    if(hasNormals)
+                        vertex.normal = glm::normalize(normalTransform * glm::vec3(component(normals, i, 0), component(normals, i, 1), component(normals, i, 2)));
+                    vertex.texCoord = glm::vec2(0.0f);
+                    if(hasTexCoords)
+                        vertex.texCoord = glm::vec2(component(texCoords, i, 0), component(texCoords, i, 1));
+                }
+            };
+            if(pool)
+                pool->parallelFor(positions.count, MIN_BATCH, decode);
+            else
+                decode(0, positions.count);
+
+            if(primitive.has("indices"))
+            {
+                if(!view(document, primitive["indices"].asInt(), indices) || indices.components != 1)
+                    return false;
+                for(size_t i = 0; i < indices.count; i++)
+                {
+                    uint32_t vertex = index(indices, i);
+                    if(vertex >= positions.count)
+                        return false;
+                    mesh.indices.push_back(static_cast<uint32_t>(base) + vertex);
+                }
+            }
+            else
+            {
+                for(size_t i = 0; i < positions.count; i++)
+                    mesh.indices.push_back(static_cast<uint32_t>(base + i));
+            }
+            if(!hasNormals)
+                mesh.generateNormals(base, firstIndex);
+        }
+        return true;
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,263 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum Json_Type {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+// a parsed JSON document, just enough of it to read glTF. Missing keys and out of range indices give a null value, so
+// lookups can be chained without checking every step
+struct JsonValue
+{
+    Json_Type type = JSON_NULL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue &operator[](const std::string &key) const
+    {
+        for(const std::pair<std::string, JsonValue> &member : members)
+            if(member.first == key)
+                return member.second;
+        return null();
+    }
+
+    const JsonValue &operator[](size_t index) const
+    {
+        return index < items.size() ? items[index] : null();
+    }
+
+    bool has(const std::string &key) const
+    {
+        return (*this)[key].type != JSON_NULL;
+    }
+
+    size_t size() const
+    {
+        return type == JSON_ARRAY ? items.size() : members.size();
+    }
+
+    double asNumber(double fallback = 0.0) const
+    {
+        return type == JSON_NUMBER ? number : fallback;
+    }
+
+    int asInt(int fallback = 0) const
+    {
+        return type == JSON_NUMBER ? static_cast<int>(number) : fallback;
+    }
+
+    bool asBool(bool fallback = false) const
+    {
+        return type == JSON_BOOL ? boolean : fallback;
+    }
+
+    static const JsonValue &null()
+    {
+        static const JsonValue value;
+        return value;
+    }
+};
+
+// recursive descent parser over a whole document in memory
+class JsonParser
+{
+public:
+    static bool parse(const std::string &text, JsonValue &out)
+    {
+        JsonParser parser(text);
+        parser.skipSpace();
+        if(!parser.value(out, 0))
+            return false;
+        parser.skipSpace();
+        return parser.position == text.size();
+    }
+
+private:
+    static const int MAX_DEPTH = 64;
+
+    const std::string &text;
+    size_t position;
+
+    JsonParser(const std::string &text) : text(text), position(0)
+    {
+    }
+
+    void skipSpace()
+    {
+        while(position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+            position++;
+    }
+
+    bool literal(const char *word)
+    {
+        size_t length = std::char_traits<char>::length(word);
+        if(text.compare(position, length, word) != 0)
+            return false;
+        position += length;
+        return true;
+    }
+
+    bool value(JsonValue &out, int depth)
+    {
+        if(position >= text.size() || depth > MAX_DEPTH)
+            return false;
+        char c = text[position];
+        if(c == '{')
+            return object(out, depth);
+        if(c == '[')
+            return array(out, depth);
+        if(c == '"')
+        {
+            out.type = JSON_STRING;
+            return string(out.string);
+        }
+        if(c == 't' || c == 'f')
+        {
+            out.type = JSON_BOOL;
+            out.boolean = c == 't';
+            return literal(out.boolean ? "true" : "false");
+        }
+        if(c == 'n')
+        {
+            out.type = JSON_NULL;
+            return literal("null");
+        }
+
+        const char *start = text.c_str() + position;
+        char *end = nullptr;
+        out.type = JSON_NUMBER;
+        out.number = std::strtod(start, &end);
+        if(end == start)
+            return false;
+        position += end - start;
+        return true;
+    }
+
+    bool object(JsonValue &out, int depth)
+    {
+        out.type = JSON_OBJECT;
+        position++;
+        skipSpace();
+        if(position < text.size() && text[position] == '}')
+        {
+            position++;
+            return true;
+        }
+        while(position < text.size())
+        {
+            std::pair<std::string, JsonValue> member;
+            skipSpace();
+            if(position >= text.size() || text[position] != '"' || !string(member.first))
+                return false;
+            skipSpace();
+            if(position >= text.size() || text[position++] != ':')
+                return false;
+            skipSpace();
+            if(!value(member.second, depth + 1))
+                return false;
+            out.members.push_back(std::move(member));
+            skipSpace();
+            if(position >= text.size())
+                return false;
+            char c = text[position++];
+            if(c == '}')
+                return true;
+            if(c != ',')
+                return false;
+        }
+        return false;
+    }
+
+    bool array(JsonValue &out, int depth)
+    {
+        out.type = JSON_ARRAY;
+        position++;
+        skipSpace();
+        if(position < text.size() && text[position] == ']')
+        {
+            position++;
+            return true;
+        }
+        while(position < text.size())
+        {
+            skipSpace();
+            out.items.emplace_back();
+            if(!value(out.items.back(), depth + 1))
+                return false;
+            skipSpace();
+            if(position >= text.size())
+                return false;
+            char c = text[position++];
+            if(c == ']')
+                return true;
+            if(c != ',')
+                return false;
+        }
+        return false;
+    }
+
+    // the opening quote is at position; \u escapes are written out as UTF-8
+    bool string(std::string &out)
+    {
+        position++;
+        while(position < text.size())
+        {
+            char c = text[position++];
+            if(c == '"')
+                return true;
+            if(c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if(position >= text.size())
+                return false;
+            char escape = text[position++];
+            switch(escape)
+            {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+            {
+                if(position + 4 > text.size())
+                    return false;
+                unsigned long code = std::strtoul(text.substr(position, 4).c_str(), nullptr, 16);
+                position += 4;
+                if(code < 0x80)
+                    out += static_cast<char>(code);
+                else if(code < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: out += escape; break;
+            }
+        }
+        return false;
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <mesh/vertex_format.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// an indexed triangle list as the importers produce it, before packing
+struct MeshData
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+
+    // smooth normals for files that don't have any: every triangle adds its area weighted normal to its corners. Only
+    // vertices from firstVertex on are touched, with the triangles from firstIndex on (which mustn't reference earlier ones)
+    void generateNormals(size_t firstVertex = 0, size_t firstIndex = 0)
+    {
+        for(size_t i = firstVertex; i < vertices.size(); i++)
+            vertices[i].normal = glm::vec3(0.0f);
+        for(size_t i = firstIndex; i + 2 < indices.size(); i += 3)
+        {
+            MeshVertex &a = vertices[indices[i]];
+            MeshVertex &b = vertices[indices[i + 1]];
+            MeshVertex &c = vertices[indices[i + 2]];
+            glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+            a.normal += normal;
+            b.normal += normal;
+            c.normal += normal;
+        }
+        for(size_t i = firstVertex; i < vertices.size(); i++)
+        {
+            MeshVertex &vertex = vertices[i];
+            float length = glm::length(vertex.normal);
+            vertex.normal = length > 0.0f ? vertex.normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,339 @@
+#ifndef MESH_IMPORTER_H
+#define MESH_IMPORTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <mesh/gltf_loader.h>
+#include <mesh/mesh_data.h>
+#include <mesh/mesh_simplifier.h>
+#include <mesh/obj_loader.h>
+#include <mesh/vertex_format.h>
+#include <renderer/gl_state.h>
+#include <threading/thread_pool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// cache file layout, little endian as written by the machine that imported:
+//   header: "MSHC", uint32 version, uint64 source size, int64 source modification time,
+//           uint32 attribute count, then uint32 location and uint32 encoding per attribute,
+//           uint32 vertex count, uint32 index count, uint32 index size (2 or 4), float dequantize[16],
+//           uint32 level of detail count, then uint32 first index, uint32 index count and float error per level
+//   then the payload exactly as it is uploaded: the packed vertices followed by the indices of every level
+// a cache whose source changed size or time, that was packed for another format, whose counts don't add up to its size
+// or whose indices reach past its vertices, is ignored and rewritten
+const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+const uint32_t MESH_CACHE_VERSION = 2;
+
+// a mesh in its GPU layout, one block that goes straight into the buffers
+struct ImportedMesh
+{
+    VertexFormat format;
+    glm::mat4 dequantize;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t indexSize = 0;
+    // index ranges of the levels of detail, finest (the whole mesh) first
+    std::vector<MeshLod> lods;
+    std::vector<unsigned char> payload;
+    bool fromCache = false;
+
+    size_t vertexBytes() const
+    {
+        return static_cast<size_t>(vertexCount) * format.stride;
+    }
+
+    size_t indexBytes() const
+    {
+        return static_cast<size_t>(indexCount) * indexSize;
+    }
+};
+
+// imports Wavefront OBJ and glTF 2.0 (.gltf, .glb) files. The first import parses the source (in parallel when given a
+// pool), simplifies it into a chain of levels of detail and writes a cache next to it; later imports of the unchanged
+// file read the cache's payload in a single read
+class MeshImporter
+{
+public:
+    // cachePath defaults to the source path with ".meshcache" appended
+    static bool import(const std::string &path, const VertexFormat &format, ImportedMesh &out, ThreadPool *pool = nullptr, std::string cachePath = std::string())
+    {
+        if(cachePath.empty())
+            cachePath = path + ".meshcache";
+
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        if(!sourceStamp(path, sourceSize, sourceTime))
+        {
+            std::cout << "ERROR::MESH_IMPORTER::FILE_NOT_FOUND " << path << std::endl;
+            return false;
+        }
+        if(readCache(cachePath, sourceSize, sourceTime, format, out))
+            return true;
+
+        MeshData data;
+        std::string extension = extensionOf(path);
+        bool loaded = false;
+        if(extension == "obj")
+            loaded = ObjLoader::load(path, data, pool);
+        else if(extension == "gltf" || extension == "glb")
+            loaded = GltfLoader::load(path, data, pool);
+        else
+            std::cout << "ERROR::MESH_IMPORTER::UNSUPPORTED_FORMAT " << path << std::endl;
+        if(!loaded)
+            return false;
+
+        std::vector<MeshLod> lods;
+        MeshSimplifier::buildLods(data, lods, pool);
+        pack(data, format, out);
+        out.lods = lods;
+        // an unwritable cache only costs the next load its speed
+        if(!writeCache(cachePath, sourceSize, sourceTime, out))
+            std::cout << "ERROR::MESH_IMPORTER::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+        return true;
+    }
+
+    // packs the vertices for format and narrows the indices to 16 bits when they fit; the indices are a single level
+    static void pack(const MeshData &data, const VertexFormat &format, ImportedMesh &out)
+    {
+        PackedVertices packed = VertexPacker::pack(data.vertices, format);
+        out.format = format;
+        out.dequantize = packed.dequantize;
+        out.vertexCount = packed.count;
+        out.indexCount = static_cast<uint32_t>(data.indices.size());
+        out.indexSize = packed.count <= 0xFFFF ? 2 : 4;
+        out.fromCache = false;
+        MeshLod whole = { 0, out.indexCount, 0.0f };
+        out.lods.assign(1, whole);
+
+        out.payload.resize(out.vertexBytes() + out.indexBytes());
+        std::copy(packed.data.begin(), packed.data.end(), out.payload.begin());
+        unsigned char *indices = out.payload.data() + out.vertexBytes();
+        for(size_t i = 0; i < data.indices.size(); i++)
+        {
+            if(out.indexSize == 2)
+            {
+                uint16_t index = static_cast<uint16_t>(data.indices[i]);
+                std::memcpy(indices + i * 2, &index, 2);
+            }
+            else
+                std::memcpy(indices + i * 4, &data.indices[i], 4);
+        }
+    }
+
+    // back to an indexed triangle list in mesh space, for processing that needs the geometry (clustering, simplification).
+    // The indices are the ones of level lod
+    static void unpack(const ImportedMesh &mesh, MeshData &out, size_t lod = 0)
+    {
+        VertexPacker::unpack(mesh.payload.data(), mesh.vertexCount, mesh.format, mesh.dequantize, out.vertices);
+        out.indices.resize(mesh.lods[lod].indexCount);
+        const unsigned char *indices = mesh.payload.data() + mesh.vertexBytes() + static_cast<size_t>(mesh.lods[lod].firstIndex) * mesh.indexSize;
+        for(size_t i = 0; i < out.indices.size(); i++)
+        {
+            if(mesh.indexSize == 2)
+            {
+                uint16_t index;
+                std::memcpy(&index, indices + i * 2, 2);
+                out.indices[i] = index;
+            }
+            else
+                std::memcpy(&out.indices[i], indices + i * 4, 4);
+        }
+    }
+
+    // static vertex and element buffers in a new vertex array, laid out from the mesh's format
+    static MeshBuffers upload(GLStateCache &state, const ImportedMesh &mesh)
+    {
+        MeshBuffers buffers;
+        buffers.vertexCount = static_cast<int>(mesh.vertexCount);
+        buffers.dequantize = mesh.dequantize;
+        buffers.format = mesh.format;
+        buffers.indexCount = static_cast<int>(mesh.indexCount);
+        buffers.indexType = mesh.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        // the errors go from mesh units to the packed positions', like everything else the model matrix sees
+        buffers.lods = mesh.lods;
+        float packedScale = glm::length(glm::vec3(mesh.dequantize[0]));
+        for(MeshLod &lod : buffers.lods)
+            lod.error = packedScale > 0.0f ? lod.error / packedScale : 0.0f;
+
+        glGenVertexArrays(1, &buffers.vertexArray);
+        glGenBuffers(1, &buffers.vertexBuffer);
+        glGenBuffers(1, &buffers.indexBuffer);
+        state.bindVertexArray(buffers.vertexArray);
+        state.bindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(mesh.vertexBytes()), mesh.payload.data(), GL_STATIC_DRAW);
+        VertexPacker::setupAttributes(mesh.format);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(mesh.indexBytes()), mesh.payload.data() + mesh.vertexBytes(), GL_STATIC_DRAW);
+        return buffers;
+    }
+
+private:
+    static std::string extensionOf(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        if(dot == std::string::npos)
+            return std::string();
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return extension;
+    }
+
+    static bool sourceStamp(const std::string &path, uint64_t &size, int64_t &time)
+    {
+        std::error_code error;
+        size = static_cast<uint64_t>(std::filesystem::file_size(path, error));
+        if(error)
+            return false;
+        time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+        return !error;
+    }
+
+    template<typename T>
+    static void write(std::ofstream &file, const T &value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    static bool read(std::ifstream &file, T &value)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    static bool writeCache(const std::string &path, uint64_t sourceSize, int64_t sourceTime, const ImportedMesh &mesh)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if(!file)
+            return false;
+        file.write(MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+        write(file, MESH_CACHE_VERSION);
+        write(file, sourceSize);
+        write(file, sourceTime);
+        write(file, static_cast<uint32_t>(mesh.format.attributes.size()));
+        for(const VertexAttribute &attribute : mesh.format.attributes)
+        {
+            write(file, static_cast<uint32_t>(attribute.location));
+            write(file, static_cast<uint32_t>(attribute.encoding));
+        }
+        write(file, mesh.vertexCount);
+        write(file, mesh.indexCount);
+        write(file, mesh.indexSize);
+        file.write(reinterpret_cast<const char*>(&mesh.dequantize[0][0]), sizeof(float) * 16);
+        write(file, static_cast<uint32_t>(mesh.lods.size()));
+        for(const MeshLod &lod : mesh.lods)
+        {
+            write(file, lod.firstIndex);
+            write(file, lod.indexCount);
+            write(file, lod.error);
+        }
+        file.write(reinterpret_cast<const char*>(mesh.payload.data()), static_cast<std::streamsize>(mesh.payload.size()));
+        return static_cast<bool>(file);
+    }
+
+    // the bytes of one level of detail in the cache header
+    static const uint64_t CACHE_LOD_BYTES = sizeof(uint32_t) * 2 + sizeof(float);
+
+    static bool readCache(const std::string &path, uint64_t sourceSize, int64_t sourceTime, const VertexFormat &format, ImportedMesh &out)
+    {
+        std::error_code error;
+        uint64_t fileSize = static_cast<uint64_t>(std::filesystem::file_size(path, error));
+        if(error)
+            return false;
+        std::ifstream file(path, std::ios::binary);
+        char magic[sizeof(MESH_CACHE_MAGIC)];
+        uint32_t version = 0, attributeCount = 0;
+        uint64_t size = 0;
+        int64_t time = 0;
+        if(!file || !file.read(magic, sizeof(magic)) || std::memcmp(magic, MESH_CACHE_MAGIC, sizeof(magic)) != 0
+            || !read(file, version) || version != MESH_CACHE_VERSION || !read(file, size) || !read(file, time)
+            || size != sourceSize || time != sourceTime || !read(file, attributeCount) || attributeCount != format.attributes.size())
+            return false;
+
+        for(const VertexAttribute &attribute : format.attributes)
+        {
+            uint32_t location, encoding;
+            if(!read(file, location) || !read(file, encoding) || location != attribute.location || encoding != static_cast<uint32_t>(attribute.encoding))
+                return false;
+        }
+
+        out.format = format;
+        if(!read(file, out.vertexCount) || !read(file, out.indexCount) || !read(file, out.indexSize) || (out.indexSize != 2 && out.indexSize != 4)
+            || !file.read(reinterpret_cast<char*>(&out.dequantize[0][0]), sizeof(float) * 16))
+            return false;
+
+        // nothing is sized from the header before it is checked against what the file holds, the counts of a cache
+        // that was cut short or garbled would otherwise ask for gigabytes
+        uint32_t lodCount = 0;
+        if(!read(file, lodCount) || lodCount == 0)
+            return false;
+        if(lodCount > remainingBytes(file, fileSize) / CACHE_LOD_BYTES)
+        {
+            std::cout << "ERROR::MESH_IMPORTER::CACHE_SIZE_MISMATCH " << path << std::endl;
+            return false;
+        }
+        out.lods.resize(lodCount);
+        for(MeshLod &lod : out.lods)
+        {
+            if(!read(file, lod.firstIndex) || !read(file, lod.indexCount) || !read(file, lod.error)
+                || static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > out.indexCount)
+                return false;
+        }
+
+        // the payload runs to the end of the file, exactly
+        if(static_cast<uint64_t>(out.vertexBytes()) + out.indexBytes() != remainingBytes(file, fileSize))
+        {
+            std::cout << "ERROR::MESH_IMPORTER::CACHE_SIZE_MISMATCH " << path << std::endl;
+            return false;
+        }
+        out.payload.resize(out.vertexBytes() + out.indexBytes());
+        if(!file.read(reinterpret_cast<char*>(out.payload.data()), static_cast<std::streamsize>(out.payload.size())))
+            return false;
+        // the sizes add up, but a garbled index would still send unpack(), the simplifier and the GPU past the vertices
+        if(!indicesInRange(out))
+        {
+            std::cout << "ERROR::MESH_IMPORTER::CACHE_BAD_INDEX " << path << std::endl;
+            return false;
+        }
+        out.fromCache = true;
+        return true;
+    }
+
+    static bool indicesInRange(const ImportedMesh &mesh)
+    {
+        const unsigned char *indices = mesh.payload.data() + mesh.vertexBytes();
+        for(size_t i = 0; i < mesh.indexCount; i++)
+        {
+            uint32_t index;
+            if(mesh.indexSize == 2)
+            {
+                uint16_t narrow;
+                std::memcpy(&narrow, indices + i * 2, 2);
+                index = narrow;
+            }
+            else
+                std::memcpy(&index, indices + i * 4, 4);
+            if(index >= mesh.vertexCount)
+                return false;
+        }
+        return true;
+    }
+
+    // the bytes left after the read position, fileSize being the size of the whole file
+    static uint64_t remainingBytes(std::ifstream &file, uint64_t fileSize)
+    {
+        std::streamoff position = file.tellg();
+        if(position < 0 || static_cast<uint64_t>(position) > fileSize)
+            return 0;
+        return fileSize - static_cast<uint64_t>(position);
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,436 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <mesh/mesh_data.h>
+#include <mesh/vertex_format.h>
+#include <threading/thread_pool.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// the error of a collapse that must not happen
+const float SIMPLIFIER_LOCKED_ERROR = 3.0e38f;
+
+// the squared distance to a set of weighted planes, Q(p) = p'Ap + 2b'p + c, in double so summing thousands stays exact
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+
+    static Quadric plane(const glm::vec3 &normal, float distance, float weight)
+    {
+        double x = normal.x, y = normal.y, z = normal.z, d = distance, w = weight;
+        Quadric q = { w * x * x, w * x * y, w * x * z, w * y * y, w * y * z, w * z * z, w * d * x, w * d * y, w * d * z, w * d * d, w };
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+        return *this;
+    }
+
+    double evaluate(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        return a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + a11 * y * y + 2.0 * a12 * y * z + a22 * z * z
+            + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    }
+};
+
+// quadric error metric simplification by half edge collapses: a vertex only ever moves onto one of its neighbours, so
+// the simplified triangles index the source vertices and every level of detail can share one vertex buffer.
+// Vertices that share their position with another one (texture or normal seams) are locked, open borders are held in
+// place by planes standing on the border edges. Collapses are ordered by their quadric error, but the error reported
+// for a result is measured: the furthest any removed vertex ended up from the triangles around the one it merged into
+class MeshSimplifier
+{
+public:
+    // how much more a border edge resists moving than the surface around it
+    static const int BORDER_WEIGHT = 10;
+
+    // writes indices with at most targetTriangles triangles (fewer are left if the locked vertices get in the way) and
+    // returns the error of the result in mesh units
+    static float simplify(const MeshData &mesh, size_t targetTriangles, std::vector<uint32_t> &indices, ThreadPool *pool = nullptr)
+    {
+        std::vector<size_t> targets(1, targetTriangles);
+        std::vector<std::vector<uint32_t>> levels;
+        std::vector<float> errors;
+        simplifyChain(mesh, targets, levels, errors, pool);
+        indices.swap(levels[0]);
+        return errors[0];
+    }
+
+    // one simplification run through every target in turn (largest first), keeping the indices and the error at each,
+    // so every result is a simplification of the one before and the errors never go down
+    static void simplifyChain(const MeshData &mesh, const std::vector<size_t> &targets, std::vector<std::vector<uint32_t>> &levels, std::vector<float> &errors, ThreadPool *pool = nullptr)
+    {
+        levels.assign(targets.size(), std::vector<uint32_t>());
+        errors.assign(targets.size(), 0.0f);
+        std::vector<uint32_t> indices = mesh.indices;
+        size_t vertexCount = mesh.vertices.size();
+
+        std::vector<uint32_t> group;
+        std::vector<bool> locked;
+        groupPositions(mesh, group, locked);
+        std::vector<Quadric> quadrics;
+        computeQuadrics(mesh, group, quadrics);
+
+        std::vector<uint32_t> adjacencyOffsets, adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<bool> touched;
+        std::vector<uint32_t> remap(vertexCount);
+        // the vertex every source vertex has been merged into so far
+        std::vector<uint32_t> mergedInto(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++)
+            mergedInto[v] = static_cast<uint32_t>(v);
+
+        for(size_t level = 0; level < targets.size(); level++)
+        {
+            size_t target = targets[level];
+            while(indices.size() / 3 > target && pass(mesh, quadrics, locked, target, indices, adjacencyOffsets, adjacency, collapses, touched, remap, pool))
+            {
+                for(uint32_t &merged : mergedInto)
+                    merged = remap[merged];
+            }
+            levels[level] = indices;
+            errors[level] = level > 0 ? errors[level - 1] : 0.0f;
+            errors[level] = std::max(errors[level], measureError(mesh, indices, mergedInto, adjacencyOffsets, adjacency, pool));
+        }
+    }
+
+    // a chain of levels of detail in one index list: level 0 is the mesh itself, every next one aims for half the
+    // triangles of the one before, and a level that couldn't get at least a tenth below the previous one ends the chain.
+    // mesh.indices is replaced by the concatenated levels, lods gets one index range per level
+    static void buildLods(MeshData &mesh, std::vector<MeshLod> &lods, ThreadPool *pool = nullptr, unsigned int maxLevels = MAX_LODS)
+    {
+        lods.clear();
+        size_t baseTriangles = mesh.indices.size() / 3;
+        MeshLod base = { 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f };
+        lods.push_back(base);
+
+        std::vector<size_t> targets;
+        for(size_t target = baseTriangles / 2; target >= MIN_LOD_TRIANGLES && targets.size() + 1 < maxLevels; target /= 2)
+            targets.push_back(target);
+        if(targets.empty())
+            return;
+
+        std::vector<std::vector<uint32_t>> levels;
+        std::vector<float> errors;
+        simplifyChain(mesh, targets, levels, errors, pool);
+
+        for(size_t i = 0; i < levels.size(); i++)
+        {
+            const MeshLod &previous = lods.back();
+            if(levels[i].size() * 10 > static_cast<size_t>(previous.indexCount) * 9)
+                break;
+            MeshLod lod = { static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(levels[i].size()), errors[i] };
+            mesh.indices.insert(mesh.indices.end(), levels[i].begin(), levels[i].end());
+            lods.push_back(lod);
+        }
+    }
+
+    static const unsigned int MAX_LODS = 6;
+    static const size_t MIN_LOD_TRIANGLES = 64;
+    static const size_t MIN_BATCH = 16 << 10;
+
+private:
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+
+    // collapses the cheapest edges that don't share a triangle with each other, leaving indices remapped and the
+    // collapses in remap; false once nothing can collapse any more
+    static bool pass(const MeshData &mesh, std::vector<Quadric> &quadrics, const std::vector<bool> &locked, size_t targetTriangles, std::vector<uint32_t> &indices,
+        std::vector<uint32_t> &adjacencyOffsets, std::vector<uint32_t> &adjacency, std::vector<Collapse> &collapses, std::vector<bool> &touched,
+        std::vector<uint32_t> &remap, ThreadPool *pool)
+    {
+        size_t vertexCount = mesh.vertices.size();
+        buildAdjacency(indices, vertexCount, adjacencyOffsets, adjacency);
+
+        // every edge in the cheaper direction; an edge shared by two triangles shows up twice
+        collapses.resize(indices.size());
+        auto evaluate = [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+            {
+                uint32_t a = indices[i], b = indices[i - i % 3 + (i + 1) % 3];
+                Collapse ab = { a, b, collapseError(mesh, quadrics, locked, a, b) };
+                Collapse ba = { b, a, collapseError(mesh, quadrics, locked, b, a) };
+                collapses[i] = ab.error <= ba.error ? ab : ba;
+            }
+        };
+        if(pool)
+            pool->parallelFor(indices.size(), MIN_BATCH, evaluate);
+        else
+            evaluate(0, indices.size());
+        collapses.erase(std::remove_if(collapses.begin(), collapses.end(), [](const Collapse &c) { return c.error >= SIMPLIFIER_LOCKED_ERROR; }), collapses.end());
+        if(collapses.empty())
+            return false;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.error < y.error; });
+
+        // a pass only takes collapses about as cheap as the ones it needs (but at least the cheapest quarter, or the last
+        // few would take a pass each), otherwise it spends expensive ones where a neighbour just blocked the cheap ones
+        size_t triangleCount = indices.size() / 3;
+        size_t needed = (triangleCount - targetTriangles + 1) / 2;
+        float passLimit = collapses[std::min(collapses.size() - 1, std::max(needed * 2, collapses.size() / 4))].error;
+
+        touched.assign(vertexCount, false);
+        for(size_t v = 0; v < vertexCount; v++)
+            remap[v] = static_cast<uint32_t>(v);
+        size_t collapsed = 0;
+        for(const Collapse &collapse : collapses)
+        {
+            if(collapse.error > passLimit || triangleCount <= targetTriangles)
+                break;
+            if(touched[collapse.from] || touched[collapse.to] || flips(mesh, indices, adjacencyOffsets, adjacency, collapse.from, collapse.to))
+                continue;
+
+            // the triangles around the edge disappear, the rest of the fan around from now ends on to
+            for(uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++)
+            {
+                const uint32_t *triangle = &indices[adjacency[a] * 3];
+                if(triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    triangleCount--;
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            collapsed++;
+        }
+        if(collapsed == 0)
+            return false;
+
+        size_t write = 0;
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if(a == b || b == c || c == a)
+                continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+        return true;
+    }
+
+    // the furthest any merged away vertex is from the triangles around the vertex it was merged into (and their neighbours)
+    static float measureError(const MeshData &mesh, const std::vector<uint32_t> &indices, const std::vector<uint32_t> &mergedInto,
+        std::vector<uint32_t> &adjacencyOffsets, std::vector<uint32_t> &adjacency, ThreadPool *pool)
+    {
+        size_t vertexCount = mesh.vertices.size();
+        buildAdjacency(indices, vertexCount, adjacencyOffsets, adjacency);
+        std::vector<float> batchErrors(pool ? pool->size() : 1, 0.0f);
+        std::atomic<size_t> nextBatch(0);
+        auto measure = [&](size_t begin, size_t end)
+        {
+            float worst = 0.0f;
+            for(size_t v = begin; v < end; v++)
+            {
+                uint32_t into = mergedInto[v];
+                if(into == v || adjacencyOffsets[into] == adjacencyOffsets[into + 1])
+                    continue;
+                // later collapses around it can leave the vertex over triangles one ring further out
+                float nearest = SIMPLIFIER_LOCKED_ERROR;
+                for(uint32_t a = adjacencyOffsets[into]; a < adjacencyOffsets[into + 1]; a++)
+                {
+                    const uint32_t *ring = &indices[adjacency[a] * 3];
+                    for(int corner = 0; corner < 3; corner++)
+                    {
+                        for(uint32_t b = adjacencyOffsets[ring[corner]]; b < adjacencyOffsets[ring[corner] + 1]; b++)
+                        {
+                            const uint32_t *triangle = &indices[adjacency[b] * 3];
+                            nearest = std::min(nearest, squaredDistance(mesh.vertices[v].position, mesh.vertices[triangle[0]].position,
+                                mesh.vertices[triangle[1]].position, mesh.vertices[triangle[2]].position));
+                        }
+                    }
+                }
+                worst = std::max(worst, nearest);
+            }
+            batchErrors[nextBatch++] = worst;
+        };
+        if(pool)
+            pool->parallelFor(vertexCount, MIN_BATCH, measure);
+        else
+            measure(0, vertexCount);
+        return std::sqrt(*std::max_element(batchErrors.begin(), batchErrors.end()));
+    }
+
+    // squared distance from p to the triangle abc, from the closest point on it
+    static float squaredDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if(d1 <= 0.0f && d2 <= 0.0f)
+            return glm::dot(ap, ap);
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if(d3 >= 0.0f && d4 <= d3)
+            return glm::dot(bp, bp);
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if(d6 >= 0.0f && d5 <= d6)
+            return glm::dot(cp, cp);
+
+        glm::vec3 closest;
+        float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            closest = a + ab * (d1 / (d1 - d3));
+        else if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            closest = a + ac * (d2 / (d2 - d6));
+        else if(va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        else
+        {
+            float sum = va + vb + vc;
+            if(sum == 0.0f)
+                return glm::dot(ap, ap);
+            closest = a + ab * (vb / sum) + ac * (vc / sum);
+        }
+        glm::vec3 offset = p - closest;
+        return glm::dot(offset, offset);
+    }
+
+    // group[v] is the first vertex at v's position, and vertices that share a position are locked
+    static void groupPositions(const MeshData &mesh, std::vector<uint32_t> &group, std::vector<bool> &locked)
+    {
+        size_t vertexCount = mesh.vertices.size();
+        std::vector<uint32_t> order(vertexCount);
+        for(size_t v = 0; v < vertexCount; v++)
+            order[v] = static_cast<uint32_t>(v);
+        auto less = [&mesh](uint32_t a, uint32_t b)
+        {
+            const glm::vec3 &p = mesh.vertices[a].position, &q = mesh.vertices[b].position;
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        group.assign(vertexCount, 0);
+        locked.assign(vertexCount, false);
+        for(size_t begin = 0, end = 0; begin < vertexCount; begin = end)
+        {
+            end = begin + 1;
+            while(end < vertexCount && mesh.vertices[order[end]].position == mesh.vertices[order[begin]].position)
+                end++;
+            uint32_t first = *std::min_element(order.begin() + begin, order.begin() + end);
+            for(size_t i = begin; i < end; i++)
+            {
+                group[order[i]] = first;
+                locked[order[i]] = end - begin > 1;
+            }
+        }
+    }
+
+    // every vertex starts with the area weighted planes of its triangles, border vertices also with the planes through
+    // their border edges at right angles to the surface
+    static void computeQuadrics(const MeshData &mesh, const std::vector<uint32_t> &group, std::vector<Quadric> &quadrics)
+    {
+        quadrics.assign(mesh.vertices.size(), Quadric::plane(glm::vec3(0.0f), 0.0f, 0.0f));
+
+        // how many triangles use every edge, counted between positions so a seam doesn't look like a border
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(mesh.indices.size());
+        for(size_t i = 0; i < mesh.indices.size(); i += 3)
+            for(int e = 0; e < 3; e++)
+                edgeUses[edgeKey(group[mesh.indices[i + e]], group[mesh.indices[i + (e + 1) % 3]])]++;
+
+        for(size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            const uint32_t *triangle = &mesh.indices[i];
+            glm::vec3 p[3] = { mesh.vertices[triangle[0]].position, mesh.vertices[triangle[1]].position, mesh.vertices[triangle[2]].position };
+            glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            float doubleArea = glm::length(normal);
+            if(doubleArea == 0.0f)
+                continue;
+            normal /= doubleArea;
+            Quadric face = Quadric::plane(normal, -glm::dot(normal, p[0]), doubleArea * 0.5f);
+            for(int corner = 0; corner < 3; corner++)
+                quadrics[triangle[corner]] += face;
+
+            for(int e = 0; e < 3; e++)
+            {
+                uint32_t a = triangle[e], b = triangle[(e + 1) % 3];
+                if(edgeUses[edgeKey(group[a], group[b])] != 1)
+                    continue;
+                glm::vec3 edge = p[(e + 1) % 3] - p[e];
+                glm::vec3 borderNormal = glm::cross(normal, edge);
+                float length = glm::length(borderNormal);
+                if(length == 0.0f)
+                    continue;
+                borderNormal /= length;
+                Quadric border = Quadric::plane(borderNormal, -glm::dot(borderNormal, p[e]), glm::dot(edge, edge) * BORDER_WEIGHT);
+                quadrics[a] += border;
+                quadrics[b] += border;
+            }
+        }
+    }
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+    }
+
+    static float collapseError(const MeshData &mesh, const std::vector<Quadric> &quadrics, const std::vector<bool> &locked, uint32_t from, uint32_t to)
+    {
+        if(locked[from])
+            return SIMPLIFIER_LOCKED_ERROR;
+        Quadric merged = quadrics[from];
+        merged += quadrics[to];
+        if(merged.weight <= 0.0)
+            return 0.0f;
+        return static_cast<float>(std::sqrt(std::max(0.0, merged.evaluate(mesh.vertices[to].position)) / merged.weight));
+    }
+
+    // the triangles around every vertex, in one flat array
+    static void buildAdjacency(const std::vector<uint32_t> &indices, size_t vertexCount, std::vector<uint32_t> &offsets, std::vector<uint32_t> &adjacency)
+    {
+        offsets.assign(vertexCount + 1, 0);
+        for(uint32_t index : indices)
+            offsets[index + 1]++;
+        for(size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // whether moving from onto to would turn any of from's remaining triangles over (or flatten it to nothing)
+    static bool flips(const MeshData &mesh, const std::vector<uint32_t> &indices, const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &adjacency, uint32_t from, uint32_t to)
+    {
+        for(uint32_t a = offsets[from]; a < offsets[from + 1]; a++)
+        {
+            const uint32_t *triangle = &indices[adjacency[a] * 3];
+            if(triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                continue;
+            glm::vec3 before[3], after[3];
+            for(int corner = 0; corner < 3; corner++)
+            {
+                before[corner] = mesh.vertices[triangle[corner]].position;
+                after[corner] = triangle[corner] == from ? mesh.vertices[to].position : before[corner];
+            }
+            glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            // turning a triangle most of the way over also counts, slivers that tip a little every pass end up flipped
+            if(normalBefore != glm::vec3(0.0f) && glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter))
+                return true;
+        }
+        return false;
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,233 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <mesh/mesh_data.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// a cluster of a mesh: up to MAX_VERTICES vertices, listed in MeshletMesh::vertices from vertexOffset, and up to
+// MAX_TRIANGLES triangles as 8 bit indices into that list, in MeshletMesh::triangles from triangleOffset * 3
+struct Meshlet
+{
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// what a meshlet is culled with, in mesh space. The cluster faces away from every point the camera can be at for which
+// dot(normalize(coneApex - camera), coneAxis) >= coneCutoff; a cutoff of 1 means its normals spread too far to ever cull
+struct MeshletBounds
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneApex;
+    float coneCutoff;
+    glm::vec3 coneAxis;
+};
+
+struct MeshletMesh
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;
+    // indices into the source mesh's vertices
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+// greedy clustering: a meshlet grows by the triangle next to it that adds the fewest new vertices (ties go to the one
+// closest to the meshlet's center), and a new meshlet starts once the next triangle wouldn't fit
+class MeshletBuilder
+{
+public:
+    static const uint32_t MAX_VERTICES = 64;
+    static const uint32_t MAX_TRIANGLES = 124;
+
+    static void build(const MeshData &mesh, MeshletMesh &out, uint32_t maxVertices = MAX_VERTICES, uint32_t maxTriangles = MAX_TRIANGLES)
+    {
+        out.meshlets.clear();
+        out.bounds.clear();
+        out.vertices.clear();
+        out.triangles.clear();
+
+        size_t triangleCount = mesh.indices.size() / 3;
+        size_t vertexCount = mesh.vertices.size();
+        if(triangleCount == 0)
+            return;
+
+        // triangles around every vertex, in one flat array
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for(uint32_t index : mesh.indices)
+            adjacencyOffsets[index + 1]++;
+        for(size_t i = 0; i < vertexCount; i++)
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        std::vector<uint32_t> adjacency(mesh.indices.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for(size_t t = 0; t < triangleCount; t++)
+            for(int corner = 0; corner < 3; corner++)
+                adjacency[fill[mesh.indices[t * 3 + corner]]++] = static_cast<uint32_t>(t);
+
+        std::vector<bool> used(triangleCount, false);
+        // slot of every vertex in the current meshlet, 0xFF when it isn't in it
+        std::vector<uint8_t> slot(vertexCount, 0xFF);
+        Meshlet current = { 0, 0, 0, 0 };
+        glm::vec3 centerSum(0.0f);
+        size_t nextUnused = 0;
+
+        while(true)
+        {
+            // the best neighbour of the current meshlet, or the next unused triangle when it has none
+            size_t best = triangleCount;
+            uint32_t bestNew = 4;
+            float bestDistance = 0.0f;
+            glm::vec3 center = current.triangleCount > 0 ? centerSum / static_cast<float>(current.triangleCount) : glm::vec3(0.0f);
+            for(uint32_t v = 0; v < current.vertexCount; v++)
+            {
+                uint32_t vertex = out.vertices[current.vertexOffset + v];
+                for(uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+                {
+                    uint32_t t = adjacency[a];
+                    if(used[t])
+                        continue;
+                    uint32_t added = newVertices(mesh, slot, t);
+                    if(added > bestNew)
+                        continue;
+                    glm::vec3 offset = triangleCenter(mesh, t) - center;
+                    float distance = glm::dot(offset, offset);
+                    if(added < bestNew || distance < bestDistance)
+                    {
+                        best = t;
+                        bestNew = added;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            if(best == triangleCount)
+            {
+                while(nextUnused < triangleCount && used[nextUnused])
+                    nextUnused++;
+                if(nextUnused == triangleCount)
+                    break;
+                best = nextUnused;
+                bestNew = newVertices(mesh, slot, best);
+            }
+
+            if(current.vertexCount + bestNew > maxVertices || current.triangleCount + 1 > maxTriangles)
+            {
+                finish(mesh, out, current, slot);
+                current.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+                current.triangleOffset = static_cast<uint32_t>(out.triangles.size() / 3);
+                current.vertexCount = 0;
+                current.triangleCount = 0;
+                centerSum = glm::vec3(0.0f);
+                // the triangle that didn't fit starts the next one, so it begins right next to where this one stopped
+            }
+
+            used[best] = true;
+            for(int corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = mesh.indices[best * 3 + corner];
+                if(slot[vertex] == 0xFF)
+                {
+                    slot[vertex] = static_cast<uint8_t>(current.vertexCount++);
+                    out.vertices.push_back(vertex);
+                }
+                out.triangles.push_back(slot[vertex]);
+            }
+            current.triangleCount++;
+            centerSum += triangleCenter(mesh, best);
+        }
+        if(current.triangleCount > 0)
+            finish(mesh, out, current, slot);
+    }
+
+    // bounding sphere around the vertices (centered on their box) and the backface cone of the triangles
+    static MeshletBounds computeBounds(const MeshData &mesh, const MeshletMesh &meshlets, const Meshlet &meshlet)
+    {
+        MeshletBounds bounds;
+        glm::vec3 low(mesh.vertices[meshlets.vertices[meshlet.vertexOffset]].position), high(low);
+        for(uint32_t v = 0; v < meshlet.vertexCount; v++)
+        {
+            const glm::vec3 &p = mesh.vertices[meshlets.vertices[meshlet.vertexOffset + v]].position;
+            low = glm::min(low, p);
+            high = glm::max(high, p);
+        }
+        bounds.center = (low + high) * 0.5f;
+        bounds.radius = 0.0f;
+        for(uint32_t v = 0; v < meshlet.vertexCount; v++)
+            bounds.radius = std::max(bounds.radius, glm::length(mesh.vertices[meshlets.vertices[meshlet.vertexOffset + v]].position - bounds.center));
+
+        // the axis is the average facing, the cutoff comes from the normal furthest from it
+        std::vector<glm::vec3> normals(meshlet.triangleCount);
+        std::vector<glm::vec3> corners(meshlet.triangleCount);
+        glm::vec3 axis(0.0f);
+        for(uint32_t t = 0; t < meshlet.triangleCount; t++)
+        {
+            const uint8_t *local = &meshlets.triangles[(meshlet.triangleOffset + t) * 3];
+            glm::vec3 a = mesh.vertices[meshlets.vertices[meshlet.vertexOffset + local[0]]].position;
+            glm::vec3 b = mesh.vertices[meshlets.vertices[meshlet.vertexOffset + local[1]]].position;
+            glm::vec3 c = mesh.vertices[meshlets.vertices[meshlet.vertexOffset + local[2]]].position;
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float length = glm::length(n);
+            normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+            corners[t] = a;
+            axis += normals[t];
+        }
+        float axisLength = glm::length(axis);
+        float minDot = 1.0f;
+        if(axisLength > 0.0f)
+        {
+            axis /= axisLength;
+            for(const glm::vec3 &n : normals)
+                if(n != glm::vec3(0.0f))
+                    minDot = std::min(minDot, glm::dot(n, axis));
+        }
+        else
+            minDot = -1.0f;
+
+        bounds.coneAxis = axis;
+        bounds.coneApex = bounds.center;
+        bounds.coneCutoff = 1.0f;
+        // past about 84 degrees the cone hardly culls anything and the apex runs off to infinity
+        if(minDot > 0.1f)
+        {
+            // move the apex back along the axis until every triangle's plane is in front of it
+            float maxT = 0.0f;
+            for(uint32_t t = 0; t < meshlet.triangleCount; t++)
+            {
+                if(normals[t] == glm::vec3(0.0f))
+                    continue;
+                float distance = glm::dot(bounds.center - corners[t], normals[t]);
+                maxT = std::max(maxT, distance / glm::dot(axis, normals[t]));
+            }
+            bounds.coneApex = bounds.center - axis * maxT;
+            bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+        return bounds;
+    }
+
+private:
+    static uint32_t newVertices(const MeshData &mesh, const std::vector<uint8_t> &slot, size_t t)
+    {
+        return (slot[mesh.indices[t * 3]] == 0xFF) + (slot[mesh.indices[t * 3 + 1]] == 0xFF) + (slot[mesh.indices[t * 3 + 2]] == 0xFF);
+    }
+
+    static glm::vec3 triangleCenter(const MeshData &mesh, size_t t)
+    {
+        return (mesh.vertices[mesh.indices[t * 3]].position + mesh.vertices[mesh.indices[t * 3 + 1]].position + mesh.vertices[mesh.indices[t * 3 + 2]].position) / 3.0f;
+    }
+
+    static void finish(const MeshData &mesh, MeshletMesh &out, const Meshlet &meshlet, std::vector<uint8_t> &slot)
+    {
+        for(uint32_t v = 0; v < meshlet.vertexCount; v++)
+            slot[out.vertices[meshlet.vertexOffset + v]] = 0xFF;
+        out.meshlets.push_back(meshlet);
+        out.bounds.push_back(computeBounds(mesh, out, meshlet));
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,347 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <mesh/mesh_data.h>
+#include <threading/thread_pool.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Wavefront OBJ geometry (v, vt, vn and f, polygons are fanned into triangles; groups, materials and lines are skipped).
+// The file is streamed in blocks, every block is cut at line ends into one range per thread and the ranges are parsed in
+// parallel; only stitching the ranges together and welding the corners into indexed vertices is serial
+class ObjLoader
+{
+public:
+    static const size_t BLOCK_SIZE = 8 << 20;
+    static const size_t MIN_RANGE_SIZE = 64 << 10;
+
+    static bool load(const std::string &path, MeshData &mesh, ThreadPool *pool = nullptr)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+        {
+            std::cout << "ERROR::OBJ_LOADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+
+        ObjChunk all;
+        std::string block;
+        std::string carry;
+        std::vector<char> buffer(BLOCK_SIZE);
+        while(file)
+        {
+            file.read(buffer.data(), buffer.size());
+            std::streamsize got = file.gcount();
+            if(got <= 0)
+                break;
+
+            // whatever follows the last line end belongs to the next block
+            block.swap(carry);
+            block.append(buffer.data(), static_cast<size_t>(got));
+            size_t lastLine = block.find_last_of('\n');
+            if(lastLine == std::string::npos)
+            {
+                carry.swap(block);
+                block.clear();
+                continue;
+            }
+            carry.assign(block, lastLine + 1, std::string::npos);
+            block.resize(lastLine + 1);
+            parseBlock(block, all, pool);
+        }
+        if(!carry.empty())
+        {
+            carry += '\n';
+            parseBlock(carry, all, pool);
+        }
+
+        if(all.corners.empty())
+        {
+            std::cout << "ERROR::OBJ_LOADER::NO_FACES " << path << std::endl;
+            return false;
+        }
+        return weld(all, mesh, path);
+    }
+
+private:
+    // a corner's indices, 0 based once resolved. Indices relative to the end of the list (negative in the file) can't be
+    // resolved while ranges are parsed in parallel, they are kept as RELATIVE + the index within the range (which is
+    // negative when it points into an earlier range) until the range is stitched on
+    struct ObjCorner
+    {
+        int64_t position;
+        int64_t texCoord;
+        int64_t normal;
+    };
+
+    static const int64_t MISSING = INT64_MIN;
+    static const int64_t RELATIVE = INT64_MIN / 2;
+
+    struct ObjChunk
+    {
+        std::vector<float> positions;
+        std::vector<float> texCoords;
+        std::vector<float> normals;
+        std::vector<ObjCorner> corners;
+        std::vector<uint32_t> faceSizes;
+    };
+
+    static void parseBlock(const std::string &block, ObjChunk &all, ThreadPool *pool)
+    {
+        // cut into ranges that end on a line end
+        size_t threads = pool ? pool->size() : 1;
+        size_t rangeSize = block.size() / threads + 1;
+        if(rangeSize < MIN_RANGE_SIZE)
+            rangeSize = MIN_RANGE_SIZE;
+        std::vector<size_t> starts;
+        size_t start = 0;
+        while(start < block.size())
+        {
+            starts.push_back(start);
+            size_t end = block.find('\n', std::min(block.size() - 1, start + rangeSize));
+            start = end == std::string::npos ? block.size() : end + 1;
+        }
+        starts.push_back(block.size());
+
+        std::vector<ObjChunk> chunks(starts.size() - 1);
+        auto parseRanges = [&](size_t first, size_t last)
+        {
+            for(size_t i = first; i < last; i++)
+                parseRange(block.c_str() + starts[i], block.c_str() + starts[i + 1], chunks[i]);
+        };
+        if(pool && chunks.size() > 1)
+            pool->parallelFor(chunks.size(), 1, parseRanges);
+        else
+            parseRanges(0, chunks.size());
+
+        for(ObjChunk &chunk : chunks)
+            stitch(chunk, all);
+    }
+
+    static void stitch(ObjChunk &chunk, ObjChunk &all)
+    {
+        int64_t positionBase = static_cast<int64_t>(all.positions.size() / 3);
+        int64_t texCoordBase = static_cast<int64_t>(all.texCoords.size() / 2);
+        int64_t normalBase = static_cast<int64_t>(all.normals.size() / 3);
+        for(ObjCorner &corner : chunk.corners)
+        {
+            corner.position = resolve(corner.position, positionBase);
+            corner.texCoord = resolve(corner.texCoord, texCoordBase);
+            corner.normal = resolve(corner.normal, normalBase);
+        }
+        all.positions.insert(all.positions.end(), chunk.positions.begin(), chunk.positions.end());
+        all.texCoords.insert(all.texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        all.normals.insert(all.normals.end(), chunk.normals.begin(), chunk.normals.end());
+        all.corners.insert(all.corners.end(), chunk.corners.begin(), chunk.corners.end());
+        all.faceSizes.insert(all.faceSizes.end(), chunk.faceSizes.begin(), chunk.faceSizes.end());
+    }
+
+    static int64_t resolve(int64_t index, int64_t base)
+    {
+        if(index == MISSING || index >= 0)
+            return index;
+        return base + (index - RELATIVE);
+    }
+
+    static const char *skipSpace(const char *c)
+    {
+        while(*c == ' ' || *c == '\t' || *c == '\r')
+            c++;
+        return c;
+    }
+
+    // missing components are 0, strtof alone would skip over the line end into the next line
+    static void readFloats(const char *c, const char *lineEnd, float *out, int count)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            c = skipSpace(c);
+            out[i] = 0.0f;
+            if(c >= lineEnd)
+                continue;
+            char *end;
+            out[i] = std::strtof(c, &end);
+            c = end;
+        }
+    }
+
+    // a 1 based index from the file, or one relative to the end of the list so far
+    static int64_t cornerIndex(long value, size_t localCount)
+    {
+        if(value > 0)
+            return value - 1;
+        if(value < 0)
+            return RELATIVE + static_cast<int64_t>(localCount) + value;
+        return MISSING;
+    }
+
+    static void parseRange(const char *c, const char *end, ObjChunk &chunk)
+    {
+        while(c < end)
+        {
+            c = skipSpace(c);
+            const char *lineEnd = c;
+            while(lineEnd < end && *lineEnd != '\n')
+                lineEnd++;
+
+            if(c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+            {
+                float p[3];
+                readFloats(c + 2, lineEnd, p, 3);
+                chunk.positions.insert(chunk.positions.end(), p, p + 3);
+            }
+            else if(c[0] == 'v' && c[1] == 't')
+            {
+                float t[2];
+                readFloats(c + 2, lineEnd, t, 2);
+                chunk.texCoords.insert(chunk.texCoords.end(), t, t + 2);
+            }
+            else if(c[0] == 'v' && c[1] == 'n')
+            {
+                float n[3];
+                readFloats(c + 2, lineEnd, n, 3);
+                chunk.normals.insert(chunk.normals.end(), n, n + 3);
+            }
+            else if(c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+                parseFace(c + 2, lineEnd, chunk);
+
+            c = lineEnd + 1;
+        }
+    }
+
+    // v, v/vt, v//vn or v/vt/vn per corner
+    static void parseFace(const char *c, const char *lineEnd, ObjChunk &chunk)
+    {
+        uint32_t size = 0;
+        while(true)
+        {
+            c = skipSpace(c);
+            if(c >= lineEnd || *c == '\r' || *c == '#')
+                break;
+            char *end;
+            long position = std::strtol(c, &end, 10);
+            if(end == c)
+                break;
+            c = end;
+
+            long texCoord = 0, normal = 0;
+            if(*c == '/')
+            {
+                c++;
+                if(*c != '/')
+                {
+                    texCoord = std::strtol(c, &end, 10);
+                    c = end;
+                }
+                if(*c == '/')
+                {
+                    c++;
+                    normal = std::strtol(c, &end, 10);
+                    c = end;
+                }
+            }
+            ObjCorner corner = {
+                cornerIndex(position, chunk.positions.size() / 3),
+                cornerIndex(texCoord, chunk.texCoords.size() / 2),
+                cornerIndex(normal, chunk.normals.size() / 3)
+            };
+            chunk.corners.push_back(corner);
+            size++;
+        }
+        chunk.faceSizes.push_back(size);
+    }
+
+    struct CornerHash
+    {
+        size_t operator()(const ObjCorner &corner) const
+        {
+            uint64_t h = static_cast<uint64_t>(corner.position) * 0x9E3779B97F4A7C15ull;
+            h ^= static_cast<uint64_t>(corner.texCoord) * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+            h ^= static_cast<uint64_t>(corner.normal) * 0x165667B19E3779F9ull + (h >> 32);
+            return static_cast<size_t>(h);
+        }
+    };
+
+    struct CornerEqual
+    {
+        bool operator()(const ObjCorner &a, const ObjCorner &b) const
+        {
+            return a.position == b.position && a.texCoord == b.texCoord && a.normal == b.normal;
+        }
+    };
+
+    // one vertex per distinct corner, faces fanned into triangles
+    static bool weld(const ObjChunk &all, MeshData &mesh, const std::string &path)
+    {
+        int64_t positionCount = static_cast<int64_t>(all.positions.size() / 3);
+        int64_t texCoordCount = static_cast<int64_t>(all.texCoords.size() / 2);
+        int64_t normalCount = static_cast<int64_t>(all.normals.size() / 3);
+
+        mesh.vertices.clear();
+        mesh.indices.clear();
+        std::unordered_map<ObjCorner, uint32_t, CornerHash, CornerEqual> welded;
+        welded.reserve(all.corners.size());
+        std::vector<uint32_t> faceIndices;
+        bool missingNormals = false;
+
+        size_t next = 0;
+        for(uint32_t size : all.faceSizes)
+        {
+            faceIndices.clear();
+            for(uint32_t i = 0; i < size; i++)
+            {
+                ObjCorner corner = all.corners[next + i];
+                if(corner.position < 0 || corner.position >= positionCount)
+                {
+                    std::cout << "ERROR::OBJ_LOADER::BAD_INDEX " << path << std::endl;
+                    return false;
+                }
+                if(corner.texCoord < 0 || corner.texCoord >= texCoordCount)
+                    corner.texCoord = MISSING;
+                if(corner.normal < 0 || corner.normal >= normalCount)
+                {
+                    corner.normal = MISSING;
+                    missingNormals = true;
+                }
+
+                auto found = welded.find(corner);
+                if(found == welded.end())
+                {
+                    MeshVertex vertex;
+                    const float *p = &all.positions[corner.position * 3];
+                    vertex.position = glm::vec3(p[0], p[1], p[2]);
+                    vertex.texCoord = glm::vec2(0.0f);
+                    if(corner.texCoord != MISSING)
+                        vertex.texCoord = glm::vec2(all.texCoords[corner.texCoord * 2], all.texCoords[corner.texCoord * 2 + 1]);
+                    vertex.normal = glm::vec3(0.0f);
+                    if(corner.normal != MISSING)
+                    {
+                        const float *n = &all.normals[corner.normal * 3];
+                        vertex.normal = glm::vec3(n[0], n[1], n[2]);
+                    }
+                    found = welded.emplace(corner, static_cast<uint32_t>(mesh.vertices.size())).first;
+                    mesh.vertices.push_back(vertex);
+                }
+                faceIndices.push_back(found->second);
+            }
+            for(uint32_t i = 2; i < size; i++)
+            {
+                mesh.indices.push_back(faceIndices[0]);
+                mesh.indices.push_back(faceIndices[i - 1]);
+                mesh.indices.push_back(faceIndices[i]);
+            }
+            next += size;
+        }
+
+        if(missingNormals)
+            mesh.generateNormals();
+        return true;
+    }
+};
+#endif
\ No newline at end of file
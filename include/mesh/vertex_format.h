@@ -0,0 +1,369 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <renderer/gl_state.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// how one attribute is stored in the vertex buffer
+enum Vertex_Encoding {
+    ENCODING_FLOAT3,     // 12 bytes
+    ENCODING_FLOAT2,     // 8 bytes
+    ENCODING_SNORM16X4,  // 8 bytes, a position inside the mesh bounds, the 4th component only pads to 4 byte alignment
+    ENCODING_HALF2,      // 4 bytes, for texture coordinates that tile outside [0, 1]
+    ENCODING_UNORM16X2,  // 4 bytes, texture coordinates in [0, 1]
+    ENCODING_OCT16       // 4 bytes, an octahedral encoded unit vector as two snorm16
+};
+
+// attribute locations shared by every mesh shader, 2 to 5 are taken by the instance matrix
+enum Vertex_Location {
+    LOCATION_POSITION = 0,
+    LOCATION_TEXCOORD = 1,
+    LOCATION_NORMAL = 6
+};
+
+// what meshes are built from before packing
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+};
+
+struct VertexAttribute
+{
+    unsigned int location;
+    Vertex_Encoding encoding;
+    unsigned int offset;
+};
+
+// interleaved layout of one vertex, the vertex array setup is generated from it
+struct VertexFormat
+{
+    std::vector<VertexAttribute> attributes;
+    unsigned int stride;
+
+    VertexFormat() : stride(0)
+    {
+    }
+
+    VertexFormat &add(unsigned int location, Vertex_Encoding encoding)
+    {
+        VertexAttribute attribute = { location, encoding, stride };
+        attributes.push_back(attribute);
+        stride += sizeOf(encoding);
+        return *this;
+    }
+
+    const VertexAttribute *find(unsigned int location) const
+    {
+        for(const VertexAttribute &attribute : attributes)
+            if(attribute.location == location)
+                return &attribute;
+        return nullptr;
+    }
+
+    // positions are snorm16 inside the bounds and need the dequantize matrix of the packed mesh folded into their transform
+    bool quantizedPositions() const
+    {
+        const VertexAttribute *position = find(LOCATION_POSITION);
+        return position && position->encoding == ENCODING_SNORM16X4;
+    }
+
+    // the shader has to be built with OCT_NORMALS to decode these
+    bool octahedralNormals() const
+    {
+        const VertexAttribute *normal = find(LOCATION_NORMAL);
+        return normal && normal->encoding == ENCODING_OCT16;
+    }
+
+    static unsigned int sizeOf(Vertex_Encoding encoding)
+    {
+        switch(encoding)
+        {
+        case ENCODING_FLOAT3: return 12;
+        case ENCODING_FLOAT2: return 8;
+        case ENCODING_SNORM16X4: return 8;
+        case ENCODING_HALF2: return 4;
+        case ENCODING_UNORM16X2: return 4;
+        case ENCODING_OCT16: return 4;
+        }
+        return 0;
+    }
+
+    // 32 bytes, nothing lost
+    static VertexFormat full()
+    {
+        VertexFormat format;
+        format.add(LOCATION_POSITION, ENCODING_FLOAT3).add(LOCATION_TEXCOORD, ENCODING_FLOAT2).add(LOCATION_NORMAL, ENCODING_FLOAT3);
+        return format;
+    }
+
+    // 16 bytes: quantized positions, unorm16 texture coordinates (half floats if they tile) and octahedral normals
+    static VertexFormat compact(bool tilingTexCoords = false, bool normals = true)
+    {
+        VertexFormat format;
+        format.add(LOCATION_POSITION, ENCODING_SNORM16X4).add(LOCATION_TEXCOORD, tilingTexCoords ? ENCODING_HALF2 : ENCODING_UNORM16X2);
+        if(normals)
+            format.add(LOCATION_NORMAL, ENCODING_OCT16);
+        return format;
+    }
+};
+
+// vertices encoded for a format. Quantized positions are stored relative to a bounding cube (the same scale on every axis,
+// so the dequantize matrix is a uniform scale and normals transformed with the model matrix stay correct); fold dequantize
+// into the model matrix and the shader sees the original positions with no extra work
+struct PackedVertices
+{
+    std::vector<unsigned char> data;
+    unsigned int count;
+    glm::mat4 dequantize;
+};
+
+// one level of detail: a range of a mesh's indices, and how far (in mesh units) its surface is from the full mesh's
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+// a packed mesh on the GPU, indexed when indexType isn't 0
+struct MeshBuffers
+{
+    unsigned int vertexArray;
+    unsigned int vertexBuffer;
+    int vertexCount;
+    glm::mat4 dequantize;
+    VertexFormat format;
+    unsigned int indexBuffer = 0;
+    int indexCount = 0;
+    GLenum indexType = 0;
+    // levels of detail in the element buffer, finest first, with their errors in the units of the packed positions
+    // (dequantize takes them to mesh space); empty for meshes drawn whole
+    std::vector<MeshLod> lods;
+
+    // the count to draw with, indices (of the finest level) if there are any
+    int drawCount() const
+    {
+        if(!lods.empty())
+            return static_cast<int>(lods[0].indexCount);
+        return indexType != 0 ? indexCount : vertexCount;
+    }
+};
+
+class VertexPacker
+{
+public:
+    static PackedVertices pack(const std::vector<MeshVertex> &vertices, const VertexFormat &format)
+    {
+        PackedVertices packed;
+        packed.count = static_cast<unsigned int>(vertices.size());
+        packed.data.assign(vertices.size() * format.stride, 0);
+        packed.dequantize = glm::mat4(1.0f);
+
+        glm::vec3 center(0.0f);
+        float invHalfSize = 1.0f;
+        if(format.quantizedPositions() && !vertices.empty())
+        {
+            glm::vec3 low = vertices[0].position, high = vertices[0].position;
+            for(const MeshVertex &vertex : vertices)
+            {
+                low = glm::min(low, vertex.position);
+                high = glm::max(high, vertex.position);
+            }
+            center = (low + high) * 0.5f;
+            glm::vec3 half = (high - low) * 0.5f;
+            float halfSize = std::max(std::max(half.x, half.y), std::max(half.z, 1e-20f));
+            invHalfSize = 1.0f / halfSize;
+            packed.dequantize = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(halfSize));
+        }
+
+        for(size_t i = 0; i < vertices.size(); i++)
+        {
+            unsigned char *vertex = &packed.data[i * format.stride];
+            for(const VertexAttribute &attribute : format.attributes)
+            {
+                glm::vec3 value = attributeValue(vertices[i], attribute.location);
+                if(attribute.location == LOCATION_POSITION && attribute.encoding == ENCODING_SNORM16X4)
+                    value = (value - center) * invHalfSize;
+                encode(value, attribute.encoding, vertex + attribute.offset);
+            }
+        }
+        return packed;
+    }
+
+    // uploads into a new static buffer and vertex array, set up from the format
+    static MeshBuffers upload(GLStateCache &state, const std::vector<MeshVertex> &vertices, const VertexFormat &format)
+    {
+        PackedVertices packed = pack(vertices, format);
+
+        MeshBuffers mesh;
+        mesh.vertexCount = static_cast<int>(packed.count);
+        mesh.dequantize = packed.dequantize;
+        mesh.format = format;
+        glGenVertexArrays(1, &mesh.vertexArray);
+        glGenBuffers(1, &mesh.vertexBuffer);
+
+        state.bindVertexArray(mesh.vertexArray);
+        state.bindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(packed.data.size()), packed.data.data(), GL_STATIC_DRAW);
+        setupAttributes(format);
+        return mesh;
+    }
+
+    // points the attributes of the bound vertex array at the bound GL_ARRAY_BUFFER. The normalized integer formats are
+    // converted to float by the vertex fetch, so the shader declares them as plain vec2/vec3
+    static void setupAttributes(const VertexFormat &format, size_t baseOffset = 0)
+    {
+        GLsizei stride = static_cast<GLsizei>(format.stride);
+        for(const VertexAttribute &attribute : format.attributes)
+        {
+            const void *offset = (const void*)(baseOffset + attribute.offset);
+            switch(attribute.encoding)
+            {
+            case ENCODING_FLOAT3: glVertexAttribPointer(attribute.location, 3, GL_FLOAT, GL_FALSE, stride, offset); break;
+            case ENCODING_FLOAT2: glVertexAttribPointer(attribute.location, 2, GL_FLOAT, GL_FALSE, stride, offset); break;
+            case ENCODING_SNORM16X4: glVertexAttribPointer(attribute.location, 3, GL_SHORT, GL_TRUE, stride, offset); break;
+            case ENCODING_HALF2: glVertexAttribPointer(attribute.location, 2, GL_HALF_FLOAT, GL_FALSE, stride, offset); break;
+            case ENCODING_UNORM16X2: glVertexAttribPointer(attribute.location, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, offset); break;
+            case ENCODING_OCT16: glVertexAttribPointer(attribute.location, 2, GL_SHORT, GL_TRUE, stride, offset); break;
+            }
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+
+    // decodes count packed vertices back into mesh space (positions through dequantize), within the format's precision
+    static void unpack(const unsigned char *data, unsigned int count, const VertexFormat &format, const glm::mat4 &dequantize, std::vector<MeshVertex> &out)
+    {
+        out.resize(count);
+        for(unsigned int i = 0; i < count; i++)
+        {
+            MeshVertex &vertex = out[i];
+            vertex.position = glm::vec3(0.0f);
+            vertex.texCoord = glm::vec2(0.0f);
+            vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            for(const VertexAttribute &attribute : format.attributes)
+            {
+                glm::vec3 value = decode(data + static_cast<size_t>(i) * format.stride + attribute.offset, attribute.encoding);
+                if(attribute.location == LOCATION_POSITION)
+                    vertex.position = attribute.encoding == ENCODING_SNORM16X4 ? glm::vec3(dequantize * glm::vec4(value, 1.0f)) : value;
+                else if(attribute.location == LOCATION_TEXCOORD)
+                    vertex.texCoord = glm::vec2(value);
+                else if(attribute.location == LOCATION_NORMAL)
+                    vertex.normal = value;
+            }
+        }
+    }
+
+    // unit vector to the octahedron folded onto [-1, 1]^2
+    static glm::vec2 octEncode(glm::vec3 n)
+    {
+        n /= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        glm::vec2 e(n.x, n.y);
+        if(n.z < 0.0f)
+        {
+            e.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            e.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return e;
+    }
+
+    // the same as octDecode in vertex_decode.glsl
+    static glm::vec3 octDecode(glm::vec2 e)
+    {
+        glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+private:
+    static glm::vec3 attributeValue(const MeshVertex &vertex, unsigned int location)
+    {
+        if(location == LOCATION_TEXCOORD)
+            return glm::vec3(vertex.texCoord, 0.0f);
+        if(location == LOCATION_NORMAL)
+            return vertex.normal;
+        return vertex.position;
+    }
+
+    static glm::vec3 decode(const unsigned char *in, Vertex_Encoding encoding)
+    {
+        glm::vec3 value(0.0f);
+        uint16_t packed[3];
+        switch(encoding)
+        {
+        case ENCODING_FLOAT3:
+            std::memcpy(&value[0], in, 12);
+            break;
+        case ENCODING_FLOAT2:
+            std::memcpy(&value[0], in, 8);
+            break;
+        case ENCODING_SNORM16X4:
+            std::memcpy(packed, in, 6);
+            value = glm::vec3(glm::unpackSnorm1x16(packed[0]), glm::unpackSnorm1x16(packed[1]), glm::unpackSnorm1x16(packed[2]));
+            break;
+        case ENCODING_HALF2:
+            std::memcpy(packed, in, 4);
+            value = glm::vec3(glm::unpackHalf1x16(packed[0]), glm::unpackHalf1x16(packed[1]), 0.0f);
+            break;
+        case ENCODING_UNORM16X2:
+            std::memcpy(packed, in, 4);
+            value = glm::vec3(glm::unpackUnorm1x16(packed[0]), glm::unpackUnorm1x16(packed[1]), 0.0f);
+            break;
+        case ENCODING_OCT16:
+            std::memcpy(packed, in, 4);
+            value = octDecode(glm::vec2(glm::unpackSnorm1x16(packed[0]), glm::unpackSnorm1x16(packed[1])));
+            break;
+        }
+        return value;
+    }
+
+    static void encode(glm::vec3 value, Vertex_Encoding encoding, unsigned char *out)
+    {
+        uint16_t packed[4] = { 0, 0, 0, 0 };
+        switch(encoding)
+        {
+        case ENCODING_FLOAT3:
+            std::memcpy(out, &value[0], 12);
+            return;
+        case ENCODING_FLOAT2:
+            std::memcpy(out, &value[0], 8);
+            return;
+        case ENCODING_SNORM16X4:
+            for(int i = 0; i < 3; i++)
+                packed[i] = glm::packSnorm1x16(value[i]);
+            std::memcpy(out, packed, 8);
+            return;
+        case ENCODING_HALF2:
+            packed[0] = glm::packHalf1x16(value.x);
+            packed[1] = glm::packHalf1x16(value.y);
+            break;
+        case ENCODING_UNORM16X2:
+            // clamped, use ENCODING_HALF2 for coordinates that tile
+            packed[0] = glm::packUnorm1x16(value.x);
+            packed[1] = glm::packUnorm1x16(value.y);
+            break;
+        case ENCODING_OCT16:
+        {
+            glm::vec2 e = octEncode(value);
+            packed[0] = glm::packSnorm1x16(e.x);
+            packed[1] = glm::packSnorm1x16(e.y);
+            break;
+        }
+        }
+        std::memcpy(out, packed, 4);
+    }
+};
+#endif
\ No newline at end of file
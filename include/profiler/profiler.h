@@ -0,0 +1,91 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <iomanip>
+
+// collects named per-frame counters and averages them over a reporting window, so stats can be shown once a second instead of every frame.
+// a counter is averaged over the frames that set it, so occasional samples (e.g. latency when there was input) aren't diluted
+class Profiler
+{
+public:
+    // seconds of frames averaged into each report
+    float ReportInterval;
+
+    Profiler(float reportInterval = 1.0f) : ReportInterval(reportInterval), frameCount(0), windowTime(0.0f), averageFrameTime(0.0f)
+    {
+    }
+
+    // sets the value of a counter for the current frame (overwrites anything set earlier this frame)
+    void setCounter(const std::string &name, double value)
+    {
+        frame[name] = value;
+    }
+
+    // adds to the value of a counter for the current frame
+    void addCounter(const std::string &name, double value)
+    {
+        frame[name] += value;
+    }
+
+    // finishes the current frame, returns true when a new report is ready
+    bool endFrame(float frameTime)
+    {
+        for(const auto &counter : frame)
+        {
+            totals[counter.first] += counter.second;
+            samples[counter.first]++;
+        }
+        frame.clear();
+
+        frameCount++;
+        windowTime += frameTime;
+        if(windowTime < ReportInterval)
+            return false;
+
+        averages.clear();
+        for(const auto &total : totals)
+            averages[total.first] = total.second / samples[total.first];
+        averageFrameTime = windowTime / frameCount;
+
+        totals.clear();
+        samples.clear();
+        frameCount = 0;
+        windowTime = 0.0f;
+        return true;
+    }
+
+    // average value of a counter over the last completed report window
+    double GetAverage(const std::string &name) const
+    {
+        auto it = averages.find(name);
+        return it == averages.end() ? 0.0 : it->second;
+    }
+
+    float GetAverageFrameTime() const
+    {
+        return averageFrameTime;
+    }
+
+    // formats the last report as a single line, e.g. "16.67 ms | gl_issued 24 | gl_skipped 9"
+    std::string GetReport() const
+    {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << averageFrameTime * 1000.0f << " ms";
+        for(const auto &average : averages)
+            out << " | " << average.first << " " << average.second;
+        return out.str();
+    }
+
+private:
+    std::map<std::string, double> frame;
+    std::map<std::string, double> totals;
+    std::map<std::string, unsigned int> samples;
+    std::map<std::string, double> averages;
+    unsigned int frameCount;
+    float windowTime;
+    float averageFrameTime;
+};
+#endif
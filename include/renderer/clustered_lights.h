@@ -0,0 +1,248 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <renderer/gl_state.h>
+#include <threading/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// a point light as the shaders read it: world space position and the distance at which it has faded out, color
+// premultiplied by intensity
+struct PointLight
+{
+    glm::vec4 positionRadius;
+    glm::vec4 color;
+};
+
+// clustered forward lighting: the view frustum is cut into CLUSTERS_X x CLUSTERS_Y tiles on screen and CLUSTERS_Z
+// slices in depth (exponentially spaced, so clusters stay roughly cube shaped), and every light is listed in the
+// clusters its sphere touches. A fragment finds its cluster from gl_FragCoord and only loops over that cluster's lights
+// (see CLUSTERED_LIGHTS in lighting.glsl), so its cost depends on how many lights overlap it, not on how many there are.
+// Binning runs on the CPU every frame, one depth slice per pool job, and goes up to the GPU in three storage buffers
+class ClusteredLights
+{
+public:
+    static const unsigned int CLUSTERS_X = 16;
+    static const unsigned int CLUSTERS_Y = 9;
+    static const unsigned int CLUSTERS_Z = 24;
+    static const unsigned int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+    // storage buffer bindings of the light list, the cluster grid and the light indices (the meshlet culling uses 0-2)
+    static const unsigned int LIGHT_BINDING = 3;
+    static const unsigned int CLUSTER_BINDING = 4;
+    static const unsigned int INDEX_BINDING = 5;
+
+    ClusteredLights() : lightBuffer(0), clusterBuffer(0), indexBuffer(0), indexCount(0)
+    {
+    }
+
+    void create()
+    {
+        glGenBuffers(1, &lightBuffer);
+        glGenBuffers(1, &clusterBuffer);
+        glGenBuffers(1, &indexBuffer);
+    }
+
+    // the lights to bin from now on; they can be changed every frame
+    std::vector<PointLight> &lights()
+    {
+        return lightList;
+    }
+
+    // bins the lights for this frame's camera and uploads everything, then binds the buffers for the draws.
+    // viewport is the framebuffer size in pixels, nearPlane and farPlane the projection's
+    void update(GLStateCache &state, const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane, int viewportWidth, int viewportHeight, ThreadPool *pool = nullptr)
+    {
+        float sliceScale = CLUSTERS_Z / std::log(farPlane / nearPlane);
+        computeBounds(view, projection, nearPlane, farPlane, sliceScale, pool);
+
+        // each slice bins into its own list, in cluster order; afterwards they are joined in slice order
+        auto binSlices = [&](size_t first, size_t last)
+        {
+            for(size_t slice = first; slice < last; slice++)
+                binSlice(static_cast<unsigned int>(slice));
+        };
+        if(pool)
+            pool->parallelFor(CLUSTERS_Z, 1, binSlices);
+        else
+            binSlices(0, CLUSTERS_Z);
+
+        uint32_t base = 0;
+        for(unsigned int slice = 0; slice < CLUSTERS_Z; slice++)
+        {
+            ClusterRange *ranges = &grid.clusters[slice * CLUSTERS_X * CLUSTERS_Y];
+            for(unsigned int c = 0; c < CLUSTERS_X * CLUSTERS_Y; c++)
+                ranges[c].offset += base;
+            base += static_cast<uint32_t>(sliceIndices[slice].size());
+        }
+        indices.resize(std::max<size_t>(base, 1));
+        for(unsigned int slice = 0, at = 0; slice < CLUSTERS_Z; slice++)
+        {
+            std::copy(sliceIndices[slice].begin(), sliceIndices[slice].end(), indices.begin() + at);
+            at += static_cast<unsigned int>(sliceIndices[slice].size());
+        }
+        indexCount = base;
+
+        // what the shader needs to find a fragment's cluster
+        grid.scale = glm::vec4(static_cast<float>(CLUSTERS_X) / viewportWidth, static_cast<float>(CLUSTERS_Y) / viewportHeight, sliceScale, -std::log(nearPlane) * sliceScale);
+        grid.depth = glm::vec4(nearPlane, farPlane, 0.0f, 0.0f);
+
+        // a fresh store every frame, the driver hands out new memory instead of waiting on last frame's draws
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, lightBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(lightList.size(), 1) * sizeof(PointLight), lightList.empty() ? nullptr : lightList.data(), GL_STREAM_DRAW);
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, clusterBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterGrid), &grid, GL_STREAM_DRAW);
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STREAM_DRAW);
+
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, lightBuffer);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, clusterBuffer);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, indexBuffer);
+    }
+
+    // light indices over all clusters in the last update(), and the most any one cluster got
+    size_t assignedCount() const
+    {
+        return indexCount;
+    }
+
+    unsigned int busiestCluster() const
+    {
+        unsigned int most = 0;
+        for(unsigned int c = 0; c < CLUSTER_COUNT; c++)
+            most = std::max(most, grid.clusters[c].count);
+        return most;
+    }
+
+private:
+    struct ClusterRange
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // laid out like the std430 ClusterBuffer block in lighting.glsl
+    struct ClusterGrid
+    {
+        // tiles per pixel in x and y, then slice = log(depth) * z + w
+        glm::vec4 scale;
+        // near and far plane
+        glm::vec4 depth;
+        ClusterRange clusters[CLUSTER_COUNT];
+    };
+
+    // the clusters a light touches, inclusive; empty (first above last) when it is outside the frustum
+    struct LightBounds
+    {
+        int minX, maxX;
+        int minY, maxY;
+        int minZ, maxZ;
+    };
+
+    std::vector<PointLight> lightList;
+    std::vector<LightBounds> bounds;
+    std::vector<uint32_t> sliceIndices[CLUSTERS_Z];
+    std::vector<uint32_t> indices;
+    ClusterGrid grid;
+    unsigned int lightBuffer;
+    unsigned int clusterBuffer;
+    unsigned int indexBuffer;
+    size_t indexCount;
+
+    // conservative cluster ranges of every light: its view space box, projected through whichever of its nearest and
+    // furthest depth pushes each side further out
+    void computeBounds(const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane, float sliceScale, ThreadPool *pool)
+    {
+        bounds.resize(lightList.size());
+        float sliceBias = -std::log(nearPlane) * sliceScale;
+        auto project = [&](size_t first, size_t last)
+        {
+            for(size_t i = first; i < last; i++)
+            {
+                LightBounds &light = bounds[i];
+                glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lightList[i].positionRadius), 1.0f));
+                float radius = lightList[i].positionRadius.w;
+                // view space looks down -z
+                float nearest = std::max(-center.z - radius, nearPlane);
+                float furthest = std::min(-center.z + radius, farPlane);
+                if(nearest > furthest)
+                {
+                    light = LightBounds{ 0, -1, 0, -1, 0, -1 };
+                    continue;
+                }
+                light.minZ = clampCell(std::log(nearest) * sliceScale + sliceBias, CLUSTERS_Z);
+                light.maxZ = clampCell(std::log(furthest) * sliceScale + sliceBias, CLUSTERS_Z);
+
+                float left = std::min((center.x - radius) / nearest, (center.x - radius) / furthest) * projection[0][0];
+                float right = std::max((center.x + radius) / nearest, (center.x + radius) / furthest) * projection[0][0];
+                float bottom = std::min((center.y - radius) / nearest, (center.y - radius) / furthest) * projection[1][1];
+                float top = std::max((center.y + radius) / nearest, (center.y + radius) / furthest) * projection[1][1];
+                if(right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f)
+                {
+                    light = LightBounds{ 0, -1, 0, -1, 0, -1 };
+                    continue;
+                }
+                light.minX = clampCell((left * 0.5f + 0.5f) * CLUSTERS_X, CLUSTERS_X);
+                light.maxX = clampCell((right * 0.5f + 0.5f) * CLUSTERS_X, CLUSTERS_X);
+                light.minY = clampCell((bottom * 0.5f + 0.5f) * CLUSTERS_Y, CLUSTERS_Y);
+                light.maxY = clampCell((top * 0.5f + 0.5f) * CLUSTERS_Y, CLUSTERS_Y);
+            }
+        };
+        if(pool)
+            pool->parallelFor(lightList.size(), 1024, project);
+        else
+            project(0, lightList.size());
+    }
+
+    static int clampCell(float cell, unsigned int cells)
+    {
+        return std::min(std::max(static_cast<int>(std::floor(cell)), 0), static_cast<int>(cells) - 1);
+    }
+
+    // counts, then fills, the lists of one depth slice; offsets come out relative to the slice's own list
+    void binSlice(unsigned int slice)
+    {
+        const int z = static_cast<int>(slice);
+        ClusterRange *ranges = &grid.clusters[slice * CLUSTERS_X * CLUSTERS_Y];
+        for(unsigned int c = 0; c < CLUSTERS_X * CLUSTERS_Y; c++)
+            ranges[c].count = 0;
+        for(const LightBounds &light : bounds)
+        {
+            if(z < light.minZ || z > light.maxZ)
+                continue;
+            for(int y = light.minY; y <= light.maxY; y++)
+                for(int x = light.minX; x <= light.maxX; x++)
+                    ranges[y * CLUSTERS_X + x].count++;
+        }
+
+        uint32_t offset = 0;
+        for(unsigned int c = 0; c < CLUSTERS_X * CLUSTERS_Y; c++)
+        {
+            ranges[c].offset = offset;
+            offset += ranges[c].count;
+            ranges[c].count = 0;
+        }
+        std::vector<uint32_t> &list = sliceIndices[slice];
+        list.resize(offset);
+        for(uint32_t i = 0; i < bounds.size(); i++)
+        {
+            const LightBounds &light = bounds[i];
+            if(z < light.minZ || z > light.maxZ)
+                continue;
+            for(int y = light.minY; y <= light.maxY; y++)
+            {
+                for(int x = light.minX; x <= light.maxX; x++)
+                {
+                    ClusterRange &range = ranges[y * CLUSTERS_X + x];
+                    list[range.offset + range.count++] = i;
+                }
+            }
+        }
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,301 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <renderer/gl_state.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// packet types. Handles and enums inside the packets are plain 32 bit values, only the backend knows they are GL names
+enum Command_Type {
+    CMD_SET_DEPTH_TEST,
+    CMD_USE_PROGRAM,
+    CMD_BIND_VERTEX_ARRAY,
+    CMD_BIND_TEXTURE,
+    CMD_SET_MODEL,
+    CMD_SET_OBJECT_ID,
+    CMD_DRAW
+};
+
+// every packet starts with this, size covers the whole packet so unknown packets can be skipped
+struct CommandHeader
+{
+    uint16_t type;
+    uint16_t size;
+};
+
+struct CmdSetDepthTest
+{
+    CommandHeader header;
+    uint32_t enabled;
+};
+
+struct CmdUseProgram
+{
+    CommandHeader header;
+    uint32_t program;
+};
+
+struct CmdBindVertexArray
+{
+    CommandHeader header;
+    uint32_t vao;
+};
+
+struct CmdBindTexture
+{
+    CommandHeader header;
+    uint32_t unit;
+    uint32_t texture;
+};
+
+// sets the "model" matrix of the current program, the backend resolves the uniform location
+struct CmdSetModel
+{
+    CommandHeader header;
+    float model[16];
+};
+
+// sets the "objectId" of the current program, for the object id buffer
+struct CmdSetObjectId
+{
+    CommandHeader header;
+    uint32_t id;
+};
+
+struct CmdDraw
+{
+    CommandHeader header;
+    uint32_t mode;
+    int32_t first;
+    int32_t count;
+    // 0 draws arrays, otherwise GL_UNSIGNED_SHORT or GL_UNSIGNED_INT from the bound element buffer with first as the first index
+    uint32_t indexType;
+};
+
+// a linear block of POD packets. Recording does not touch GL, so any thread can fill one;
+// only replay (GLCommandBackend) has to run on the thread that owns the context
+class CommandBuffer
+{
+public:
+    CommandBuffer()
+    {
+        clear();
+    }
+
+    // drops the packets but keeps the memory for the next frame
+    void clear()
+    {
+        data.clear();
+        program = ~0u;
+        vao = ~0u;
+        depthTest = ~0u;
+        objectId = ~0u;
+        for(unsigned int i = 0; i < MAX_UNITS; i++)
+            textures[i] = ~0u;
+    }
+
+    void reserve(size_t bytes)
+    {
+        data.reserve(bytes);
+    }
+
+    size_t sizeInBytes() const
+    {
+        return data.size();
+    }
+
+    // the record functions drop packets that repeat state already set earlier in this buffer
+
+    void setDepthTest(bool enabled)
+    {
+        if(depthTest == (unsigned int)enabled)
+            return;
+        depthTest = enabled;
+        push<CmdSetDepthTest>(CMD_SET_DEPTH_TEST).enabled = enabled;
+    }
+
+    void useProgram(uint32_t id)
+    {
+        if(program == id)
+            return;
+        program = id;
+        // uniforms belong to the program, the next one needs its object id set again
+        objectId = ~0u;
+        push<CmdUseProgram>(CMD_USE_PROGRAM).program = id;
+    }
+
+    void bindVertexArray(uint32_t id)
+    {
+        if(vao == id)
+            return;
+        vao = id;
+        push<CmdBindVertexArray>(CMD_BIND_VERTEX_ARRAY).vao = id;
+    }
+
+    void bindTexture(uint32_t unit, uint32_t id)
+    {
+        if(unit < MAX_UNITS)
+        {
+            if(textures[unit] == id)
+                return;
+            textures[unit] = id;
+        }
+        CmdBindTexture &cmd = push<CmdBindTexture>(CMD_BIND_TEXTURE);
+        cmd.unit = unit;
+        cmd.texture = id;
+    }
+
+    void setModel(const float *model)
+    {
+        memcpy(push<CmdSetModel>(CMD_SET_MODEL).model, model, sizeof(float) * 16);
+    }
+
+    void setObjectId(uint32_t id)
+    {
+        if(objectId == id)
+            return;
+        objectId = id;
+        push<CmdSetObjectId>(CMD_SET_OBJECT_ID).id = id;
+    }
+
+    void draw(uint32_t mode, int32_t first, int32_t count, uint32_t indexType = 0)
+    {
+        CmdDraw &cmd = push<CmdDraw>(CMD_DRAW);
+        cmd.mode = mode;
+        cmd.first = first;
+        cmd.count = count;
+        cmd.indexType = indexType;
+    }
+
+    // packet iteration, used by the backend
+    const unsigned char *begin() const
+    {
+        return data.data();
+    }
+
+    const unsigned char *end() const
+    {
+        return data.data() + data.size();
+    }
+
+private:
+    static const unsigned int MAX_UNITS = 16;
+
+    std::vector<unsigned char> data;
+    uint32_t program;
+    uint32_t vao;
+    uint32_t depthTest;
+    uint32_t objectId;
+    uint32_t textures[MAX_UNITS];
+
+    template<typename T>
+    T &push(Command_Type type)
+    {
+        size_t offset = data.size();
+        data.resize(offset + sizeof(T));
+        T *packet = reinterpret_cast<T*>(data.data() + offset);
+        packet->header.type = (uint16_t)type;
+        packet->header.size = (uint16_t)sizeof(T);
+        return *packet;
+    }
+};
+
+// replays recorded packets on the GL thread, going through the state cache so redundant packets across buffers still get dropped.
+// Programs without an "objectId" uniform don't write an object id, so their draws leave draw buffer 1 alone
+class GLCommandBackend
+{
+public:
+    void replay(const CommandBuffer &buffer, GLStateCache &state)
+    {
+        const unsigned char *cursor = buffer.begin();
+        const unsigned char *end = buffer.end();
+        while(cursor < end)
+        {
+            const CommandHeader *header = reinterpret_cast<const CommandHeader*>(cursor);
+            switch(header->type)
+            {
+                case CMD_SET_DEPTH_TEST:
+                {
+                    const CmdSetDepthTest *cmd = reinterpret_cast<const CmdSetDepthTest*>(cursor);
+                    state.setEnabled(GL_DEPTH_TEST, cmd->enabled != 0);
+                    break;
+                }
+                case CMD_USE_PROGRAM:
+                {
+                    const CmdUseProgram *cmd = reinterpret_cast<const CmdUseProgram*>(cursor);
+                    state.useProgram(cmd->program);
+                    locations = lookupLocations(cmd->program);
+                    state.setColorWrites(1, locations.objectId >= 0);
+                    break;
+                }
+                case CMD_BIND_VERTEX_ARRAY:
+                {
+                    const CmdBindVertexArray *cmd = reinterpret_cast<const CmdBindVertexArray*>(cursor);
+                    state.bindVertexArray(cmd->vao);
+                    break;
+                }
+                case CMD_BIND_TEXTURE:
+                {
+                    const CmdBindTexture *cmd = reinterpret_cast<const CmdBindTexture*>(cursor);
+                    state.bindTexture(cmd->unit, GL_TEXTURE_2D, cmd->texture);
+                    break;
+                }
+                case CMD_SET_MODEL:
+                {
+                    const CmdSetModel *cmd = reinterpret_cast<const CmdSetModel*>(cursor);
+                    if(locations.model >= 0)
+                        glUniformMatrix4fv(locations.model, 1, GL_FALSE, cmd->model);
+                    break;
+                }
+                case CMD_SET_OBJECT_ID:
+                {
+                    const CmdSetObjectId *cmd = reinterpret_cast<const CmdSetObjectId*>(cursor);
+                    if(locations.objectId >= 0)
+                        glUniform1ui(locations.objectId, cmd->id);
+                    break;
+                }
+                case CMD_DRAW:
+                {
+                    const CmdDraw *cmd = reinterpret_cast<const CmdDraw*>(cursor);
+                    if(cmd->indexType == 0)
+                        glDrawArrays(cmd->mode, cmd->first, cmd->count);
+                    else
+                    {
+                        size_t indexSize = cmd->indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+                        glDrawElements(cmd->mode, cmd->count, cmd->indexType, (void*)(cmd->first * indexSize));
+                    }
+                    break;
+                }
+            }
+            cursor += header->size;
+        }
+    }
+
+private:
+    struct UniformLocations
+    {
+        int model = -1;
+        int objectId = -1;
+    };
+
+    UniformLocations locations;
+    std::unordered_map<uint32_t, UniformLocations> programLocations;
+
+    UniformLocations lookupLocations(uint32_t program)
+    {
+        auto it = programLocations.find(program);
+        if(it != programLocations.end())
+            return it->second;
+        UniformLocations found;
+        found.model = glGetUniformLocation(program, "model");
+        found.objectId = glGetUniformLocation(program, "objectId");
+        programLocations[program] = found;
+        return found;
+    }
+};
+#endif
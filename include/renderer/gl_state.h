@@ -0,0 +1,320 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// shadows the bits of GL state the renderer touches and skips calls that would not change anything.
+// every bind/enable in the renderer should go through here, otherwise the shadow copy goes stale (call invalidate() if it has to be bypassed)
+class GLStateCache
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const unsigned int MAX_BUFFER_BINDINGS = 16;
+    static const unsigned int MAX_DRAW_BUFFERS = 8;
+
+    GLStateCache()
+    {
+        invalidate();
+        resetFrameCounters();
+    }
+
+    // forget everything we know, the next call of each kind always reaches the driver
+    void invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        framebuffer = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for(unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            for(unsigned int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+                textures[unit][target] = UNKNOWN;
+        for(unsigned int target = 0; target < BUFFER_TARGET_COUNT; target++)
+        {
+            buffers[target] = UNKNOWN;
+            for(unsigned int index = 0; index < MAX_BUFFER_BINDINGS; index++)
+                indexedBuffers[target][index] = UNKNOWN;
+        }
+        for(unsigned int cap = 0; cap < CAPABILITY_COUNT; cap++)
+            capabilities[cap] = TRISTATE_UNKNOWN;
+        for(unsigned int buffer = 0; buffer < MAX_DRAW_BUFFERS; buffer++)
+            colorWrites[buffer] = TRISTATE_UNKNOWN;
+        blendSrc = UNKNOWN;
+        blendDst = UNKNOWN;
+    }
+
+    void useProgram(unsigned int id)
+    {
+        if(check(program == id))
+            return;
+        program = id;
+        glUseProgram(id);
+    }
+
+    void bindVertexArray(unsigned int id)
+    {
+        if(check(vertexArray == id))
+            return;
+        vertexArray = id;
+        // the element buffer binding is part of the vertex array object
+        buffers[ELEMENT_ARRAY] = UNKNOWN;
+        glBindVertexArray(id);
+    }
+
+    // binds for both drawing and reading, 0 is the window
+    void bindFramebuffer(unsigned int id)
+    {
+        if(check(framebuffer == id))
+            return;
+        framebuffer = id;
+        glBindFramebuffer(GL_FRAMEBUFFER, id);
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if(check(activeUnit == unit))
+            return;
+        activeUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds a texture to the given unit, only switching the active unit when the binding actually changes
+    void bindTexture(unsigned int unit, GLenum target, unsigned int id)
+    {
+        int slot = textureSlot(target);
+        if(slot < 0 || unit >= MAX_TEXTURE_UNITS)
+        {
+            activeTexture(unit);
+            issue();
+            glBindTexture(target, id);
+            return;
+        }
+        if(check(textures[unit][slot] == id))
+            return;
+        activeTexture(unit);
+        textures[unit][slot] = id;
+        glBindTexture(target, id);
+    }
+
+    void bindBuffer(GLenum target, unsigned int id)
+    {
+        int slot = bufferSlot(target);
+        if(slot < 0)
+        {
+            issue();
+            glBindBuffer(target, id);
+            return;
+        }
+        if(check(buffers[slot] == id))
+            return;
+        buffers[slot] = id;
+        glBindBuffer(target, id);
+    }
+
+    // binds to an indexed binding point (uniform blocks, storage blocks); this also changes the generic binding
+    void bindBufferBase(GLenum target, unsigned int index, unsigned int id)
+    {
+        int slot = bufferSlot(target);
+        if(slot < 0 || index >= MAX_BUFFER_BINDINGS)
+        {
+            issue();
+            glBindBufferBase(target, index, id);
+            if(slot >= 0)
+                buffers[slot] = id;
+            return;
+        }
+        if(check(indexedBuffers[slot][index] == id && buffers[slot] == id))
+            return;
+        indexedBuffers[slot][index] = id;
+        buffers[slot] = id;
+        glBindBufferBase(target, index, id);
+    }
+
+    // binds part of a buffer to an indexed binding point. The range changes from call to call (ring buffers), so this is
+    // always issued; it still keeps the generic binding up to date
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int id, GLintptr offset, GLsizeiptr size)
+    {
+        issue();
+        glBindBufferRange(target, index, id, offset, size);
+        int slot = bufferSlot(target);
+        if(slot < 0)
+            return;
+        buffers[slot] = id;
+        if(index < MAX_BUFFER_BINDINGS)
+            indexedBuffers[slot][index] = UNKNOWN;
+    }
+
+    // glDeleteBuffers for one buffer. GL resets every binding of a deleted buffer to 0, and GL may hand the name out
+    // again, so the shadow copy has to drop it too or a later bind of the new buffer would be skipped
+    void deleteBuffer(unsigned int id)
+    {
+        for(unsigned int target = 0; target < BUFFER_TARGET_COUNT; target++)
+        {
+            if(buffers[target] == id)
+                buffers[target] = 0;
+            for(unsigned int index = 0; index < MAX_BUFFER_BINDINGS; index++)
+                if(indexedBuffers[target][index] == id)
+                    indexedBuffers[target][index] = 0;
+        }
+        glDeleteBuffers(1, &id);
+    }
+
+    // glEnable/glDisable for the capabilities we track (depth test, blending, face culling)
+    void setEnabled(GLenum cap, bool enabled)
+    {
+        int slot = capabilitySlot(cap);
+        if(slot < 0)
+        {
+            issue();
+            if(enabled)
+                glEnable(cap);
+            else
+                glDisable(cap);
+            return;
+        }
+        Tristate wanted = enabled ? TRISTATE_ON : TRISTATE_OFF;
+        if(check(capabilities[slot] == wanted))
+            return;
+        capabilities[slot] = wanted;
+        if(enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+
+    void enable(GLenum cap)
+    {
+        setEnabled(cap, true);
+    }
+
+    void disable(GLenum cap)
+    {
+        setEnabled(cap, false);
+    }
+
+    // glColorMaski with all four channels on or off, for one draw buffer of the bound framebuffer
+    void setColorWrites(unsigned int drawBuffer, bool enabled)
+    {
+        GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+        if(drawBuffer >= MAX_DRAW_BUFFERS)
+        {
+            issue();
+            glColorMaski(drawBuffer, mask, mask, mask, mask);
+            return;
+        }
+        Tristate wanted = enabled ? TRISTATE_ON : TRISTATE_OFF;
+        if(check(colorWrites[drawBuffer] == wanted))
+            return;
+        colorWrites[drawBuffer] = wanted;
+        glColorMaski(drawBuffer, mask, mask, mask, mask);
+    }
+
+    void blendFunc(GLenum src, GLenum dst)
+    {
+        if(check(blendSrc == src && blendDst == dst))
+            return;
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+
+    // the program currently bound, or 0 if unknown
+    unsigned int currentProgram() const
+    {
+        return program == UNKNOWN ? 0 : program;
+    }
+
+    // calls that reached the driver / were dropped since the last resetFrameCounters()
+    unsigned int issuedCalls() const
+    {
+        return issued;
+    }
+
+    unsigned int skippedCalls() const
+    {
+        return skipped;
+    }
+
+    void resetFrameCounters()
+    {
+        issued = 0;
+        skipped = 0;
+    }
+
+private:
+    static const unsigned int UNKNOWN = ~0u;
+
+    enum Tristate { TRISTATE_UNKNOWN, TRISTATE_OFF, TRISTATE_ON };
+    enum TextureTarget { TEXTURE_2D, TEXTURE_2D_ARRAY, TEXTURE_3D, TEXTURE_CUBE_MAP, TEXTURE_BUFFER, TEXTURE_TARGET_COUNT };
+    enum BufferTarget { ARRAY, ELEMENT_ARRAY, UNIFORM, SHADER_STORAGE, DRAW_INDIRECT, PIXEL_PACK, PIXEL_UNPACK, BUFFER_TARGET_COUNT };
+    enum Capability { DEPTH_TEST, BLEND, CULL_FACE, CAPABILITY_COUNT };
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int framebuffer;
+    unsigned int activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+    unsigned int buffers[BUFFER_TARGET_COUNT];
+    unsigned int indexedBuffers[BUFFER_TARGET_COUNT][MAX_BUFFER_BINDINGS];
+    Tristate capabilities[CAPABILITY_COUNT];
+    Tristate colorWrites[MAX_DRAW_BUFFERS];
+    GLenum blendSrc;
+    GLenum blendDst;
+
+    unsigned int issued;
+    unsigned int skipped;
+
+    // counts the call and returns true if it is redundant
+    bool check(bool redundant)
+    {
+        if(redundant)
+            skipped++;
+        else
+            issued++;
+        return redundant;
+    }
+
+    void issue()
+    {
+        issued++;
+    }
+
+    static int textureSlot(GLenum target)
+    {
+        switch(target)
+        {
+            case GL_TEXTURE_2D: return TEXTURE_2D;
+            case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+            case GL_TEXTURE_3D: return TEXTURE_3D;
+            case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+            case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+        }
+        return -1;
+    }
+
+    static int bufferSlot(GLenum target)
+    {
+        switch(target)
+        {
+            case GL_ARRAY_BUFFER: return ARRAY;
+            case GL_ELEMENT_ARRAY_BUFFER: return ELEMENT_ARRAY;
+            case GL_UNIFORM_BUFFER: return UNIFORM;
+            case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE;
+            case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT;
+            case GL_PIXEL_PACK_BUFFER: return PIXEL_PACK;
+            case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK;
+        }
+        return -1;
+    }
+
+    static int capabilitySlot(GLenum cap)
+    {
+        switch(cap)
+        {
+            case GL_DEPTH_TEST: return DEPTH_TEST;
+            case GL_BLEND: return BLEND;
+            case GL_CULL_FACE: return CULL_FACE;
+        }
+        return -1;
+    }
+};
+#endif
@@ -0,0 +1,216 @@
+#ifndef IMPOSTOR_RENDERER_H
+#define IMPOSTOR_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <mesh/vertex_format.h>
+#include <renderer/gl_state.h>
+#include <renderer/instance_buffer.h>
+#include <shaders/shader.h>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// distant objects as single quads: the mesh is pre-rendered from FRAMES x FRAMES directions, spread over the whole sphere
+// with an octahedral mapping, into one atlas. At draw time every instance picks the view nearest the direction the
+// camera sees it from (in the object's own space, so rotating objects turn with it) and shows that view on a quad
+// facing it. All instances of a frame go out in one instanced draw, their model matrices in an InstanceBufferRing.
+// The colors are baked unlit next to a second atlas of normals and depths, so impostor.fs can light every instance
+// where it stands, the same way cube_shader.fs lights the mesh
+class ImpostorRenderer
+{
+public:
+    static const unsigned int FRAMES = 8;
+    static const unsigned int FRAME_SIZE = 128;
+    // the instance matrix takes the same locations as in cube_shader.vs
+    static const unsigned int INSTANCE_LOCATION = 2;
+    // the normal atlas' texture unit, clear of the color atlas (0) and the shadow maps (ShadowCascades::TEXTURE_UNIT)
+    static const unsigned int NORMAL_UNIT = 2;
+
+    ImpostorRenderer() : atlas(0), normalAtlas(0), vertexArray(0), radius(0.0f), instances(nullptr), instanceCount(0)
+    {
+    }
+
+    void create(GLStateCache &state, size_t capacity)
+    {
+        // the quad's corners come from gl_VertexID, the only attribute is the instance matrix
+        glGenVertexArrays(1, &vertexArray);
+        instanceRing.create(state, capacity);
+        instanceRing.attachMatrix(state, vertexArray, INSTANCE_LOCATION);
+    }
+
+    // renders every view of mesh into a new atlas. program draws the mesh like the scene does: it reads its view and
+    // projection from the camera block at binding 0 and its "model" uniform, and samples texture on unit 0. It writes
+    // the unlit color to output 0 and the normal (xyz * 0.5 + 0.5) and window depth to output 1, see IMPOSTOR_BAKE in
+    // cube_shader.fs. boundingRadius is the radius around the origin of model space (after mesh.dequantize) that holds
+    // the whole mesh
+    void bake(GLStateCache &state, const Shader &program, const MeshBuffers &mesh, unsigned int texture, float boundingRadius)
+    {
+        radius = boundingRadius;
+        unsigned int size = FRAMES * FRAME_SIZE;
+
+        atlas = createAtlas(state, size);
+        normalAtlas = createAtlas(state, size);
+
+        unsigned int framebuffer, depth;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        state.bindFramebuffer(framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalAtlas, 0);
+        GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+
+        // every view's camera block, at the offsets uniform buffers may be bound at
+        int alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        size_t stride = (sizeof(glm::mat4) * 2 + alignment - 1) / alignment * alignment;
+        std::vector<unsigned char> cameras(stride * FRAMES * FRAMES);
+        for(unsigned int y = 0; y < FRAMES; y++)
+        {
+            for(unsigned int x = 0; x < FRAMES; x++)
+            {
+                glm::vec3 direction = frameDirection(x, y);
+                glm::mat4 matrices[2] = {
+                    glm::lookAt(direction * (radius * 2.0f), glm::vec3(0.0f), frameUp(direction)),
+                    glm::ortho(-radius, radius, -radius, radius, radius * 0.5f, radius * 3.5f)
+                };
+                std::memcpy(&cameras[(y * FRAMES + x) * stride], matrices, sizeof(matrices));
+            }
+        }
+        unsigned int cameraBuffer;
+        glGenBuffers(1, &cameraBuffer);
+        state.bindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(cameras.size()), cameras.data(), GL_STATIC_DRAW);
+
+        // transparent where the mesh isn't, the impostor shader cuts the quad out along the alpha
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        state.disable(GL_BLEND);
+        state.enable(GL_DEPTH_TEST);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        state.useProgram(program.ID);
+        program.setMat4("model", mesh.dequantize);
+        state.bindTexture(0, GL_TEXTURE_2D, texture);
+        state.bindVertexArray(mesh.vertexArray);
+        for(unsigned int y = 0; y < FRAMES; y++)
+        {
+            for(unsigned int x = 0; x < FRAMES; x++)
+            {
+                glViewport(x * FRAME_SIZE, y * FRAME_SIZE, FRAME_SIZE, FRAME_SIZE);
+                state.bindBufferRange(GL_UNIFORM_BUFFER, 0, cameraBuffer, static_cast<GLintptr>((y * FRAMES + x) * stride), sizeof(glm::mat4) * 2);
+                if(mesh.indexType != 0)
+                    glDrawElements(GL_TRIANGLES, mesh.drawCount(), mesh.indexType, 0);
+                else
+                    glDrawArrays(GL_TRIANGLES, 0, mesh.drawCount());
+            }
+        }
+
+        state.bindFramebuffer(0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        state.enable(GL_BLEND);
+        state.bindTexture(0, GL_TEXTURE_2D, atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        state.bindTexture(0, GL_TEXTURE_2D, normalAtlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        state.deleteBuffer(cameraBuffer);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteFramebuffers(1, &framebuffer);
+    }
+
+    // starts this frame's batch, call once a frame before add()
+    void begin()
+    {
+        instances = instanceRing.beginFrame();
+        instanceCount = 0;
+    }
+
+    // queues an instance, false once the batch is full
+    bool add(const glm::mat4 &model)
+    {
+        if(instanceCount >= instanceRing.capacity())
+            return false;
+        std::memcpy(instances + instanceCount * 16, &model[0][0], sizeof(glm::mat4));
+        instanceCount++;
+        return true;
+    }
+
+    // draws the batch with program (impostor.vs/.fs) and ends the frame
+    void draw(GLStateCache &state, const Shader &program)
+    {
+        if(instanceCount > 0)
+        {
+            state.useProgram(program.ID);
+            state.bindTexture(0, GL_TEXTURE_2D, atlas);
+            state.bindTexture(NORMAL_UNIT, GL_TEXTURE_2D, normalAtlas);
+            state.bindVertexArray(vertexArray);
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instanceCount), instanceRing.baseInstance());
+        }
+        instanceRing.endFrame();
+    }
+
+    // the uniforms impostor.vs/.fs need, for the program's onReady
+    void setUniforms(const Shader &program) const
+    {
+        program.setInt("atlas", 0);
+        program.setInt("normals", NORMAL_UNIT);
+        program.setFloat("radius", radius);
+        program.setFloat("frames", static_cast<float>(FRAMES));
+    }
+
+    size_t count() const
+    {
+        return instanceCount;
+    }
+
+    // the direction view (x, y) was rendered from, the same mapping impostor.vs picks views with
+    static glm::vec3 frameDirection(unsigned int x, unsigned int y)
+    {
+        glm::vec2 e((x + 0.5f) / FRAMES * 2.0f - 1.0f, (y + 0.5f) / FRAMES * 2.0f - 1.0f);
+        return VertexPacker::octDecode(e);
+    }
+
+    // the up vector of a view's camera, straight up unless it looks along the y axis
+    static glm::vec3 frameUp(const glm::vec3 &direction)
+    {
+        return std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+private:
+    // 128, 64, 32 and 16 pixels per view; smaller would blur neighbouring views into each other
+    static const int MIP_LEVELS = 4;
+
+    // an empty, mipmapped size x size atlas, left bound on unit 0
+    static unsigned int createAtlas(GLStateCache &state, unsigned int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        state.bindTexture(0, GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, MIP_LEVELS, GL_RGBA8, size, size);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    unsigned int atlas;
+    unsigned int normalAtlas;
+    unsigned int vertexArray;
+    float radius;
+    InstanceBufferRing instanceRing;
+    float *instances;
+    size_t instanceCount;
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <renderer/gl_state.h>
+
+#include <cstddef>
+
+// per instance data (model matrices, usually written by TransformKernel) in a persistently mapped ring of SLOTS frames, fenced
+// like CameraUniformRing. The whole buffer stays attached to the vertex array and each frame's slot is picked with the base
+// instance of the draw, so nothing has to be rebound per frame
+class InstanceBufferRing
+{
+public:
+    static const unsigned int SLOTS = 3;
+
+    InstanceBufferRing() : buffer(0), mapped(nullptr), slot(0), instanceCapacity(0), floatsPerInstance(0)
+    {
+        for(unsigned int i = 0; i < SLOTS; i++)
+            fences[i] = 0;
+    }
+
+    // room for capacity instances of floats floats each per frame
+    void create(GLStateCache &state, size_t capacity, size_t floats = 16)
+    {
+        instanceCapacity = capacity;
+        floatsPerInstance = floats;
+        GLsizeiptr size = static_cast<GLsizeiptr>(capacity * floats * sizeof(float) * SLOTS);
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &buffer);
+        state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        mapped = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    }
+
+    // feeds a mat4 per instance into four vec4 attributes starting at location, taken from offsetFloats into each instance
+    void attachMatrix(GLStateCache &state, unsigned int vertexArray, unsigned int location, size_t offsetFloats = 0)
+    {
+        state.bindVertexArray(vertexArray);
+        state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        GLsizei stride = static_cast<GLsizei>(floatsPerInstance * sizeof(float));
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(location + column);
+            glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)((offsetFloats + column * 4) * sizeof(float)));
+            glVertexAttribDivisor(location + column, 1);
+        }
+    }
+
+    // moves to the next slot (waiting only if the GPU still reads it from SLOTS frames ago) and returns where to write it
+    float *beginFrame()
+    {
+        slot = (slot + 1) % SLOTS;
+        if(fences[slot])
+        {
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+        return mapped + slot * instanceCapacity * floatsPerInstance;
+    }
+
+    // pass as the base instance of this frame's draws
+    unsigned int baseInstance() const
+    {
+        return static_cast<unsigned int>(slot * instanceCapacity);
+    }
+
+    // call once every draw reading this frame's slot has been issued
+    void endFrame()
+    {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    size_t capacity() const
+    {
+        return instanceCapacity;
+    }
+
+private:
+    unsigned int buffer;
+    float *mapped;
+    unsigned int slot;
+    size_t instanceCapacity;
+    size_t floatsPerInstance;
+    GLsync fences[SLOTS];
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef LATE_LATCH_H
+#define LATE_LATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <renderer/gl_state.h>
+
+#include <cstring>
+
+// layout of the CameraBlock uniform block in cube_shader.vs (std140)
+struct CameraUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+// camera matrices in a persistently mapped, coherent uniform buffer. Each frame gets its own slot in a small ring (guarded by
+// a fence), so the slot can be overwritten right up until the draw that reads it is issued without stalling on the GPU.
+// that is what lets the view be "late latched" from the freshest cursor sample instead of the one from the start of the frame
+class CameraUniformRing
+{
+public:
+    static const unsigned int SLOTS = 3;
+    static const unsigned int BINDING = 0;
+
+    CameraUniformRing() : buffer(0), mapped(nullptr), slot(0), slotSize(0)
+    {
+        for(unsigned int i = 0; i < SLOTS; i++)
+            fences[i] = 0;
+    }
+
+    void create(GLStateCache &state)
+    {
+        // slots have to start on the uniform buffer offset alignment
+        int alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        slotSize = (sizeof(CameraUniforms) + alignment - 1) / alignment * alignment;
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &buffer);
+        state.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferStorage(GL_UNIFORM_BUFFER, slotSize * SLOTS, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, slotSize * SLOTS, flags));
+    }
+
+    // moves to the next slot, waiting only if the GPU is still reading it from SLOTS frames ago
+    void beginFrame()
+    {
+        slot = (slot + 1) % SLOTS;
+        if(fences[slot])
+        {
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+    }
+
+    // writes the matrices into this frame's slot and binds it; can be called again later in the frame to overwrite them
+    void write(const glm::mat4 &view, const glm::mat4 &projection, GLStateCache &state)
+    {
+        CameraUniforms *uniforms = reinterpret_cast<CameraUniforms*>(mapped + slot * slotSize);
+        memcpy(&uniforms->view, &view, sizeof(glm::mat4));
+        memcpy(&uniforms->projection, &projection, sizeof(glm::mat4));
+        latestView = view;
+        state.bindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, slot * slotSize, sizeof(CameraUniforms));
+    }
+
+    // overwrites only the view of this frame's slot (the binding is already in place)
+    void latchView(const glm::mat4 &view)
+    {
+        CameraUniforms *uniforms = reinterpret_cast<CameraUniforms*>(mapped + slot * slotSize);
+        memcpy(&uniforms->view, &view, sizeof(glm::mat4));
+        latestView = view;
+    }
+
+    // the view last written to this frame's slot, latched or not (the mapping is write only, this is a copy)
+    const glm::mat4 &currentView() const
+    {
+        return latestView;
+    }
+
+    // call once every draw reading this frame's slot has been issued
+    void endFrame()
+    {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    unsigned int buffer;
+    unsigned char *mapped;
+    unsigned int slot;
+    size_t slotSize;
+    GLsync fences[SLOTS];
+    glm::mat4 latestView;
+};
+#endif
@@ -0,0 +1,80 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <mesh/vertex_format.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// distances are clamped to this, an object the camera is inside of always gets its finest level
+const float LOD_MIN_DISTANCE = 1.0e-3f;
+
+// picks a level of detail per object from how many pixels its error covers on screen. Every object remembers its level:
+// it goes finer as soon as the error shows more than thresholdPixels, but only goes coarser once the next level would
+// show less than thresholdPixels * (1 - hysteresis), so an object sitting at the boundary doesn't pop back and forth
+class LodSelector
+{
+public:
+    LodSelector(float thresholdPixels = 1.0f, float hysteresis = 0.25f) : thresholdPixels(thresholdPixels), hysteresis(hysteresis), pixelsPerUnit(0.0f)
+    {
+    }
+
+    // call once a frame, before select(): the camera's projection and the viewport height in pixels
+    void setView(const glm::mat4 &projection, float viewportHeight)
+    {
+        // a perspective projection's [1][1] is 1 / tan(fovy / 2), so this many pixels span one unit at distance one
+        pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+    }
+
+    void setThreshold(float pixels, float band)
+    {
+        thresholdPixels = pixels;
+        hysteresis = band;
+    }
+
+    // on screen size of a mesh space error, for an object scaled by scale whose nearest point is distance away
+    float screenError(float error, float scale, float distance) const
+    {
+        return error * scale * pixelsPerUnit / std::max(distance, LOD_MIN_DISTANCE);
+    }
+
+    // makes room for objects [0, count). Once it has, select() may run for different objects on different threads
+    void reserve(size_t count)
+    {
+        if(levels.size() < count)
+            levels.resize(count, 0);
+    }
+
+    // the level to draw object with this frame; distance is to the object's bounding sphere, not its center
+    unsigned int select(size_t object, const std::vector<MeshLod> &lods, float scale, float distance)
+    {
+        if(object >= levels.size())
+            levels.resize(object + 1, 0);
+        if(lods.empty())
+            return 0;
+
+        unsigned int level = std::min<unsigned int>(levels[object], static_cast<unsigned int>(lods.size() - 1));
+        while(level > 0 && screenError(lods[level].error, scale, distance) > thresholdPixels)
+            level--;
+        while(level + 1 < lods.size() && screenError(lods[level + 1].error, scale, distance) <= thresholdPixels * (1.0f - hysteresis))
+            level++;
+        levels[object] = static_cast<uint8_t>(level);
+        return level;
+    }
+
+    // forget every object's level, for when the objects are replaced
+    void reset()
+    {
+        levels.clear();
+    }
+
+private:
+    float thresholdPixels;
+    float hysteresis;
+    float pixelsPerUnit;
+    std::vector<uint8_t> levels;
+};
+#endif
\ No newline at end of file
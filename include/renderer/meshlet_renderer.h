@@ -0,0 +1,255 @@
+#ifndef MESHLET_RENDERER_H
+#define MESHLET_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <mesh/mesh_data.h>
+#include <mesh/meshlet_builder.h>
+#include <mesh/vertex_format.h>
+#include <renderer/gl_state.h>
+#include <shaders/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+enum Meshlet_Cull_Mode {
+    MESHLET_CULL_CPU,
+    MESHLET_CULL_GPU
+};
+
+// draws a MeshletMesh as one indirect command per meshlet and one glMultiDrawElementsIndirect per object. Before drawing,
+// every meshlet of every object is tested against the view frustum and its backface cone, either here on the CPU or by
+// a compute shader; culled meshlets keep their command with an instance count of 0.
+// The vertices are stored per meshlet (shared vertices repeat between meshlets) so the 16 bit indices can stay local to
+// their meshlet, with the meshlet's first vertex as the base vertex
+class MeshletRenderer
+{
+public:
+    MeshletRenderer() : vertexArray(0), vertexBuffer(0), indexBuffer(0), commandBuffer(0), meshletBuffer(0), objectBuffer(0),
+        objectCapacity(0), visible(0)
+    {
+    }
+
+    // computeShaderPath may be empty, then (as when the compute shader doesn't build) only the CPU path is available.
+    // false when there is nothing to draw
+    bool create(GLStateCache &state, const MeshData &mesh, const MeshletMesh &meshlets, const VertexFormat &format, unsigned int maxObjects, const std::string &computeShaderPath = std::string())
+    {
+        if(meshlets.meshlets.empty())
+            return false;
+        meshletData = meshlets.meshlets;
+        bounds = meshlets.bounds;
+        objectCapacity = maxObjects;
+
+        std::vector<MeshVertex> vertices(meshlets.vertices.size());
+        for(size_t i = 0; i < vertices.size(); i++)
+            vertices[i] = mesh.vertices[meshlets.vertices[i]];
+        std::vector<uint16_t> indices(meshlets.triangles.begin(), meshlets.triangles.end());
+        PackedVertices packed = VertexPacker::pack(vertices, format);
+        dequantize = packed.dequantize;
+
+        glGenVertexArrays(1, &vertexArray);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        state.bindVertexArray(vertexArray);
+        state.bindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(packed.data.size()), packed.data.data(), GL_STATIC_DRAW);
+        VertexPacker::setupAttributes(format);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(uint16_t)), indices.data(), GL_STATIC_DRAW);
+
+        // every meshlet's range as well, for the passes that draw them all
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        for(const Meshlet &meshlet : meshletData)
+        {
+            counts.push_back(static_cast<GLsizei>(meshlet.triangleCount * 3));
+            offsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(meshlet.triangleOffset) * 3 * sizeof(uint16_t)));
+            baseVertices.push_back(static_cast<GLint>(meshlet.vertexOffset));
+        }
+
+        commands.resize(meshletData.size() * objectCapacity);
+        glGenBuffers(1, &commandBuffer);
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand)), nullptr, GL_DYNAMIC_DRAW);
+
+        if(computeShaderPath.empty())
+            return true;
+        std::string code = Shader::readFile(computeShaderPath.c_str());
+        if(code.empty() || !cullShader.buildCompute(code))
+        {
+            glDeleteProgram(cullShader.ID);
+            cullShader.ID = 0;
+            return true;
+        }
+
+        // bounds plus the draw range of every meshlet, four vec4 each (see meshlet_cull.cs)
+        std::vector<float> gpuMeshlets(meshletData.size() * 16);
+        for(size_t i = 0; i < meshletData.size(); i++)
+        {
+            float *m = &gpuMeshlets[i * 16];
+            const MeshletBounds &b = bounds[i];
+            m[0] = b.center.x;  m[1] = b.center.y;  m[2] = b.center.z;  m[3] = b.radius;
+            m[4] = b.coneApex.x;  m[5] = b.coneApex.y;  m[6] = b.coneApex.z;  m[7] = b.coneCutoff;
+            m[8] = b.coneAxis.x;  m[9] = b.coneAxis.y;  m[10] = b.coneAxis.z;  m[11] = 0.0f;
+            uint32_t range[4] = { meshletData[i].triangleCount * 3, meshletData[i].triangleOffset * 3, meshletData[i].vertexOffset, 0 };
+            std::memcpy(&m[12], range, sizeof(range));
+        }
+        glGenBuffers(1, &meshletBuffer);
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, meshletBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(gpuMeshlets.size() * sizeof(float)), gpuMeshlets.data(), GL_STATIC_DRAW);
+        glGenBuffers(1, &objectBuffer);
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(objectCapacity * sizeof(glm::mat4)), nullptr, GL_DYNAMIC_DRAW);
+        return true;
+    }
+
+    bool hasGpuCulling() const
+    {
+        return cullShader.ID != 0;
+    }
+
+    // culls every meshlet of objectCount objects (models are the objects' model matrices, rotation, translation and a
+    // uniform scale) against the world space frustum planes and the camera position, and fills the indirect commands
+    void cull(GLStateCache &state, Meshlet_Cull_Mode mode, const glm::mat4 *models, unsigned int objectCount, const glm::vec4 *planes, glm::vec3 cameraPosition)
+    {
+        objectCount = std::min(objectCount, objectCapacity);
+        if(mode == MESHLET_CULL_GPU && hasGpuCulling())
+        {
+            cullGpu(state, models, objectCount, planes, cameraPosition);
+            return;
+        }
+
+        visible = 0;
+        for(unsigned int object = 0; object < objectCount; object++)
+        {
+            const glm::mat4 &model = models[object];
+            float scale = glm::length(glm::vec3(model[0]));
+            for(size_t i = 0; i < meshletData.size(); i++)
+            {
+                DrawElementsIndirectCommand &command = commands[object * meshletData.size() + i];
+                command = makeCommand(meshletData[i]);
+                command.instanceCount = isVisible(bounds[i], model, scale, planes, cameraPosition) ? 1 : 0;
+                visible += command.instanceCount;
+            }
+        }
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, static_cast<GLsizeiptr>(objectCount * meshletData.size() * sizeof(DrawElementsIndirectCommand)), commands.data());
+    }
+
+    // the program is expected to be bound with its "model" location passed in; the models are the ones given to cull()
+    void draw(GLStateCache &state, int modelLocation, const glm::mat4 *models, unsigned int objectCount)
+    {
+        objectCount = std::min(objectCount, objectCapacity);
+        state.bindVertexArray(vertexArray);
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for(unsigned int object = 0; object < objectCount; object++)
+        {
+            glm::mat4 model = models[object] * dequantize;
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &model[0][0]);
+            size_t offset = object * meshletData.size() * sizeof(DrawElementsIndirectCommand);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (const void*)offset, static_cast<GLsizei>(meshletData.size()), 0);
+        }
+    }
+
+    // every meshlet of one object, none culled, for passes that don't look from the camera (shadow maps). The program
+    // is bound with its "model" location passed in, model is what cull() and draw() would be given for the object
+    void drawAll(GLStateCache &state, int modelLocation, const glm::mat4 &model)
+    {
+        state.bindVertexArray(vertexArray);
+        glm::mat4 world = model * dequantize;
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &world[0][0]);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_SHORT, offsets.data(), static_cast<GLsizei>(counts.size()), baseVertices.data());
+    }
+
+    size_t meshletCount() const
+    {
+        return meshletData.size();
+    }
+
+    // meshlets that passed the last CPU cull, over all objects
+    size_t visibleMeshlets() const
+    {
+        return visible;
+    }
+
+    // the CPU test, also what meshlet_cull.cs does
+    static bool isVisible(const MeshletBounds &meshlet, const glm::mat4 &model, float scale, const glm::vec4 *planes, glm::vec3 cameraPosition)
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.center, 1.0f));
+        float radius = meshlet.radius * scale;
+        for(int i = 0; i < 6; i++)
+            if(glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+                return false;
+
+        if(meshlet.coneCutoff >= 1.0f)
+            return true;
+        glm::vec3 apex = glm::vec3(model * glm::vec4(meshlet.coneApex, 1.0f));
+        glm::vec3 axis = glm::normalize(glm::mat3(model) * meshlet.coneAxis);
+        glm::vec3 toApex = apex - cameraPosition;
+        float distance = glm::length(toApex);
+        return distance == 0.0f || glm::dot(toApex / distance, axis) < meshlet.coneCutoff;
+    }
+
+private:
+    static const unsigned int CULL_GROUP_SIZE = 64;
+
+    unsigned int vertexArray;
+    unsigned int vertexBuffer;
+    unsigned int indexBuffer;
+    unsigned int commandBuffer;
+    unsigned int meshletBuffer;
+    unsigned int objectBuffer;
+    unsigned int objectCapacity;
+    size_t visible;
+    glm::mat4 dequantize;
+    Shader cullShader;
+    std::vector<Meshlet> meshletData;
+    std::vector<MeshletBounds> bounds;
+    std::vector<DrawElementsIndirectCommand> commands;
+    // the index count, index byte offset and base vertex of every meshlet, for drawAll()
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+
+    static DrawElementsIndirectCommand makeCommand(const Meshlet &meshlet)
+    {
+        DrawElementsIndirectCommand command = { meshlet.triangleCount * 3, 1, meshlet.triangleOffset * 3, static_cast<int32_t>(meshlet.vertexOffset), 0 };
+        return command;
+    }
+
+    void cullGpu(GLStateCache &state, const glm::mat4 *models, unsigned int objectCount, const glm::vec4 *planes, glm::vec3 cameraPosition)
+    {
+        state.bindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(objectCount * sizeof(glm::mat4)), models);
+
+        state.useProgram(cullShader.ID);
+        glUniform4fv(glGetUniformLocation(cullShader.ID, "planes"), 6, &planes[0][0]);
+        glUniform3fv(glGetUniformLocation(cullShader.ID, "cameraPosition"), 1, &cameraPosition[0]);
+        glUniform1ui(glGetUniformLocation(cullShader.ID, "meshletCount"), static_cast<unsigned int>(meshletData.size()));
+        glUniform1ui(glGetUniformLocation(cullShader.ID, "objectCount"), objectCount);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshletBuffer);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, objectBuffer);
+        state.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+
+        unsigned int invocations = objectCount * static_cast<unsigned int>(meshletData.size());
+        glDispatchCompute((invocations + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+        // the draws read the commands as indirect arguments
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+#ifndef OBJECT_ID_BUFFER_H
+#define OBJECT_ID_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <renderer/gl_state.h>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+
+// an offscreen target the scene is drawn into instead of the window: color in draw buffer 0 and a 32 bit object id per
+// pixel in draw buffer 1 (0 where no object was drawn, see DrawItem::objectId). read() copies one id into a pixel
+// buffer object and sets a fence, and poll() hands it to the callback once the fence has passed, so reading never
+// waits for the GPU; ids arrive a frame or two after they were asked for
+class ObjectIdBuffer
+{
+public:
+    // reads in flight at once; asking for more before the oldest arrives drops the new one
+    static const unsigned int READBACK_SLOTS = 4;
+
+    typedef std::function<void(uint32_t id)> Callback;
+
+    ObjectIdBuffer() : framebuffer(0), color(0), ids(0), depth(0), width(0), height(0), nextSlot(0), pendingCount(0)
+    {
+        for(unsigned int i = 0; i < READBACK_SLOTS; i++)
+        {
+            slots[i].buffer = 0;
+            slots[i].fence = 0;
+        }
+    }
+
+    bool create(GLStateCache &state, int viewportWidth, int viewportHeight)
+    {
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &color);
+        glGenRenderbuffers(1, &ids);
+        glGenRenderbuffers(1, &depth);
+        resize(viewportWidth, viewportHeight);
+
+        state.bindFramebuffer(framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, ids);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        state.bindFramebuffer(0);
+        if(!complete)
+        {
+            std::cout << "ERROR::OBJECT_ID::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+            return false;
+        }
+
+        for(unsigned int i = 0; i < READBACK_SLOTS; i++)
+        {
+            glGenBuffers(1, &slots[i].buffer);
+            state.bindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(uint32_t), nullptr, GL_STREAM_READ);
+        }
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+
+    // call when the window's framebuffer changed size; reads still in flight keep their result
+    void resize(int viewportWidth, int viewportHeight)
+    {
+        width = viewportWidth;
+        height = viewportHeight;
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, ids);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    }
+
+    // binds the target and clears it: color to clearColor, ids to 0, depth to the far plane
+    void begin(GLStateCache &state, const float clearColor[4])
+    {
+        state.bindFramebuffer(framebuffer);
+        // clears are masked like draws
+        state.setColorWrites(0, true);
+        state.setColorWrites(1, true);
+        const GLuint noObject[4] = { 0, 0, 0, 0 };
+        const GLfloat farDepth = 1.0f;
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glClearBufferuiv(GL_COLOR, 1, noObject);
+        glClearBufferfv(GL_DEPTH, 0, &farDepth);
+    }
+
+    // queues a read of the id at pixel (x, y) of the frame drawn since begin(), counted from the bottom left.
+    // false if it is outside the target or every slot is still in flight
+    bool read(GLStateCache &state, int x, int y, Callback callback)
+    {
+        if(x < 0 || y < 0 || x >= width || y >= height || pendingCount == READBACK_SLOTS)
+            return false;
+        Slot &slot = slots[(nextSlot + pendingCount) % READBACK_SLOTS];
+        pendingCount++;
+
+        state.bindFramebuffer(framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.callback = callback;
+        return true;
+    }
+
+    // hands every read whose copy has finished to its callback, oldest first; never blocks
+    void poll(GLStateCache &state)
+    {
+        while(pendingCount > 0)
+        {
+            Slot &slot = slots[nextSlot];
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                return;
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+
+            uint32_t id = 0;
+            state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(id), &id);
+            state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            nextSlot = (nextSlot + 1) % READBACK_SLOTS;
+            pendingCount--;
+
+            Callback callback = slot.callback;
+            slot.callback = nullptr;
+            if(callback)
+                callback(id);
+        }
+    }
+
+    // copies the color to the window and leaves the window bound
+    void present(GLStateCache &state)
+    {
+        state.bindFramebuffer(framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        // only the draw binding moved, rebinding both through the cache puts it back in sync
+        state.bindFramebuffer(0);
+    }
+
+private:
+    struct Slot
+    {
+        unsigned int buffer;
+        GLsync fence;
+        Callback callback;
+    };
+
+    unsigned int framebuffer;
+    unsigned int color;
+    unsigned int ids;
+    unsigned int depth;
+    int width;
+    int height;
+    Slot slots[READBACK_SLOTS];
+    // the oldest read in flight, and how many there are
+    unsigned int nextSlot;
+    unsigned int pendingCount;
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,282 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <renderer/gl_state.h>
+#include <renderer/command_buffer.h>
+#include <threading/thread_pool.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// passes are drawn in this order, the pass sits in the top bits of the sort key
+enum Render_Pass {
+    PASS_WORLD = 0,
+    PASS_OVERLAY = 1
+};
+
+// one draw as the queue sees it; everything needed to issue it without going back to the caller
+struct DrawItem
+{
+    uint64_t key;
+    unsigned int program;
+    unsigned int vao;
+    unsigned int texture;
+    GLenum mode;
+    int first;
+    int count;
+    glm::mat4 model;
+    // 0 for glDrawArrays, else the index type of the vertex array's element buffer
+    GLenum indexType;
+    // written to the object id buffer by programs that have an "objectId" uniform, 0 is no object
+    uint32_t objectId;
+};
+
+// builds the 64 bit sort key. Layout from the most significant bit down:
+//   opaque:      pass(4) | 0 | program(11) | material(12) | texture(12) | depth(24, front to back)
+//   translucent: pass(4) | 1 | depth(24, back to front) | program(11) | material(12)
+// so opaque draws are grouped by state first (fewest switches) and then sorted front to back for early-z,
+// while translucent draws keep the back to front order blending needs
+class SortKey
+{
+public:
+    static const unsigned int DEPTH_BITS = 24;
+
+    static uint64_t make(unsigned int pass, bool translucent, unsigned int program, unsigned int material, unsigned int texture, float depth, float nearPlane, float farPlane)
+    {
+        uint64_t d = quantizeDepth(depth, nearPlane, farPlane);
+        uint64_t key = (uint64_t)(pass & 0xF) << 60;
+        if(!translucent)
+        {
+            key |= (uint64_t)(program & 0x7FF) << 48;
+            key |= (uint64_t)(material & 0xFFF) << 36;
+            key |= (uint64_t)(texture & 0xFFF) << 24;
+            key |= d;
+        }
+        else
+        {
+            key |= (uint64_t)1 << 59;
+            key |= (((1u << DEPTH_BITS) - 1) - d) << 35;
+            key |= (uint64_t)(program & 0x7FF) << 24;
+            key |= (uint64_t)(material & 0xFFF) << 12;
+        }
+        return key;
+    }
+
+    static unsigned int pass(uint64_t key)
+    {
+        return (unsigned int)(key >> 60);
+    }
+
+private:
+    static uint64_t quantizeDepth(float depth, float nearPlane, float farPlane)
+    {
+        float t = (depth - nearPlane) / (farPlane - nearPlane);
+        t = glm::clamp(t, 0.0f, 1.0f);
+        return (uint64_t)(t * (float)((1u << DEPTH_BITS) - 1));
+    }
+};
+
+// collects draws for a frame, sorts them by key, records them into command buffers and replays those through the state cache
+class RenderQueue
+{
+public:
+    // draws per partition below which recording stays on the calling thread, handing off smaller ranges costs more than it saves
+    static const size_t MIN_PARTITION_SIZE = 2048;
+
+    // per pass fixed function state, indexed by Render_Pass
+    bool PassDepthTest[16];
+
+    RenderQueue()
+    {
+        for(unsigned int i = 0; i < 16; i++)
+            PassDepthTest[i] = true;
+        PassDepthTest[PASS_OVERLAY] = false;
+    }
+
+    void clear()
+    {
+        items.clear();
+    }
+
+    void submit(const DrawItem &item)
+    {
+        items.push_back(item);
+    }
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+    // how many partitions count draws or objects are split into: one per pool thread, but none smaller than minPartitionSize
+    static size_t partitionCount(size_t count, size_t minPartitionSize, const ThreadPool *pool)
+    {
+        if(!pool)
+            return 1;
+        return std::max<size_t>(1, std::min<size_t>(pool->size(), count / minPartitionSize));
+    }
+
+    // queues the draws for objects [0, count), recorded across the pool in partitionCount() partitions.
+    // record(bucket, partition, begin, end) appends the draws of objects [begin, end) to bucket; it runs on any thread, so
+    // it must not call GL or touch anything another partition writes. The buckets are queued in partition order, which
+    // leaves the queue as it would be had everything been recorded on this thread
+    template<typename Record>
+    void submitPartitioned(size_t count, size_t minPartitionSize, ThreadPool *pool, Record record)
+    {
+        size_t partitions = partitionCount(count, minPartitionSize, pool);
+        if(buckets.size() < partitions)
+            buckets.resize(partitions);
+        size_t partitionSize = (count + partitions - 1) / partitions;
+        auto recordPartitions = [&](size_t begin, size_t end)
+        {
+            for(size_t partition = begin; partition < end; partition++)
+            {
+                size_t first = std::min(count, partition * partitionSize);
+                size_t last = std::min(count, first + partitionSize);
+                buckets[partition].clear();
+                record(buckets[partition], partition, first, last);
+            }
+        };
+        if(partitions == 1)
+            recordPartitions(0, 1);
+        else
+            pool->parallelFor(partitions, 1, recordPartitions);
+
+        for(size_t partition = 0; partition < partitions; partition++)
+            items.insert(items.end(), buckets[partition].begin(), buckets[partition].end());
+    }
+
+    // sorts the queued draws by key; the order of draws with equal keys is kept (the radix sort is stable)
+    void sort()
+    {
+        entries.resize(items.size());
+        for(size_t i = 0; i < items.size(); i++)
+        {
+            entries[i].key = items[i].key;
+            entries[i].index = (uint32_t)i;
+        }
+        radixSort(entries, scratch);
+    }
+
+    // sorts, records the sorted draws into one command buffer per partition (spread over the pool when there are enough of them)
+    // and replays the partitions in order on this thread, which must own the GL context
+    void flush(GLStateCache &state, ThreadPool *pool = nullptr)
+    {
+        sort();
+
+        size_t count = entries.size();
+        size_t partitions = partitionCount(count, MIN_PARTITION_SIZE, pool);
+        if(buffers.size() < partitions)
+            buffers.resize(partitions);
+
+        size_t partitionSize = (count + partitions - 1) / partitions;
+        auto recordPartitions = [&](size_t begin, size_t end)
+        {
+            for(size_t partition = begin; partition < end; partition++)
+            {
+                size_t first = std::min(count, partition * partitionSize);
+                size_t last = std::min(count, first + partitionSize);
+                buffers[partition].clear();
+                record(buffers[partition], first, last);
+            }
+        };
+        if(partitions == 1)
+            recordPartitions(0, 1);
+        else
+            pool->parallelFor(partitions, 1, recordPartitions);
+
+        for(size_t partition = 0; partition < partitions; partition++)
+            backend.replay(buffers[partition], state);
+    }
+
+    // records the sorted draws [first, last) into buffer without touching GL
+    void record(CommandBuffer &buffer, size_t first, size_t last) const
+    {
+        for(size_t i = first; i < last; i++)
+        {
+            const DrawItem &item = items[entries[i].index];
+            buffer.setDepthTest(PassDepthTest[SortKey::pass(item.key)]);
+            buffer.useProgram(item.program);
+            if(item.texture != 0)
+                buffer.bindTexture(0, item.texture);
+            buffer.bindVertexArray(item.vao);
+            buffer.setModel(glm::value_ptr(item.model));
+            buffer.setObjectId(item.objectId);
+            buffer.draw(item.mode, item.first, item.count, item.indexType);
+        }
+    }
+
+    // the sorted order of the last sort()/flush(), as indices into the submitted draws
+    const DrawItem &sorted(size_t i) const
+    {
+        return items[entries[i].index];
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawItem> items;
+    // per partition draws of submitPartitioned(), kept to reuse their memory
+    std::vector<std::vector<DrawItem>> buckets;
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    std::vector<CommandBuffer> buffers;
+    GLCommandBackend backend;
+
+    // least significant digit radix sort, 8 passes of 8 bits. Passes where every key has the same byte are skipped,
+    // which is the common case for the pass/program bits of a small scene
+    static void radixSort(std::vector<Entry> &keys, std::vector<Entry> &temp)
+    {
+        size_t n = keys.size();
+        if(n < 2)
+            return;
+        temp.resize(n);
+
+        // build all 8 histograms in one read over the keys
+        uint32_t histograms[8][256] = {};
+        for(size_t i = 0; i < n; i++)
+        {
+            uint64_t key = keys[i].key;
+            for(unsigned int digit = 0; digit < 8; digit++)
+                histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+        }
+
+        Entry *src = keys.data();
+        Entry *dst = temp.data();
+        for(unsigned int digit = 0; digit < 8; digit++)
+        {
+            uint32_t *histogram = histograms[digit];
+            unsigned int shift = digit * 8;
+            if(histogram[(src[0].key >> shift) & 0xFF] == n)
+                continue;
+
+            // turn counts into starting offsets
+            uint32_t offset = 0;
+            for(unsigned int bucket = 0; bucket < 256; bucket++)
+            {
+                uint32_t count = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += count;
+            }
+            for(size_t i = 0; i < n; i++)
+                dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+            Entry *swap = src;
+            src = dst;
+            dst = swap;
+        }
+
+        if(src != keys.data())
+            keys.swap(temp);
+    }
+};
+#endif
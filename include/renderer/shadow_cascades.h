@@ -0,0 +1,272 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <camera/camera.h>
+#include <renderer/gl_state.h>
+#include <shaders/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+// how far out from the camera the cascades reach, and how the splits between them lean towards logarithmic (1) or
+// even (0) spacing
+const float SHADOW_DISTANCE = 40.0f;
+const float SHADOW_SPLIT_LAMBDA = 0.75f;
+// each cascade covers this much more than the view slice it is fitted to, and is only moved once the slice drifts out
+// of that margin; until then its cached static layer stays valid
+const float SHADOW_CACHE_MARGIN = 0.25f;
+// casters this far towards the light from a cascade's box still get drawn into it (their depth is clamped, not clipped)
+const float SHADOW_CASTER_RANGE = 50.0f;
+
+// cascaded shadow maps for one directional light, fitted to the camera frustum. Every cascade is a bounding sphere of a
+// slice of the view frustum, projected orthographically from the light and snapped to whole texels so the shadows
+// don't crawl as the camera moves.
+// Each cascade keeps two layers: a static one with only the casters that don't move, redrawn when the cascade moves or
+// invalidateStatic() is called, and the one that is sampled, which is the static layer copied over plus whatever moves
+// drawn on top each frame. Drawing the whole scene only happens when the cascades move; otherwise the cost is the copy and
+// the moving casters. The matrices and the maps are bound for the cube shader's SHADOWS block
+class ShadowCascades
+{
+public:
+    static const unsigned int CASCADES = 4;
+    static const unsigned int MAP_SIZE = 1024;
+    // the ShadowBlock uniform buffer binding and the texture unit of the maps in lighting.glsl (the camera uses 0)
+    static const unsigned int UNIFORM_BINDING = 1;
+    static const unsigned int TEXTURE_UNIT = 1;
+
+    // draws the static or the moving casters into a cascade with the depth shader bound and its lightSpace set, setting
+    // "model" per caster; returns how many it drew
+    typedef std::function<unsigned int(unsigned int cascade, bool staticLayer)> DrawCasters;
+
+    ShadowCascades() : framebuffer(0), maps(0), staticMaps(0), uniformBuffer(0), staticValid(false), uniformsDirty(true), staticRedraws(0), movingCasters(0)
+    {
+        for(unsigned int i = 0; i < CASCADES; i++)
+        {
+            cascades[i].radius = 0.0f;
+            cascades[i].extent = 0.0f;
+            cascades[i].layerClean = false;
+        }
+    }
+
+    // direction is the way the light travels, in world space
+    bool create(GLStateCache &state, const glm::vec3 &direction, const glm::vec3 &color)
+    {
+        lightDirection = glm::normalize(direction);
+        lightColor = color;
+        // the light's orientation never changes, only where each cascade sits in its space
+        glm::vec3 up = std::fabs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+        // the sampled maps compare in hardware (with bilinear filtering, that is 2x2 percentage closer filtering)
+        glGenTextures(1, &maps);
+        state.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, maps);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, MAP_SIZE, MAP_SIZE, CASCADES);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glGenTextures(1, &staticMaps);
+        state.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, staticMaps);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, MAP_SIZE, MAP_SIZE, CASCADES);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenFramebuffers(1, &framebuffer);
+        state.bindFramebuffer(framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, maps, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        state.bindFramebuffer(0);
+        if(!complete)
+        {
+            std::cout << "ERROR::SHADOW::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+            return false;
+        }
+
+        glGenBuffers(1, &uniformBuffer);
+        state.bindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), nullptr, GL_DYNAMIC_DRAW);
+        return true;
+    }
+
+    // the static casters changed (one started or stopped moving), every static layer is redrawn on the next update
+    void invalidateStatic()
+    {
+        staticValid = false;
+    }
+
+    // refits the cascades to the camera, redraws what has to be redrawn and binds the maps and matrices for the scene
+    // draws. Leaves the window's framebuffer bound with the viewport set back to viewportWidth x viewportHeight
+    void update(GLStateCache &state, Camera &camera, const Shader &depthShader, int viewportWidth, int viewportHeight, DrawCasters drawCasters)
+    {
+        staticRedraws = 0;
+        movingCasters = 0;
+        fit(camera);
+
+        state.bindFramebuffer(framebuffer);
+        glViewport(0, 0, MAP_SIZE, MAP_SIZE);
+        state.enable(GL_DEPTH_TEST);
+        // casters between the light and a cascade's near plane are flattened onto it instead of being lost
+        state.enable(GL_DEPTH_CLAMP);
+        state.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.5f, 2.0f);
+        depthShader.use(state);
+        const float farDepth = 1.0f;
+        for(unsigned int i = 0; i < CASCADES; i++)
+        {
+            Cascade &cascade = cascades[i];
+            depthShader.setMat4("lightSpace", cascade.lightSpace);
+            if(!staticValid || cascade.moved)
+            {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticMaps, 0, i);
+                glClearBufferfv(GL_DEPTH, 0, &farDepth);
+                drawCasters(i, true);
+                cascade.layerClean = false;
+                staticRedraws++;
+            }
+            // the sampled layer only needs the static one copied back if something moving was drawn over it since
+            if(!cascade.layerClean)
+            {
+                glCopyImageSubData(staticMaps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, maps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, MAP_SIZE, MAP_SIZE, 1);
+                cascade.layerClean = true;
+            }
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, maps, 0, i);
+            unsigned int drawn = drawCasters(i, false);
+            if(drawn > 0)
+                cascade.layerClean = false;
+            movingCasters += drawn;
+        }
+        staticValid = true;
+        state.disable(GL_POLYGON_OFFSET_FILL);
+        state.disable(GL_DEPTH_CLAMP);
+        state.bindFramebuffer(0);
+        glViewport(0, 0, viewportWidth, viewportHeight);
+
+        if(uniformsDirty)
+        {
+            ShadowUniforms uniforms;
+            for(unsigned int i = 0; i < CASCADES; i++)
+            {
+                uniforms.cascades[i] = cascades[i].lightSpace;
+                uniforms.texelSizes[i] = 2.0f * cascades[i].extent / MAP_SIZE;
+            }
+            uniforms.direction = glm::vec4(lightDirection, 0.0f);
+            uniforms.color = glm::vec4(lightColor, 1.0f);
+            state.bindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uniforms), &uniforms);
+            uniformsDirty = false;
+        }
+        state.bindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BINDING, uniformBuffer);
+        state.bindTexture(TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, maps);
+    }
+
+    // whether a caster's bounding sphere can throw a shadow into a cascade's box
+    bool overlaps(unsigned int cascade, const glm::vec3 &center, float radius) const
+    {
+        const Cascade &box = cascades[cascade];
+        glm::vec3 p = glm::vec3(lightView * glm::vec4(center, 1.0f)) - box.origin;
+        // no near limit, anything towards the light can shadow the box; beyond its far side nothing can
+        return std::fabs(p.x) <= box.extent + radius && std::fabs(p.y) <= box.extent + radius && p.z + radius >= -box.extent;
+    }
+
+    // static layers redrawn and moving casters drawn in the last update()
+    unsigned int staticRedrawCount() const
+    {
+        return staticRedraws;
+    }
+
+    unsigned int movingCasterCount() const
+    {
+        return movingCasters;
+    }
+
+private:
+    struct Cascade
+    {
+        // the slice's bounding sphere as of the last refit, rounded up so it doesn't wobble
+        float radius;
+        // half the side of the box the map covers, and its centre in light space (x and y on whole texels)
+        float extent;
+        glm::vec3 origin;
+        glm::mat4 lightSpace;
+        // refitted this update, so its static layer is out of date
+        bool moved;
+        // the sampled layer holds nothing but the static one
+        bool layerClean;
+    };
+
+    // laid out like the std140 ShadowBlock in lighting.glsl
+    struct ShadowUniforms
+    {
+        glm::mat4 cascades[CASCADES];
+        // world size of one texel per cascade, for the normal offset (a vec4, std140 pads float arrays to 16 bytes each)
+        glm::vec4 texelSizes;
+        glm::vec4 direction;
+        glm::vec4 color;
+    };
+
+    unsigned int framebuffer;
+    unsigned int maps;
+    unsigned int staticMaps;
+    unsigned int uniformBuffer;
+    glm::vec3 lightDirection;
+    glm::vec3 lightColor;
+    glm::mat4 lightView;
+    Cascade cascades[CASCADES];
+    bool staticValid;
+    bool uniformsDirty;
+    unsigned int staticRedraws;
+    unsigned int movingCasters;
+
+    // splits the view frustum up to SHADOW_DISTANCE and moves every cascade whose slice is no longer inside its box
+    void fit(Camera &camera)
+    {
+        float nearPlane = camera.NearPlane;
+        float farPlane = std::min(camera.FarPlane, SHADOW_DISTANCE);
+        float tanHalfFov = std::tan(glm::radians(camera.Zoom) * 0.5f);
+        // squared tangent of the angle between the view axis and a corner ray
+        float cornerSlope = tanHalfFov * tanHalfFov * (1.0f + camera.AspectRatio * camera.AspectRatio);
+
+        float sliceNear = nearPlane;
+        for(unsigned int i = 0; i < CASCADES; i++)
+        {
+            float t = static_cast<float>(i + 1) / CASCADES;
+            float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+            float evenSplit = nearPlane + (farPlane - nearPlane) * t;
+            float sliceFar = SHADOW_SPLIT_LAMBDA * logSplit + (1.0f - SHADOW_SPLIT_LAMBDA) * evenSplit;
+
+            // the smallest sphere around the slice has its centre on the view axis, where the near and far corners are
+            // equally far away (but no further out than the far plane)
+            float centerDistance = std::min((sliceNear + sliceFar) * 0.5f * (1.0f + cornerSlope), sliceFar);
+            float farOffset = sliceFar - centerDistance;
+            float radius = std::sqrt(farOffset * farOffset + sliceFar * sliceFar * cornerSlope);
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+            glm::vec3 center = glm::vec3(lightView * glm::vec4(camera.Position + camera.Front * centerDistance, 1.0f));
+            sliceNear = sliceFar;
+
+            Cascade &cascade = cascades[i];
+            cascade.moved = radius != cascade.radius || glm::length(center - cascade.origin) > cascade.extent - cascade.radius;
+            if(!cascade.moved)
+                continue;
+            cascade.radius = radius;
+            cascade.extent = radius * (1.0f + SHADOW_CACHE_MARGIN);
+            float texel = 2.0f * cascade.extent / MAP_SIZE;
+            cascade.origin = glm::vec3(std::floor(center.x / texel) * texel, std::floor(center.y / texel) * texel, center.z);
+            // light space looks down -z, so the near side (towards the light) is the larger z
+            glm::mat4 projection = glm::ortho(cascade.origin.x - cascade.extent, cascade.origin.x + cascade.extent, cascade.origin.y - cascade.extent,
+                cascade.origin.y + cascade.extent, -cascade.origin.z - cascade.extent - SHADOW_CASTER_RANGE, -cascade.origin.z + cascade.extent);
+            cascade.lightSpace = projection * lightView;
+            uniformsDirty = true;
+        }
+    }
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,773 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <threading/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BVH_SSE 1
+#include <immintrin.h>
+#endif
+
+// AsyncBvh rebuilds once the refitted tree costs this much more than it did when it was built
+const float BVH_REBUILD_COST_RATIO = 1.5f;
+
+// axis aligned bounding box; the default one is empty (min above max), so growing it by anything gives that thing
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    Aabb() : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max())
+    {
+    }
+
+    Aabb(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max)
+    {
+    }
+
+    void grow(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void grow(const Aabb &box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    glm::vec3 center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    // the SAH only compares areas, so this leaves out the factor 2
+    float halfArea() const
+    {
+        glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    // the box around local after transforming it by model
+    static Aabb transformed(const glm::mat4 &model, const Aabb &local)
+    {
+        glm::vec3 center = glm::vec3(model * glm::vec4(local.center(), 1.0f));
+        glm::vec3 extent = (local.max - local.min) * 0.5f;
+        glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * extent.x + glm::abs(glm::vec3(model[1])) * extent.y + glm::abs(glm::vec3(model[2])) * extent.z;
+        return Aabb(center - worldExtent, center + worldExtent);
+    }
+};
+
+// the closest object a ray hit, and how far along the ray (in units of the direction's length)
+struct BvhHit
+{
+    uint32_t object;
+    float distance;
+};
+
+// bounding volume hierarchy over object boxes. Every node holds up to four children with their boxes side by side
+// (structure of arrays), so one SSE test checks a ray, frustum or box against all four at once. Built top down with a
+// binned surface area heuristic; moving objects are handled by refit(), which keeps the tree and only grows or shrinks
+// its boxes (see AsyncBvh for rebuilding once that has made the tree too loose).
+// Objects are the indices of the boxes given to build()
+class Bvh
+{
+public:
+    static const uint32_t NO_OBJECT = ~0u;
+
+    Bvh() : builtCost(0.0f), currentCost(0.0f)
+    {
+    }
+
+    // a new tree over boxes, replacing the old one
+    void build(const std::vector<Aabb> &objectBoxes)
+    {
+        boxes = objectBoxes;
+        nodes.clear();
+        objects.resize(boxes.size());
+        for(uint32_t i = 0; i < objects.size(); i++)
+            objects[i] = i;
+        if(boxes.empty())
+        {
+            builtCost = currentCost = 0.0f;
+            return;
+        }
+
+        centers.resize(boxes.size());
+        for(size_t i = 0; i < boxes.size(); i++)
+            centers[i] = boxes[i].center();
+        nodes.reserve(boxes.size() / 2 + 1);
+        buildNode(measure(0, static_cast<uint32_t>(boxes.size())), 0);
+        centers.clear();
+        centers.shrink_to_fit();
+        builtCost = currentCost = computeCost();
+    }
+
+    // the objects moved: takes their new boxes (same objects, same order as in build()) and fits every node around them
+    void refit(const std::vector<Aabb> &objectBoxes)
+    {
+        boxes = objectBoxes;
+        // children always come after their parent, so walking backwards visits them first
+        for(size_t n = nodes.size(); n-- > 0;)
+        {
+            Node &node = nodes[n];
+            for(uint32_t slot = 0; slot < node.used; slot++)
+            {
+                Aabb box;
+                if(node.count[slot] > 0)
+                {
+                    for(uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++)
+                        box.grow(boxes[objects[i]]);
+                }
+                else
+                    box = nodeBounds(nodes[node.child[slot]]);
+                setSlot(node, slot, box);
+            }
+        }
+        currentCost = computeCost();
+    }
+
+    // appends every object whose box is at least partly inside the six planes (normalized, pointing inwards, like
+    // Camera::GetFrustumPlanes) to out
+    void queryFrustum(const glm::vec4 planes[6], std::vector<uint32_t> &out) const
+    {
+        if(nodes.empty())
+            return;
+        uint32_t stack[STACK_SIZE];
+        uint32_t top = 0;
+        stack[top++] = 0;
+        while(top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            uint32_t partial;
+            uint32_t visible = testFrustum(node, planes, partial);
+            for(uint32_t slot = 0; slot < node.used; slot++)
+            {
+                if(!(visible & (1u << slot)))
+                    continue;
+                bool inside = !(partial & (1u << slot));
+                if(inside)
+                    collect(node, slot, out);
+                else if(node.count[slot] > 0)
+                {
+                    for(uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++)
+                    {
+                        if(boxInFrustum(boxes[objects[i]], planes))
+                            out.push_back(objects[i]);
+                    }
+                }
+                else
+                    stack[top++] = node.child[slot];
+            }
+        }
+    }
+
+    // appends every object whose box overlaps box to out
+    void queryOverlap(const Aabb &box, std::vector<uint32_t> &out) const
+    {
+        if(nodes.empty())
+            return;
+        uint32_t stack[STACK_SIZE];
+        uint32_t top = 0;
+        stack[top++] = 0;
+        while(top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            uint32_t hits = testOverlap(node, box);
+            for(uint32_t slot = 0; slot < node.used; slot++)
+            {
+                if(!(hits & (1u << slot)))
+                    continue;
+                if(node.count[slot] == 0)
+                {
+                    stack[top++] = node.child[slot];
+                    continue;
+                }
+                for(uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++)
+                {
+                    const Aabb &object = boxes[objects[i]];
+                    if(glm::all(glm::lessThanEqual(object.min, box.max)) && glm::all(glm::greaterThanEqual(object.max, box.min)))
+                        out.push_back(objects[i]);
+                }
+            }
+        }
+    }
+
+    // the closest object box the ray hits within maxDistance; direction doesn't have to be normalized, distances are
+    // in multiples of it. false (and hit.object NO_OBJECT) if there is none
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, BvhHit &hit) const
+    {
+        return raycast(origin, direction, maxDistance, hit, [](uint32_t, float boxDistance) { return boxDistance; });
+    }
+
+    // same, with an exact test for the objects whose box the ray hits: intersect(object, boxDistance) returns where the
+    // ray really hits the object, or a negative number for a miss. Boxes further away than the closest hit so far are
+    // never passed to it
+    template <typename Intersect>
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, BvhHit &hit, Intersect intersect) const
+    {
+        hit.object = NO_OBJECT;
+        hit.distance = maxDistance;
+        if(nodes.empty())
+            return false;
+
+        glm::vec3 inverse = 1.0f / direction;
+        struct Entry
+        {
+            uint32_t node;
+            float distance;
+        };
+        Entry stack[STACK_SIZE];
+        uint32_t top = 0;
+        stack[top++] = Entry{ 0, 0.0f };
+        while(top > 0)
+        {
+            Entry entry = stack[--top];
+            if(entry.distance > hit.distance)
+                continue;
+            const Node &node = nodes[entry.node];
+            float distances[4];
+            uint32_t hits = testRay(node, origin, inverse, hit.distance, distances);
+
+            // inner children go on the stack furthest first, so the nearest is looked at next
+            Entry children[4];
+            uint32_t childCount = 0;
+            for(uint32_t slot = 0; slot < node.used; slot++)
+            {
+                if(!(hits & (1u << slot)))
+                    continue;
+                if(node.count[slot] == 0)
+                {
+                    uint32_t at = childCount++;
+                    while(at > 0 && children[at - 1].distance < distances[slot])
+                    {
+                        children[at] = children[at - 1];
+                        at--;
+                    }
+                    children[at] = Entry{ node.child[slot], distances[slot] };
+                    continue;
+                }
+                for(uint32_t i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++)
+                {
+                    float boxDistance;
+                    if(!rayBox(boxes[objects[i]], origin, inverse, hit.distance, boxDistance))
+                        continue;
+                    float distance = intersect(objects[i], boxDistance);
+                    if(distance >= 0.0f && distance <= hit.distance)
+                    {
+                        hit.object = objects[i];
+                        hit.distance = distance;
+                    }
+                }
+            }
+            for(uint32_t c = 0; c < childCount; c++)
+                stack[top++] = children[c];
+        }
+        return hit.object != NO_OBJECT;
+    }
+
+    size_t objectCount() const
+    {
+        return boxes.size();
+    }
+
+    size_t nodeCount() const
+    {
+        return nodes.size();
+    }
+
+    const Aabb &objectBox(uint32_t object) const
+    {
+        return boxes[object];
+    }
+
+    // surface area heuristic cost of the tree as it is now and as it was built; refitting only ever makes it worse
+    float cost() const
+    {
+        return currentCost;
+    }
+
+    float buildCost() const
+    {
+        return builtCost;
+    }
+
+private:
+    // a leaf holds at most this many objects, and the binned build tries this many split positions per axis
+    static const uint32_t MAX_LEAF_SIZE = 4;
+    static const uint32_t BINS = 16;
+    // below this depth the build stops looking for the best split and halves the objects, so no tree gets deeper than
+    // this plus log2 of the object count
+    static const uint32_t SAH_MAX_DEPTH = 32;
+    // traversal pushes at most four entries per level
+    static const uint32_t STACK_SIZE = 4 * (SAH_MAX_DEPTH + 32);
+
+    struct alignas(16) Node
+    {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        // an inner child is the index of its node and has count 0, a leaf is count objects starting at objects[child]
+        uint32_t child[4];
+        uint32_t count[4];
+        uint32_t used;
+    };
+
+    // a run of objects[] during the build with the bounds of its boxes and of their centers
+    struct Range
+    {
+        uint32_t begin;
+        uint32_t end;
+        Aabb bounds;
+        Aabb centerBounds;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> objects;
+    std::vector<Aabb> boxes;
+    std::vector<glm::vec3> centers;
+    float builtCost;
+    float currentCost;
+
+    Range measure(uint32_t begin, uint32_t end) const
+    {
+        Range range;
+        range.begin = begin;
+        range.end = end;
+        for(uint32_t i = begin; i < end; i++)
+        {
+            range.bounds.grow(boxes[objects[i]]);
+            range.centerBounds.grow(centers[objects[i]]);
+        }
+        return range;
+    }
+
+    // fills a node with up to four children by splitting the child with the largest area until there are four or none
+    // is worth splitting, then recurses into the ones that aren't leaves. Returns the node's index
+    uint32_t buildNode(const Range &range, uint32_t depth)
+    {
+        bool median = depth >= SAH_MAX_DEPTH;
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node());
+
+        Range children[4] = { range };
+        bool splittable[4] = { true, true, true, true };
+        uint32_t used = 1;
+        while(used < 4)
+        {
+            int largest = -1;
+            for(uint32_t c = 0; c < used; c++)
+            {
+                if(splittable[c] && (largest < 0 || children[c].bounds.halfArea() > children[largest].bounds.halfArea()))
+                    largest = static_cast<int>(c);
+            }
+            if(largest < 0)
+                break;
+            Range left, right;
+            if(!split(children[largest], left, right, median))
+            {
+                splittable[largest] = false;
+                continue;
+            }
+            children[largest] = left;
+            children[used] = right;
+            splittable[used] = true;
+            used++;
+        }
+
+        // children that ran out of room to split here but wouldn't be split anyway become leaves right away
+        Range left, right;
+        for(uint32_t slot = 0; slot < used; slot++)
+        {
+            if(splittable[slot] && children[slot].end - children[slot].begin <= MAX_LEAF_SIZE && !split(children[slot], left, right, median))
+                splittable[slot] = false;
+        }
+
+        // the root may be a single leaf, every other node was split at least once
+        Node node;
+        node.used = used;
+        for(uint32_t slot = 0; slot < 4; slot++)
+        {
+            node.child[slot] = 0;
+            node.count[slot] = 0;
+            setSlot(node, slot, Aabb());
+        }
+        for(uint32_t slot = 0; slot < used; slot++)
+        {
+            setSlot(node, slot, children[slot].bounds);
+            if(!splittable[slot] || children[slot].end - children[slot].begin <= 1)
+            {
+                node.child[slot] = children[slot].begin;
+                node.count[slot] = children[slot].end - children[slot].begin;
+            }
+        }
+        nodes[index] = node;
+        for(uint32_t slot = 0; slot < used; slot++)
+        {
+            if(nodes[index].count[slot] == 0)
+            {
+                uint32_t child = buildNode(children[slot], depth + 1);
+                nodes[index].child[slot] = child;
+            }
+        }
+        return index;
+    }
+
+    // binned SAH split of range, false if keeping it as one leaf is cheaper (only allowed up to MAX_LEAF_SIZE objects).
+    // median splits the objects in half along the longest axis of their centers instead
+    bool split(const Range &range, Range &left, Range &right, bool median)
+    {
+        uint32_t count = range.end - range.begin;
+        if(count <= 1)
+            return false;
+        if(median)
+        {
+            if(count <= MAX_LEAF_SIZE)
+                return false;
+            glm::vec3 size = range.centerBounds.max - range.centerBounds.min;
+            int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+            uint32_t middle = range.begin + count / 2;
+            std::nth_element(objects.data() + range.begin, objects.data() + middle, objects.data() + range.end, [&](uint32_t a, uint32_t b)
+            {
+                return centers[a][axis] < centers[b][axis];
+            });
+            left = measure(range.begin, middle);
+            right = measure(middle, range.end);
+            return true;
+        }
+
+        // cost of intersecting every object against the cost of one more node test plus the two halves
+        float leafCost = range.bounds.halfArea() * count;
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        glm::vec3 extent = range.centerBounds.max - range.centerBounds.min;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            if(extent[axis] <= 0.0f)
+                continue;
+            Aabb binBounds[BINS];
+            uint32_t binCounts[BINS] = {};
+            float scale = BINS / extent[axis];
+            for(uint32_t i = range.begin; i < range.end; i++)
+            {
+                uint32_t bin = binOf(centers[objects[i]][axis], range.centerBounds.min[axis], scale);
+                binBounds[bin].grow(boxes[objects[i]]);
+                binCounts[bin]++;
+            }
+
+            // areas of everything right of each boundary, then sweep from the left
+            float rightAreas[BINS];
+            uint32_t rightCounts[BINS];
+            Aabb sweep;
+            uint32_t sweepCount = 0;
+            for(uint32_t bin = BINS - 1; bin > 0; bin--)
+            {
+                sweep.grow(binBounds[bin]);
+                sweepCount += binCounts[bin];
+                rightAreas[bin] = sweep.halfArea();
+                rightCounts[bin] = sweepCount;
+            }
+            sweep = Aabb();
+            sweepCount = 0;
+            for(uint32_t bin = 1; bin < BINS; bin++)
+            {
+                sweep.grow(binBounds[bin - 1]);
+                sweepCount += binCounts[bin - 1];
+                if(sweepCount == 0 || rightCounts[bin] == 0)
+                    continue;
+                float splitCost = sweep.halfArea() * sweepCount + rightAreas[bin] * rightCounts[bin];
+                if(splitCost < bestCost)
+                {
+                    bestCost = splitCost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+
+        uint32_t middle;
+        if(bestAxis < 0)
+        {
+            // every center in the same spot, nothing to split by but the order
+            if(count <= MAX_LEAF_SIZE)
+                return false;
+            middle = range.begin + count / 2;
+        }
+        else
+        {
+            // one node test costs about as much as one object test, weighed by the area it is done over
+            if(bestCost + range.bounds.halfArea() >= leafCost && count <= MAX_LEAF_SIZE)
+                return false;
+            float origin = range.centerBounds.min[bestAxis];
+            float scale = BINS / extent[bestAxis];
+            uint32_t *first = objects.data() + range.begin;
+            uint32_t *last = objects.data() + range.end;
+            middle = static_cast<uint32_t>(std::partition(first, last, [&](uint32_t object)
+            {
+                return binOf(centers[object][bestAxis], origin, scale) < bestBin;
+            }) - objects.data());
+        }
+        left = measure(range.begin, middle);
+        right = measure(middle, range.end);
+        return true;
+    }
+
+    static uint32_t binOf(float center, float origin, float scale)
+    {
+        int bin = static_cast<int>((center - origin) * scale);
+        return static_cast<uint32_t>(std::min(std::max(bin, 0), static_cast<int>(BINS) - 1));
+    }
+
+    static void setSlot(Node &node, uint32_t slot, const Aabb &box)
+    {
+        node.minX[slot] = box.min.x;
+        node.minY[slot] = box.min.y;
+        node.minZ[slot] = box.min.z;
+        node.maxX[slot] = box.max.x;
+        node.maxY[slot] = box.max.y;
+        node.maxZ[slot] = box.max.z;
+    }
+
+    static Aabb slotBounds(const Node &node, uint32_t slot)
+    {
+        return Aabb(glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]), glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]));
+    }
+
+    static Aabb nodeBounds(const Node &node)
+    {
+        Aabb bounds;
+        for(uint32_t slot = 0; slot < node.used; slot++)
+            bounds.grow(slotBounds(node, slot));
+        return bounds;
+    }
+
+    // sum of every node's area over the root's, leaves weighted by their object count
+    float computeCost() const
+    {
+        if(nodes.empty())
+            return 0.0f;
+        float rootArea = std::max(nodeBounds(nodes[0]).halfArea(), std::numeric_limits<float>::min());
+        float total = 0.0f;
+        for(const Node &node : nodes)
+        {
+            for(uint32_t slot = 0; slot < node.used; slot++)
+                total += slotBounds(node, slot).halfArea() * std::max<uint32_t>(node.count[slot], 1);
+        }
+        return total / rootArea;
+    }
+
+    // every object below a slot, no tests
+    void collect(const Node &node, uint32_t slot, std::vector<uint32_t> &out) const
+    {
+        if(node.count[slot] > 0)
+        {
+            out.insert(out.end(), objects.begin() + node.child[slot], objects.begin() + node.child[slot] + node.count[slot]);
+            return;
+        }
+        const Node &child = nodes[node.child[slot]];
+        for(uint32_t s = 0; s < child.used; s++)
+            collect(child, s, out);
+    }
+
+    static bool boxInFrustum(const Aabb &box, const glm::vec4 planes[6])
+    {
+        for(unsigned int p = 0; p < 6; p++)
+        {
+            // the corner furthest along the plane's normal
+            glm::vec3 corner(planes[p].x > 0.0f ? box.max.x : box.min.x, planes[p].y > 0.0f ? box.max.y : box.min.y, planes[p].z > 0.0f ? box.max.z : box.min.z);
+            if(glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    static bool rayBox(const Aabb &box, const glm::vec3 &origin, const glm::vec3 &inverse, float maxDistance, float &distance)
+    {
+        glm::vec3 t1 = (box.min - origin) * inverse;
+        glm::vec3 t2 = (box.max - origin) * inverse;
+        glm::vec3 near = glm::min(t1, t2);
+        glm::vec3 far = glm::max(t1, t2);
+        distance = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+        return distance <= exit;
+    }
+
+    static uint32_t usedMask(const Node &node)
+    {
+        return (1u << node.used) - 1u;
+    }
+
+    // bit per slot whose box is at least partly inside the frustum; partial gets a bit per slot that isn't all inside
+    static uint32_t testFrustum(const Node &node, const glm::vec4 planes[6], uint32_t &partial)
+    {
+        uint32_t outside = 0;
+        partial = 0;
+#ifdef BVH_SSE
+        __m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+        __m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+        __m128 zero = _mm_setzero_ps();
+        for(unsigned int p = 0; p < 6; p++)
+        {
+            __m128 nx = _mm_set1_ps(planes[p].x), ny = _mm_set1_ps(planes[p].y), nz = _mm_set1_ps(planes[p].z);
+            __m128 w = _mm_set1_ps(planes[p].w);
+            // furthest corner along the normal decides outside, the nearest one decides whether it is cut
+            __m128 far = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, planes[p].x > 0.0f ? maxX : minX), _mm_mul_ps(ny, planes[p].y > 0.0f ? maxY : minY)),
+                                    _mm_add_ps(_mm_mul_ps(nz, planes[p].z > 0.0f ? maxZ : minZ), w));
+            __m128 near = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, planes[p].x > 0.0f ? minX : maxX), _mm_mul_ps(ny, planes[p].y > 0.0f ? minY : maxY)),
+                                     _mm_add_ps(_mm_mul_ps(nz, planes[p].z > 0.0f ? minZ : maxZ), w));
+            outside |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(far, zero)));
+            partial |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(near, zero)));
+        }
+#else
+        for(uint32_t slot = 0; slot < 4; slot++)
+        {
+            for(unsigned int p = 0; p < 6; p++)
+            {
+                const glm::vec4 &plane = planes[p];
+                float far = plane.x * (plane.x > 0.0f ? node.maxX[slot] : node.minX[slot]) + plane.y * (plane.y > 0.0f ? node.maxY[slot] : node.minY[slot])
+                    + plane.z * (plane.z > 0.0f ? node.maxZ[slot] : node.minZ[slot]) + plane.w;
+                float near = plane.x * (plane.x > 0.0f ? node.minX[slot] : node.maxX[slot]) + plane.y * (plane.y > 0.0f ? node.minY[slot] : node.maxY[slot])
+                    + plane.z * (plane.z > 0.0f ? node.minZ[slot] : node.maxZ[slot]) + plane.w;
+                if(far < 0.0f)
+                    outside |= 1u << slot;
+                if(near < 0.0f)
+                    partial |= 1u << slot;
+            }
+        }
+#endif
+        return ~outside & usedMask(node);
+    }
+
+    // bit per slot whose box overlaps box
+    static uint32_t testOverlap(const Node &node, const Aabb &box)
+    {
+        uint32_t hits = 0;
+#ifdef BVH_SSE
+        __m128 overlap = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), _mm_set1_ps(box.max.x)), _mm_cmpge_ps(_mm_load_ps(node.maxX), _mm_set1_ps(box.min.x))),
+                                    _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), _mm_set1_ps(box.max.y)), _mm_cmpge_ps(_mm_load_ps(node.maxY), _mm_set1_ps(box.min.y))));
+        overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), _mm_set1_ps(box.max.z)), _mm_cmpge_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(box.min.z))));
+        hits = static_cast<uint32_t>(_mm_movemask_ps(overlap));
+#else
+        for(uint32_t slot = 0; slot < 4; slot++)
+        {
+            if(node.minX[slot] <= box.max.x && node.maxX[slot] >= box.min.x && node.minY[slot] <= box.max.y && node.maxY[slot] >= box.min.y
+               && node.minZ[slot] <= box.max.z && node.maxZ[slot] >= box.min.z)
+                hits |= 1u << slot;
+        }
+#endif
+        return hits & usedMask(node);
+    }
+
+    // bit per slot whose box the ray enters before maxDistance, with where it enters in distances
+    static uint32_t testRay(const Node &node, const glm::vec3 &origin, const glm::vec3 &inverse, float maxDistance, float distances[4])
+    {
+        uint32_t hits = 0;
+#ifdef BVH_SSE
+        __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        __m128 ix = _mm_set1_ps(inverse.x), iy = _mm_set1_ps(inverse.y), iz = _mm_set1_ps(inverse.z);
+        __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix), t2x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+        __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy), t2y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+        __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz), t2z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+        __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+        __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_set1_ps(maxDistance)));
+        _mm_storeu_ps(distances, enter);
+        hits = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+#else
+        for(uint32_t slot = 0; slot < 4; slot++)
+        {
+            if(rayBox(slotBounds(node, slot), origin, inverse, maxDistance, distances[slot]))
+                hits |= 1u << slot;
+        }
+#endif
+        return hits & usedMask(node);
+    }
+};
+
+// a Bvh over objects that move every frame: update() refits it with the new boxes and, once refitting has made it too
+// loose (or every REBUILD_INTERVAL updates), builds a fresh tree from a copy of the boxes on the thread pool. The
+// fresh tree replaces the old one on the first update() after it is done, refitted to that update's boxes.
+// Queries go to current(), which only changes inside update()
+class AsyncBvh
+{
+public:
+    static const unsigned int REBUILD_INTERVAL = 300;
+
+    AsyncBvh() : updatesSinceBuild(0), building(false), built(false)
+    {
+    }
+
+    ~AsyncBvh()
+    {
+        // the job writes into this object
+        while(building && !built)
+            std::this_thread::yield();
+    }
+
+    AsyncBvh(const AsyncBvh&) = delete;
+    AsyncBvh &operator=(const AsyncBvh&) = delete;
+
+    // boxes are every object's current bounds, in the same order every time. A change in the number of objects is
+    // rebuilt right away, on this thread
+    void update(const std::vector<Aabb> &boxes, ThreadPool &pool)
+    {
+        if(building && built)
+        {
+            tree = std::move(next);
+            next = Bvh();
+            building = false;
+            built = false;
+            updatesSinceBuild = 0;
+        }
+
+        if(tree.objectCount() != boxes.size())
+        {
+            tree.build(boxes);
+            updatesSinceBuild = 0;
+            return;
+        }
+        tree.refit(boxes);
+        updatesSinceBuild++;
+
+        if(!building && (tree.cost() > tree.buildCost() * BVH_REBUILD_COST_RATIO || updatesSinceBuild >= REBUILD_INTERVAL))
+        {
+            building = true;
+            pending = boxes;
+            // always on a worker: parallelFor only helps with its own batches, so no caller picks this up mid frame
+            pool.submit([this]()
+            {
+                next.build(pending);
+                built.store(true, std::memory_order_release);
+            });
+        }
+    }
+
+    const Bvh &current() const
+    {
+        return tree;
+    }
+
+    bool rebuilding() const
+    {
+        return building;
+    }
+
+private:
+    Bvh tree;
+    Bvh next;
+    std::vector<Aabb> pending;
+    unsigned int updatesSinceBuild;
+    bool building;
+    std::atomic<bool> built;
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef PICKING_H
+#define PICKING_H
+
+#include <glm/glm.hpp>
+
+#include <camera/camera.h>
+#include <scene/bvh.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// picks objects under a screen position: the position is unprojected into a ray through the camera, the Bvh finds the
+// object boxes it passes through nearest first, and only those get an exact test against the object's box in its own
+// space (the world boxes of rotated objects are much larger than the objects)
+class ScenePicker
+{
+public:
+    // the object under pixel (x, y) of a width x height viewport (y down, like the cursor), nearest first.
+    // models are the objects' model matrices indexed like the Bvh's objects, localBox their bounds in model space
+    static bool pick(const Bvh &bvh, Camera &camera, float x, float y, float width, float height, const glm::mat4 *models, const Aabb &localBox, BvhHit &hit)
+    {
+        glm::vec3 origin, direction;
+        camera.GetRay(x / width * 2.0f - 1.0f, 1.0f - y / height * 2.0f, origin, direction);
+        return pick(bvh, origin, direction, camera.FarPlane, models, localBox, hit);
+    }
+
+    // same for a world space ray; distances are along direction
+    static bool pick(const Bvh &bvh, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, const glm::mat4 *models, const Aabb &localBox, BvhHit &hit)
+    {
+        return bvh.raycast(origin, direction, maxDistance, hit, [&](uint32_t object, float)
+        {
+            return rayOrientedBox(models[object], localBox, origin, direction);
+        });
+    }
+
+    // where the ray enters box after transforming it by model (any affine matrix), negative if it misses.
+    // a ray starting inside the box hits it at 0
+    static float rayOrientedBox(const glm::mat4 &model, const Aabb &box, const glm::vec3 &origin, const glm::vec3 &direction)
+    {
+        // into the box's space; distances along the ray stay the same since the direction is transformed with it
+        glm::mat4 inverse = glm::inverse(model);
+        glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+        glm::vec3 localDirection = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+        glm::vec3 t1 = (box.min - localOrigin) / localDirection;
+        glm::vec3 t2 = (box.max - localOrigin) / localDirection;
+        glm::vec3 near = glm::min(t1, t2);
+        glm::vec3 far = glm::max(t1, t2);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), far.z);
+        return enter <= exit ? enter : -1.0f;
+    }
+};
+#endif
\ No newline at end of file
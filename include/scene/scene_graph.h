@@ -0,0 +1,336 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <math/transform_kernel.h>
+#include <threading/thread_pool.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// a transform hierarchy kept as flat arrays sorted by depth: every node comes after its parent, so the world matrices
+// are one linear pass (and the nodes of one depth can be done in parallel). Local transforms are stored as structure
+// of arrays in the layout TransformKernel takes. Only nodes whose local transform changed since the last update(), and
+// the nodes below them, get new matrices; everything else keeps the one it had.
+// Nodes are addressed by handles that stay the same when the arrays are re-sorted
+class SceneGraph
+{
+public:
+    static const uint32_t NO_PARENT = ~0u;
+
+    SceneGraph() : orderChanged(false), lastUpdated(0)
+    {
+    }
+
+    // a new node at the identity under parent (a handle, or NO_PARENT for a root); returns its handle
+    uint32_t create(uint32_t parent = NO_PARENT)
+    {
+        uint32_t handle = static_cast<uint32_t>(parentHandles.size());
+        parentHandles.push_back(parent);
+        indexOf.push_back(static_cast<uint32_t>(handleOf.size()));
+        handleOf.push_back(handle);
+        positionsX.push_back(0.0f);
+        positionsY.push_back(0.0f);
+        positionsZ.push_back(0.0f);
+        rotationsX.push_back(0.0f);
+        rotationsY.push_back(0.0f);
+        rotationsZ.push_back(0.0f);
+        rotationsW.push_back(1.0f);
+        scalesX.push_back(1.0f);
+        scalesY.push_back(1.0f);
+        scalesZ.push_back(1.0f);
+        parents.push_back(0);
+        locals.push_back(glm::mat4(1.0f));
+        worlds.push_back(glm::mat4(1.0f));
+        dirty.push_back(0);
+        changed.push_back(0);
+        // the parent index and depth are worked out when the arrays are sorted, on the next update()
+        orderChanged = true;
+        return handle;
+    }
+
+    // moves a node (and everything below it) under another parent. parent can't be the node or one of its descendants
+    void setParent(uint32_t handle, uint32_t parent)
+    {
+        if(parentHandles[handle] == parent)
+            return;
+        parentHandles[handle] = parent;
+        orderChanged = true;
+    }
+
+    // sets a node's transform relative to its parent. Setting the value it already has doesn't dirty anything
+    void setLocal(uint32_t handle, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+    {
+        uint32_t i = indexOf[handle];
+        if(positionsX[i] == position.x && positionsY[i] == position.y && positionsZ[i] == position.z &&
+           rotationsX[i] == rotation.x && rotationsY[i] == rotation.y && rotationsZ[i] == rotation.z && rotationsW[i] == rotation.w &&
+           scalesX[i] == scale.x && scalesY[i] == scale.y && scalesZ[i] == scale.z)
+            return;
+        positionsX[i] = position.x;
+        positionsY[i] = position.y;
+        positionsZ[i] = position.z;
+        rotationsX[i] = rotation.x;
+        rotationsY[i] = rotation.y;
+        rotationsZ[i] = rotation.z;
+        rotationsW[i] = rotation.w;
+        scalesX[i] = scale.x;
+        scalesY[i] = scale.y;
+        scalesZ[i] = scale.z;
+        markDirty(i);
+    }
+
+    // brings every world matrix up to date. With a pool, the locals and each depth level are split across it
+    void update(ThreadPool *pool = nullptr)
+    {
+        lastUpdated = 0;
+        if(orderChanged)
+            sortByDepth();
+        if(dirtyNodes.empty())
+            return;
+
+        composeLocals(pool);
+
+        // a node needs a new world matrix if it moved itself or its parent got a new one this pass. Parents sit in
+        // the levels above, so their flag is final by the time a level reads it
+        std::atomic<size_t> updated(0);
+        for(size_t level = 0; level + 1 < levelOffsets.size(); level++)
+        {
+            size_t first = levelOffsets[level];
+            size_t count = levelOffsets[level + 1] - first;
+            auto propagate = [&](size_t begin, size_t end)
+            {
+                size_t recomputed = 0;
+                for(size_t i = first + begin; i < first + end; i++)
+                {
+                    uint32_t parent = parents[i];
+                    bool moved = dirty[i] || (parent != NO_PARENT && changed[parent]);
+                    changed[i] = moved;
+                    if(!moved)
+                        continue;
+                    worlds[i] = parent == NO_PARENT ? locals[i] : worlds[parent] * locals[i];
+                    recomputed++;
+                }
+                updated += recomputed;
+            };
+            if(pool && count >= MIN_BATCH * 2)
+                pool->parallelFor(count, MIN_BATCH, propagate);
+            else
+                propagate(0, count);
+        }
+        lastUpdated = updated;
+
+        for(uint32_t i : dirtyNodes)
+            dirty[i] = 0;
+        dirtyNodes.clear();
+    }
+
+    // valid after update()
+    const glm::mat4 &world(uint32_t handle) const
+    {
+        return worlds[indexOf[handle]];
+    }
+
+    const glm::mat4 &local(uint32_t handle) const
+    {
+        return locals[indexOf[handle]];
+    }
+
+    uint32_t parent(uint32_t handle) const
+    {
+        return parentHandles[handle];
+    }
+
+    size_t size() const
+    {
+        return handleOf.size();
+    }
+
+    // how many world matrices the last update() recomputed
+    size_t updatedCount() const
+    {
+        return lastUpdated;
+    }
+
+private:
+    // nodes per batch when the work is split across a pool
+    static const size_t MIN_BATCH = 1024;
+
+    // everything below is in sorted order, except parentHandles and indexOf which are by handle
+    std::vector<uint32_t> parentHandles;
+    std::vector<uint32_t> indexOf;
+    std::vector<uint32_t> handleOf;
+    std::vector<float> positionsX, positionsY, positionsZ;
+    std::vector<float> rotationsX, rotationsY, rotationsZ, rotationsW;
+    std::vector<float> scalesX, scalesY, scalesZ;
+    std::vector<uint32_t> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+    std::vector<uint8_t> changed;
+    std::vector<uint32_t> dirtyNodes;
+    // where each depth starts in the sorted arrays, with the end of the arrays last
+    std::vector<size_t> levelOffsets;
+    bool orderChanged;
+    size_t lastUpdated;
+
+    // the local transforms gathered from dirty nodes when only some of them changed
+    std::vector<float> gathered;
+    std::vector<glm::mat4> composed;
+
+    void markDirty(uint32_t i)
+    {
+        if(dirty[i])
+            return;
+        dirty[i] = 1;
+        dirtyNodes.push_back(i);
+    }
+
+    void composeLocals(ThreadPool *pool)
+    {
+        size_t count = dirtyNodes.size();
+        if(count == handleOf.size())
+        {
+            // everything moved, compose straight from the arrays into place
+            TransformArrays all = {
+                Vec3Arrays{ positionsX.data(), positionsY.data(), positionsZ.data() },
+                rotationsX.data(), rotationsY.data(), rotationsZ.data(), rotationsW.data(),
+                Vec3Arrays{ scalesX.data(), scalesY.data(), scalesZ.data() }
+            };
+            composeRange(pool, all, count, &locals[0][0][0]);
+            return;
+        }
+
+        // gather the dirty nodes into packed arrays, compose those, and scatter the matrices back
+        gathered.resize(count * 10);
+        composed.resize(count);
+        float *columns[10];
+        for(size_t c = 0; c < 10; c++)
+            columns[c] = gathered.data() + c * count;
+        for(size_t n = 0; n < count; n++)
+        {
+            uint32_t i = dirtyNodes[n];
+            columns[0][n] = positionsX[i];
+            columns[1][n] = positionsY[i];
+            columns[2][n] = positionsZ[i];
+            columns[3][n] = rotationsX[i];
+            columns[4][n] = rotationsY[i];
+            columns[5][n] = rotationsZ[i];
+            columns[6][n] = rotationsW[i];
+            columns[7][n] = scalesX[i];
+            columns[8][n] = scalesY[i];
+            columns[9][n] = scalesZ[i];
+        }
+        TransformArrays packed = {
+            Vec3Arrays{ columns[0], columns[1], columns[2] },
+            columns[3], columns[4], columns[5], columns[6],
+            Vec3Arrays{ columns[7], columns[8], columns[9] }
+        };
+        composeRange(pool, packed, count, &composed[0][0][0]);
+        for(size_t n = 0; n < count; n++)
+            locals[dirtyNodes[n]] = composed[n];
+    }
+
+    // TransformKernel::compose over count transforms, split across the pool when there are enough of them
+    static void composeRange(ThreadPool *pool, const TransformArrays &in, size_t count, float *out)
+    {
+        if(!pool || count < MIN_BATCH * 2)
+        {
+            TransformKernel::compose(in, count, out);
+            return;
+        }
+        pool->parallelFor(count, MIN_BATCH, [&](size_t begin, size_t end)
+        {
+            TransformArrays part = {
+                Vec3Arrays{ in.positions.x + begin, in.positions.y + begin, in.positions.z + begin },
+                in.qx + begin, in.qy + begin, in.qz + begin, in.qw + begin,
+                Vec3Arrays{ in.scales.x + begin, in.scales.y + begin, in.scales.z + begin }
+            };
+            TransformKernel::compose(part, end - begin, out + begin * 16);
+        });
+    }
+
+    // re-sorts every array by depth (stable, so siblings keep their order) after nodes were added or moved. The
+    // structure changed, so every node is dirty afterwards
+    void sortByDepth()
+    {
+        size_t count = handleOf.size();
+        // a copy: the vector takes the fill value by reference, which needs a definition of NO_PARENT without optimization
+        std::vector<uint32_t> depths(count, static_cast<uint32_t>(NO_PARENT));
+        std::vector<uint32_t> chain;
+        uint32_t maxDepth = 0;
+        for(uint32_t handle = 0; handle < count; handle++)
+        {
+            // walk up to the first node whose depth is known, then fill the depths in on the way back down
+            uint32_t node = handle;
+            while(depths[node] == NO_PARENT && parentHandles[node] != NO_PARENT)
+            {
+                chain.push_back(node);
+                node = parentHandles[node];
+            }
+            if(depths[node] == NO_PARENT)
+                depths[node] = 0;
+            uint32_t depth = depths[node];
+            while(!chain.empty())
+            {
+                depths[chain.back()] = ++depth;
+                chain.pop_back();
+            }
+            if(depth > maxDepth)
+                maxDepth = depth;
+        }
+
+        // counting sort of the handles by depth, walking them in their current order
+        levelOffsets.assign(maxDepth + 2, 0);
+        for(uint32_t handle = 0; handle < count; handle++)
+            levelOffsets[depths[handle] + 1]++;
+        for(size_t level = 1; level < levelOffsets.size(); level++)
+            levelOffsets[level] += levelOffsets[level - 1];
+        std::vector<size_t> next(levelOffsets.begin(), levelOffsets.end() - 1);
+        std::vector<uint32_t> order(count);
+        for(size_t i = 0; i < count; i++)
+        {
+            uint32_t handle = handleOf[i];
+            order[next[depths[handle]]++] = static_cast<uint32_t>(i);
+        }
+
+        permute(positionsX, order);
+        permute(positionsY, order);
+        permute(positionsZ, order);
+        permute(rotationsX, order);
+        permute(rotationsY, order);
+        permute(rotationsZ, order);
+        permute(rotationsW, order);
+        permute(scalesX, order);
+        permute(scalesY, order);
+        permute(scalesZ, order);
+        permute(handleOf, order);
+        for(uint32_t i = 0; i < count; i++)
+            indexOf[handleOf[i]] = i;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            uint32_t parent = parentHandles[handleOf[i]];
+            parents[i] = parent == NO_PARENT ? NO_PARENT : indexOf[parent];
+        }
+
+        dirtyNodes.clear();
+        for(uint32_t i = 0; i < count; i++)
+        {
+            dirty[i] = 0;
+            markDirty(i);
+        }
+        orderChanged = false;
+    }
+
+    template <typename T>
+    static void permute(std::vector<T> &values, const std::vector<uint32_t> &order)
+    {
+        std::vector<T> sorted(values.size());
+        for(size_t i = 0; i < order.size(); i++)
+            sorted[i] = values[order[i]];
+        values.swap(sorted);
+    }
+};
+#endif
\ No newline at end of file
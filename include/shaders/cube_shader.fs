@@ -1,14 +1,47 @@
-#version 330 core
-out vec4 FragColor;
+#version 440 core
+layout (location = 0) out vec4 FragColor;
+#ifdef OBJECT_ID
+// the object id buffer, see ObjectIdBuffer
+layout (location = 1) out uint ObjectId;
+uniform uint objectId;
+#endif
+#ifdef IMPOSTOR_BAKE
+// the second atlas of ImpostorRenderer::bake, the color goes out unlit and impostor.fs lights it
+layout (location = 1) out vec4 BakedNormal;
+#endif
 
 in vec2 TexCoord;
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+in vec3 Normal;
+in vec3 FragPos;
+
+#include "lighting.glsl"
+#elif defined(IMPOSTOR_BAKE)
+in vec3 Normal;
+#endif
 
 // texture samplers
 uniform sampler2D texture1;
+#ifdef USE_TEXTURE2
 uniform sampler2D texture2;
+#endif
 
 void main()
 {
+#ifdef USE_TEXTURE2
 	// linearly interpolate between both textures (80% container, 20% awesomeface)
 	FragColor = mix(texture(texture1, TexCoord), texture(texture2, TexCoord), 0.2);
+#else
+	FragColor = texture(texture1, TexCoord);
+#endif
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+	FragColor.rgb *= sceneLighting(normalize(Normal), FragPos);
+#endif
+#ifdef IMPOSTOR_BAKE
+	// the model space normal, and how far along the view the surface is (the bake's orthographic depth is linear)
+	BakedNormal = vec4(normalize(Normal) * 0.5 + 0.5, gl_FragCoord.z);
+#endif
+#ifdef OBJECT_ID
+	ObjectId = objectId;
+#endif
 }
\ No newline at end of file
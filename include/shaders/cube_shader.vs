@@ -1,15 +1,45 @@
-#version 330 core
+#version 440 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+#ifdef OCT_NORMALS
+layout (location = 6) in vec2 aNormal;
+#else
+layout (location = 6) in vec3 aNormal;
+#endif
 
 out vec2 TexCoord;
+out vec3 Normal;
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+out vec3 FragPos;
+#endif
 
+#ifdef INSTANCED
+// one model matrix per instance from an instance buffer, takes locations 2 to 5
+layout (location = 2) in mat4 instanceModel;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#endif
+
+// filled from a persistently mapped buffer so the view can be late latched just before drawing
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+};
+
+#include "vertex_decode.glsl"
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+#ifdef INSTANCED
+	mat4 model = instanceModel;
+#endif
+	vec4 worldPos = model * vec4(aPos, 1.0f);
+	gl_Position = projection * view * worldPos;
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+	FragPos = worldPos.xyz;
+#endif
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+	// the model matrix only carries a uniform scale, so it can transform normals too
+	Normal = normalize(mat3(model) * decodeNormal(aNormal));
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// flat placeholder used while the real shader is still compiling
+void main()
+{
+	FragColor = vec4(0.5, 0.5, 0.5, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 440 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D atlas;
+
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+in vec3 FragPos;
+flat in vec3 FrameDirection;
+flat in mat3 NormalMatrix;
+
+// the model space normals and depths baked next to the colors, see ImpostorRenderer::bake
+uniform sampler2D normals;
+uniform float radius;
+
+#include "lighting.glsl"
+#endif
+
+void main()
+{
+	vec4 color = texture(atlas, TexCoord);
+	// the atlas is transparent around the mesh, cut the quad out instead of blending so it sorts with depth
+	if(color.a < 0.5)
+		discard;
+	FragColor = vec4(color.rgb, 1.0);
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+	// the colors are baked unlit, so the impostor is lit here like the mesh it stands in for. The quad goes through
+	// the mesh's center; the baked depth (the bake camera sits 2 radii out, its depth range runs from 0.5 to 3.5
+	// radii) moves the fragment onto the surface it shows, so the mesh doesn't shadow its own front
+	vec4 baked = texture(normals, TexCoord);
+	vec3 normal = normalize(NormalMatrix * (baked.xyz * 2.0 - 1.0));
+	vec3 position = FragPos + NormalMatrix * (FrameDirection * (radius * (1.5 - baked.w * 3.0)));
+	FragColor.rgb *= sceneLighting(normal, position);
+#endif
+}
@@ -0,0 +1,60 @@
+#version 440 core
+// a camera facing quad per instance showing the atlas view nearest to where the camera sees the instance from, see
+// ImpostorRenderer. No vertex attributes besides the instance matrix, the corners come from gl_VertexID (a strip of 4)
+layout (location = 2) in mat4 instanceModel;
+
+out vec2 TexCoord;
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+// where the quad is, and what impostor.fs needs to move that onto the baked surface and turn the baked normal
+out vec3 FragPos;
+flat out vec3 FrameDirection;
+flat out mat3 NormalMatrix;
+#endif
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+};
+
+// the baked mesh's bounding radius in model space, and the views per side of the atlas
+uniform float radius;
+uniform float frames;
+
+#include "vertex_decode.glsl"
+
+// the same as VertexPacker::octEncode
+vec2 octEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.z < 0.0)
+		return vec2((1.0 - abs(n.y)) * (n.x >= 0.0 ? 1.0 : -1.0), (1.0 - abs(n.x)) * (n.y >= 0.0 ? 1.0 : -1.0));
+	return n.xy;
+}
+
+void main()
+{
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec3 center = instanceModel[3].xyz;
+	vec3 cameraPosition = -transpose(mat3(view)) * view[3].xyz;
+
+	// the direction to the camera in the instance's own space (the model matrix only carries a uniform scale), snapped
+	// to the nearest baked view
+	vec3 direction = normalize(transpose(mat3(instanceModel)) * (cameraPosition - center));
+	vec2 frame = clamp(floor((octEncode(direction) * 0.5 + 0.5) * frames), vec2(0.0), vec2(frames - 1.0));
+	vec3 frameDirection = octDecode((frame + 0.5) / frames * 2.0 - 1.0);
+
+	// the basis glm::lookAt gave the view when it was baked (ImpostorRenderer::frameUp)
+	vec3 up = abs(frameDirection.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	vec3 right = normalize(cross(up, frameDirection));
+	up = cross(frameDirection, right);
+
+	vec3 position = center + mat3(instanceModel) * ((right * corner.x + up * corner.y) * radius);
+	gl_Position = projection * view * vec4(position, 1.0);
+	TexCoord = (frame + corner * 0.5 + 0.5) / frames;
+#if defined(CLUSTERED_LIGHTS) || defined(SHADOWS)
+	FragPos = position;
+	FrameDirection = frameDirection;
+	NormalMatrix = mat3(instanceModel);
+#endif
+}
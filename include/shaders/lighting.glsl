@@ -0,0 +1,105 @@
+// the scene lighting shared by cube_shader.fs and impostor.fs: an ambient term, the clustered point lights under
+// CLUSTERED_LIGHTS and the shadowed sun under SHADOWS. Include it from a fragment shader that defines at least one
+const float AMBIENT = 0.15;
+
+#ifdef CLUSTERED_LIGHTS
+
+// see ClusteredLights, the bindings are its LIGHT_BINDING, CLUSTER_BINDING and INDEX_BINDING
+struct PointLight
+{
+	vec4 positionRadius;
+	vec4 color;
+};
+
+layout (std430, binding = 3) readonly buffer LightBuffer
+{
+	PointLight lights[];
+};
+
+layout (std430, binding = 4) readonly buffer ClusterBuffer
+{
+	// tiles per pixel in x and y, then slice = log(depth) * z + w
+	vec4 clusterScale;
+	// near and far plane
+	vec4 clusterDepth;
+	// offset into lightIndices and count, per cluster
+	uvec2 clusters[];
+};
+
+layout (std430, binding = 5) readonly buffer LightIndexBuffer
+{
+	uint lightIndices[];
+};
+
+// ClusteredLights::CLUSTERS_X, CLUSTERS_Y and CLUSTERS_Z
+const uvec3 CLUSTER_GRID = uvec3(16, 9, 24);
+
+// every light listed in this fragment's cluster (ambient not included), Lambert with a falloff that reaches zero at the light's radius
+vec3 clusteredLighting(vec3 normal, vec3 position)
+{
+	float nearPlane = clusterDepth.x;
+	float farPlane = clusterDepth.y;
+	float depth = nearPlane * farPlane / (farPlane - gl_FragCoord.z * (farPlane - nearPlane));
+	uvec3 cell = uvec3(clamp(vec3(gl_FragCoord.xy * clusterScale.xy, log(depth) * clusterScale.z + clusterScale.w), vec3(0.0), vec3(CLUSTER_GRID - 1u)));
+	uvec2 range = clusters[(cell.z * CLUSTER_GRID.y + cell.y) * CLUSTER_GRID.x + cell.x];
+
+	vec3 light = vec3(0.0);
+	for(uint i = range.x; i < range.x + range.y; i++)
+	{
+		PointLight point = lights[lightIndices[i]];
+		vec3 toLight = point.positionRadius.xyz - position;
+		float distanceSquared = dot(toLight, toLight);
+		float radius = point.positionRadius.w;
+		float window = clamp(1.0 - distanceSquared * distanceSquared / (radius * radius * radius * radius), 0.0, 1.0);
+		float attenuation = window * window / (distanceSquared + 1.0);
+		light += point.color.rgb * attenuation * max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+	}
+	return light;
+}
+#endif
+
+#ifdef SHADOWS
+// see ShadowCascades, the binding is its UNIFORM_BINDING and the maps sit on its TEXTURE_UNIT
+layout (std140, binding = 1) uniform ShadowBlock
+{
+	mat4 cascadeMatrices[4];
+	// world size of one shadow map texel, per cascade
+	vec4 cascadeTexels;
+	// the way the light travels, and its color
+	vec4 sunDirection;
+	vec4 sunColor;
+};
+
+layout (binding = 1) uniform sampler2DArrayShadow shadowMaps;
+
+// ShadowCascades::CASCADES
+const int SHADOW_CASCADES = 4;
+
+// how much of the sun reaches this fragment, from the finest cascade whose box it is in (the boxes are larger than the
+// view slices they were fitted to, so that is never a coarser one than needed); 1 outside all of them
+float sunShadow(vec3 normal, vec3 position)
+{
+	for(int cascade = 0; cascade < SHADOW_CASCADES; cascade++)
+	{
+		// pushed out along the normal by a texel or so, which keeps surfaces from shadowing themselves
+		vec3 offset = position + normal * cascadeTexels[cascade] * 1.5;
+		vec3 coord = (cascadeMatrices[cascade] * vec4(offset, 1.0)).xyz * 0.5 + 0.5;
+		if(all(greaterThan(coord, vec3(0.0))) && all(lessThan(coord, vec3(1.0))))
+			return texture(shadowMaps, vec4(coord.xy, float(cascade), coord.z));
+	}
+	return 1.0;
+}
+#endif
+
+// everything that lights a surface with this (normalized) world normal at this world position
+vec3 sceneLighting(vec3 normal, vec3 position)
+{
+	vec3 light = vec3(AMBIENT);
+#ifdef CLUSTERED_LIGHTS
+	light += clusteredLighting(normal, position);
+#endif
+#ifdef SHADOWS
+	light += sunColor.rgb * max(dot(normal, -sunDirection.xyz), 0.0) * sunShadow(normal, position);
+#endif
+	return light;
+}
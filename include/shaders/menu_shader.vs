@@ -3,11 +3,13 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 
 uniform mat4 projection;
+// the quad's dequantize matrix, its positions are quantized to its bounds
+uniform mat4 model;
 
 out vec2 TexCoord;
 
 void main()
 {
-    gl_Position = projection * vec4(aPos, 1.0);
+    gl_Position = projection * model * vec4(aPos, 1.0);
     TexCoord = aTexCoord;
 }
\ No newline at end of file
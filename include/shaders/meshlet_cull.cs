@@ -0,0 +1,74 @@
+#version 440 core
+// one invocation per meshlet per object, the same test as MeshletRenderer::isVisible. Culled meshlets keep their
+// command with an instance count of 0
+layout (local_size_x = 64) in;
+
+struct Meshlet
+{
+	vec4 sphere;       // center, radius
+	vec4 apexCutoff;   // cone apex, cutoff
+	vec4 axis;
+	uvec4 range;       // index count, first index, base vertex
+};
+
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets
+{
+	Meshlet meshlets[];
+};
+
+layout (std430, binding = 1) readonly buffer Objects
+{
+	mat4 models[];
+};
+
+layout (std430, binding = 2) writeonly buffer Commands
+{
+	DrawCommand commands[];
+};
+
+uniform vec4 planes[6];
+uniform vec3 cameraPosition;
+uniform uint meshletCount;
+uniform uint objectCount;
+
+bool isVisible(Meshlet meshlet, mat4 model)
+{
+	vec3 center = (model * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+	float radius = meshlet.sphere.w * length(model[0].xyz);
+	for(int i = 0; i < 6; i++)
+		if(dot(planes[i].xyz, center) + planes[i].w < -radius)
+			return false;
+
+	if(meshlet.apexCutoff.w >= 1.0)
+		return true;
+	vec3 apex = (model * vec4(meshlet.apexCutoff.xyz, 1.0)).xyz;
+	vec3 axis = normalize(mat3(model) * meshlet.axis.xyz);
+	vec3 toApex = apex - cameraPosition;
+	float distance = length(toApex);
+	return distance == 0.0 || dot(toApex / distance, axis) < meshlet.apexCutoff.w;
+}
+
+void main()
+{
+	uint id = gl_GlobalInvocationID.x;
+	if(id >= meshletCount * objectCount)
+		return;
+	Meshlet meshlet = meshlets[id % meshletCount];
+
+	DrawCommand command;
+	command.count = meshlet.range.x;
+	command.instanceCount = isVisible(meshlet, models[id / meshletCount]) ? 1u : 0u;
+	command.firstIndex = meshlet.range.y;
+	command.baseVertex = int(meshlet.range.z);
+	command.baseInstance = 0u;
+	commands[id] = command;
+}
\ No newline at end of file
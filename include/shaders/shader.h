@@ -2,6 +2,8 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <renderer/gl_state.h>
 
 #include <string>
 #include <fstream>
@@ -15,90 +17,137 @@ public:
     // the program ID
     unsigned int ID;
 
+    // an empty shader, ID is filled in later (see ShaderCompiler)
+    Shader() : ID(0)
+    {
+    }
+
     // constructor reads and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath)
     {
         // 1. retrive the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        // 2. compile shaders
+        build(readFile(vertexPath), readFile(fragmentPath));
+    }
+
+    // builds from source that is already in memory
+    static Shader fromSource(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        Shader shader;
+        shader.build(vertexCode, fragmentCode);
+        return shader;
+    }
+
+    // compiles and links synchronously, returns false (after printing the log) on failure
+    bool build(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        unsigned int vertex = compileStage(GL_VERTEX_SHADER, vertexCode);
+        checkCompileErrors(vertex, "VERTEX");
+        unsigned int fragment = compileStage(GL_FRAGMENT_SHADER, fragmentCode);
+        checkCompileErrors(fragment, "FRAGMENT");
+
+        ID = linkProgram(vertex, fragment);
+        bool linked = checkLinkErrors(ID);
+
+        // delete shaders; they're linked tinto our program so no longer necessary
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return linked;
+    }
+
+    // a compute program, synchronously like build()
+    bool buildCompute(const std::string &computeCode)
+    {
+        unsigned int compute = compileStage(GL_COMPUTE_SHADER, computeCode);
+        checkCompileErrors(compute, "COMPUTE");
+
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        bool linked = checkLinkErrors(ID);
+
+        glDeleteShader(compute);
+        return linked;
+    }
+
+    // reads a whole source file, printing an error and returning an empty string if it can't be read
+    static std::string readFile(const char* path)
+    {
+        std::ifstream file;
         //ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        file.exceptions (std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into stream
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close the file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            return stream.str();
         }
-        catch(std::ifstream::failure e)
+        catch(std::ifstream::failure &e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        int sucess;
-        char infoLog[512];
+        return std::string();
+    }
 
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        // print compile errors if any
-        glGetShaderiv(vertex, GL_COMPILE_STATUS, &sucess);
-        if(!sucess)
-        {
-            glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-            std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-        }
+    // the build steps are split up so they can be issued without waiting on the driver in between
+    static unsigned int compileStage(GLenum type, const std::string &code)
+    {
+        const char* source = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    static unsigned int linkProgram(unsigned int vertex, unsigned int fragment)
+    {
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+        return program;
+    }
 
-        // fragment shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        // print compile errors if any
-        glGetShaderiv(fragment, GL_COMPILE_STATUS, &sucess);
+    // print compile errors if any (this waits for the compile to finish)
+    static bool checkCompileErrors(unsigned int shader, const char* stage)
+    {
+        int sucess;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &sucess);
         if(!sucess)
         {
-            glGetShaderInfoLog(fragment, 512 , NULL, infoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
         }
+        return sucess != 0;
+    }
 
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        // print linking erros if any
-        glGetProgramiv(ID, GL_LINK_STATUS, &sucess);
+    // print linking erros if any (this waits for the link to finish)
+    static bool checkLinkErrors(unsigned int program)
+    {
+        int sucess;
+        char infoLog[512];
+        glGetProgramiv(program, GL_LINK_STATUS, &sucess);
         if(!sucess)
         {
-            glGetProgramInfoLog(ID, 512 , NULL, infoLog);
+            glGetProgramInfoLog(program, 512 , NULL, infoLog);
             std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
         }
-
-        // delete shaders; they're linked tinto our program so no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        return sucess != 0;
     }
+
     // use/active the shader
     void use()
     {
         glUseProgram(ID);
     }
+    // use/active the shader through the state cache, skipping the call if it is already bound
+    void use(GLStateCache &state) const
+    {
+        state.useProgram(ID);
+    }
     // utility uniform functions
     void setBool(const std::string &name, bool value) const 
     {
@@ -0,0 +1,283 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <shaders/shader.h>
+#include <renderer/gl_state.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// GL_KHR_parallel_shader_compile isn't in our glad build, so the bits we need are declared here and loaded by hand
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (*PFN_glMaxShaderCompilerThreadsKHR)(GLuint count);
+
+enum Shader_Status {
+    SHADER_PENDING,
+    SHADER_READY,
+    SHADER_FAILED
+};
+
+// a program that is still being built. Until it is ready current() hands back the fallback (which may be null, meaning "skip the draw")
+class AsyncShader
+{
+public:
+    Shader Program;
+    const Shader *Fallback;
+    // run on the GL thread once the program has linked, e.g. to set uniforms that never change
+    std::function<void(const Shader&)> OnReady;
+
+    AsyncShader() : Fallback(nullptr), status(SHADER_PENDING), vertex(0), fragment(0)
+    {
+    }
+
+    const Shader *current() const
+    {
+        return status == SHADER_READY ? &Program : Fallback;
+    }
+
+    bool isReady() const
+    {
+        return status == SHADER_READY;
+    }
+
+    Shader_Status getStatus() const
+    {
+        return status;
+    }
+
+private:
+    friend class ShaderCompiler;
+
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::atomic<Shader_Status> status;
+    // set by the worker thread once it has finished (only used without the parallel compile extension)
+    std::atomic<bool> workerDone{false};
+    bool workerLinked = false;
+    unsigned int vertex;
+    unsigned int fragment;
+};
+
+// builds shader programs without stalling the frame loop. With GL_KHR_parallel_shader_compile every program is kicked off
+// straight away and polled with GL_COMPLETION_STATUS_KHR; without it a worker thread with its own shared context does the
+// (blocking) compile and link. Either way poll() must be called on the GL thread once per frame
+class ShaderCompiler
+{
+public:
+    ShaderCompiler(GLFWwindow *window) : parallelCompile(false), workerWindow(nullptr), stopping(false)
+    {
+        if(glfwExtensionSupported("GL_KHR_parallel_shader_compile") || glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+        {
+            PFN_glMaxShaderCompilerThreadsKHR maxThreads = (PFN_glMaxShaderCompilerThreadsKHR)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if(!maxThreads)
+                maxThreads = (PFN_glMaxShaderCompilerThreadsKHR)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+            if(maxThreads)
+            {
+                // let the driver use as many threads as it likes
+                maxThreads(0xFFFFFFFF);
+                parallelCompile = true;
+                return;
+            }
+        }
+
+        // no extension: make an invisible window whose context shares objects with ours and compile on a thread that owns it
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        workerWindow = glfwCreateWindow(1, 1, "", NULL, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if(workerWindow == NULL)
+        {
+            std::cout << "ERROR::SHADER_COMPILER::SHARED_CONTEXT_FAILED, compiling on the main thread" << std::endl;
+            return;
+        }
+        worker = std::thread([this]() { workerLoop(); });
+    }
+
+    ~ShaderCompiler()
+    {
+        shutdown();
+    }
+
+    // stops the worker thread and destroys its window; call before glfwTerminate
+    void shutdown()
+    {
+        if(worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            worker.join();
+        }
+        if(workerWindow)
+        {
+            glfwDestroyWindow(workerWindow);
+            workerWindow = nullptr;
+        }
+    }
+
+    // starts building a program and returns straight away; the returned object stays valid as long as the compiler does
+    AsyncShader *request(const char* vertexPath, const char* fragmentPath, const Shader *fallback = nullptr, std::function<void(const Shader&)> onReady = nullptr)
+    {
+        return requestSource(Shader::readFile(vertexPath), Shader::readFile(fragmentPath), fallback, onReady);
+    }
+
+    // same as request() but from source that is already in memory
+    AsyncShader *requestSource(const std::string &vertexCode, const std::string &fragmentCode, const Shader *fallback = nullptr, std::function<void(const Shader&)> onReady = nullptr)
+    {
+        shaders.emplace_back(new AsyncShader());
+        AsyncShader *shader = shaders.back().get();
+        shader->Fallback = fallback;
+        shader->OnReady = onReady;
+        shader->vertexCode = vertexCode;
+        shader->fragmentCode = fragmentCode;
+
+        if(parallelCompile)
+        {
+            // issue everything without asking for status in between, the driver compiles in the background
+            shader->vertex = Shader::compileStage(GL_VERTEX_SHADER, shader->vertexCode);
+            shader->fragment = Shader::compileStage(GL_FRAGMENT_SHADER, shader->fragmentCode);
+            shader->Program.ID = Shader::linkProgram(shader->vertex, shader->fragment);
+        }
+        else if(worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(shader);
+            }
+            wake.notify_one();
+        }
+        else
+        {
+            shader->workerLinked = shader->Program.build(shader->vertexCode, shader->fragmentCode);
+            shader->workerDone = true;
+        }
+        pending.push_back(shader);
+        return shader;
+    }
+
+    // a program that was never built (its source couldn't be put together), current() is the fallback from the start
+    AsyncShader *failed(const Shader *fallback = nullptr)
+    {
+        shaders.emplace_back(new AsyncShader());
+        AsyncShader *shader = shaders.back().get();
+        shader->Fallback = fallback;
+        shader->status = SHADER_FAILED;
+        return shader;
+    }
+
+    // checks pending programs without blocking, finishing any that are done (OnReady binds through the state cache)
+    void poll(GLStateCache &state)
+    {
+        for(size_t i = 0; i < pending.size();)
+        {
+            AsyncShader *shader = pending[i];
+            if(!finish(shader, state))
+            {
+                i++;
+                continue;
+            }
+            pending[i] = pending.back();
+            pending.pop_back();
+        }
+    }
+
+    // number of programs still being built
+    size_t pendingCount() const
+    {
+        return pending.size();
+    }
+
+    bool usesParallelCompile() const
+    {
+        return parallelCompile;
+    }
+
+private:
+    bool parallelCompile;
+    GLFWwindow *workerWindow;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<AsyncShader*> jobs;
+    bool stopping;
+
+    std::vector<std::unique_ptr<AsyncShader>> shaders;
+    std::vector<AsyncShader*> pending;
+
+    // returns true once the shader has left the pending state
+    bool finish(AsyncShader *shader, GLStateCache &state)
+    {
+        bool linked;
+        if(parallelCompile)
+        {
+            int completed = 0;
+            glGetProgramiv(shader->Program.ID, GL_COMPLETION_STATUS_KHR, &completed);
+            if(!completed)
+                return false;
+            linked = Shader::checkLinkErrors(shader->Program.ID);
+            if(!linked)
+            {
+                Shader::checkCompileErrors(shader->vertex, "VERTEX");
+                Shader::checkCompileErrors(shader->fragment, "FRAGMENT");
+            }
+            glDeleteShader(shader->vertex);
+            glDeleteShader(shader->fragment);
+        }
+        else
+        {
+            if(!shader->workerDone)
+                return false;
+            linked = shader->workerLinked;
+        }
+
+        if(!linked)
+        {
+            shader->status = SHADER_FAILED;
+            return true;
+        }
+        if(shader->OnReady)
+        {
+            shader->Program.use(state);
+            shader->OnReady(shader->Program);
+        }
+        shader->status = SHADER_READY;
+        return true;
+    }
+
+    void workerLoop()
+    {
+        glfwMakeContextCurrent(workerWindow);
+        for(;;)
+        {
+            AsyncShader *shader;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if(stopping)
+                    break;
+                shader = jobs.front();
+                jobs.pop_front();
+            }
+
+            shader->workerLinked = shader->Program.build(shader->vertexCode, shader->fragmentCode);
+            // make sure the finished program is visible to the main context before we say it is done
+            glFinish();
+            shader->workerDone = true;
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+};
+#endif
@@ -0,0 +1,202 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <shaders/shader.h>
+#include <shaders/shader_compiler.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// one #define injected into a variant, value may be empty
+struct ShaderDefine
+{
+    std::string name;
+    std::string value;
+};
+
+typedef std::vector<ShaderDefine> ShaderDefines;
+
+// a fully expanded source file, ready to hand to the compiler
+struct ExpandedSource
+{
+    std::string code;
+    uint64_t hash;
+    bool ok;
+    // the files spliced in, indexed by the source string number of the #line directives (0 is the file itself), so
+    // "1(12)" in a driver error is line 12 of files[1]
+    std::vector<std::string> files;
+};
+
+// resolves #include "file" (relative to the including file, each file at most once) and injects #defines right after #version,
+// so optional features can be compiled out with #ifdef instead of branching or sampling at runtime. #line directives around
+// every include keep the driver's error line numbers pointing at the right file and line
+class ShaderPreprocessor
+{
+public:
+    static const int MAX_INCLUDE_DEPTH = 16;
+
+    static ExpandedSource expand(const std::string &path, const ShaderDefines &defines)
+    {
+        ExpandedSource result;
+        std::set<std::string> included;
+        std::string body;
+        std::string version;
+        result.ok = expandFile(path, body, version, included, result.files, 0);
+
+        // the defines are sorted so the same set in a different order expands (and hashes) the same
+        ShaderDefines sorted = defines;
+        std::sort(sorted.begin(), sorted.end(), [](const ShaderDefine &a, const ShaderDefine &b) { return a.name < b.name; });
+
+        std::string header = version.empty() ? std::string() : version + "\n";
+        for(const ShaderDefine &define : sorted)
+            header += "#define " + define.name + (define.value.empty() ? "" : " " + define.value) + "\n";
+
+        result.code = header + body;
+        result.hash = hash(result.code);
+        return result;
+    }
+
+    // 64 bit FNV-1a
+    static uint64_t hash(const std::string &text, uint64_t seed = 14695981039346656037ull)
+    {
+        uint64_t h = seed;
+        for(unsigned char c : text)
+        {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+private:
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // returns the directive name if the line is a preprocessor directive ("include", "version", ...), empty otherwise
+    static std::string directive(const std::string &line, size_t &end)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if(start == std::string::npos || line[start] != '#')
+            return std::string();
+        start = line.find_first_not_of(" \t", start + 1);
+        if(start == std::string::npos)
+            return std::string();
+        end = line.find_first_of(" \t\"<", start);
+        if(end == std::string::npos)
+            end = line.size();
+        return line.substr(start, end - start);
+    }
+
+    static bool expandFile(const std::string &path, std::string &out, std::string &version, std::set<std::string> &included, std::vector<std::string> &files, int depth)
+    {
+        if(depth > MAX_INCLUDE_DEPTH)
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+            return false;
+        }
+        if(!included.insert(path).second)
+            return true;
+
+        std::ifstream file(path);
+        if(!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+
+        const std::string source = std::to_string(files.size());
+        files.push_back(path);
+        out += "#line 1 " + source + "\n";
+
+        bool ok = true;
+        std::string line;
+        unsigned int lineNumber = 0;
+        while(std::getline(file, line))
+        {
+            lineNumber++;
+            size_t end = 0;
+            std::string name = directive(line, end);
+            if(name == "version")
+            {
+                // only the outermost #version survives, it has to stay the first line
+                if(depth == 0)
+                    version = line;
+                out += "#line " + std::to_string(lineNumber + 1) + " " + source + "\n";
+                continue;
+            }
+            if(name == "include")
+            {
+                size_t open = line.find_first_of("\"<", end);
+                size_t close = open == std::string::npos ? std::string::npos : line.find_first_of("\">", open + 1);
+                if(close == std::string::npos)
+                {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ": " << line << std::endl;
+                    ok = false;
+                    continue;
+                }
+                std::string target = directoryOf(path) + line.substr(open + 1, close - open - 1);
+                ok = expandFile(target, out, version, included, files, depth + 1) && ok;
+                // back to this file, on the line after the include
+                out += "#line " + std::to_string(lineNumber + 1) + " " + source + "\n";
+                continue;
+            }
+            out += line;
+            out += '\n';
+        }
+        return ok;
+    }
+};
+
+// generates specialized permutations of a vertex/fragment pair and hands out one program per distinct expanded source,
+// so two define sets that end up expanding to the same code share a program
+class ShaderVariants
+{
+public:
+    ShaderVariants(ShaderCompiler &compiler) : compiler(compiler)
+    {
+    }
+
+    // the fallback/onReady of the first request for a given permutation are the ones that stick. If either file fails to
+    // expand nothing is compiled, and the returned shader has already failed and hands out the fallback for good
+    AsyncShader *get(const std::string &vertexPath, const std::string &fragmentPath, const ShaderDefines &defines, const Shader *fallback = nullptr, std::function<void(const Shader&)> onReady = nullptr)
+    {
+        ExpandedSource vertex = ShaderPreprocessor::expand(vertexPath, defines);
+        ExpandedSource fragment = ShaderPreprocessor::expand(fragmentPath, defines);
+        // what went wrong was printed during the expansion; compiling the half expanded source would only bury it
+        if(!vertex.ok || !fragment.ok)
+        {
+            std::cout << "ERROR::SHADER::PREPROCESS_FAILED " << vertexPath << " " << fragmentPath << std::endl;
+            return compiler.failed(fallback);
+        }
+        uint64_t key = ShaderPreprocessor::hash(fragment.code, vertex.hash);
+
+        auto it = variants.find(key);
+        if(it != variants.end())
+            return it->second;
+
+        AsyncShader *shader = compiler.requestSource(vertex.code, fragment.code, fallback, onReady);
+        variants[key] = shader;
+        return shader;
+    }
+
+    size_t variantCount() const
+    {
+        return variants.size();
+    }
+
+private:
+    ShaderCompiler &compiler;
+    std::unordered_map<uint64_t, AsyncShader*> variants;
+};
+#endif
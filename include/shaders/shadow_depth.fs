@@ -0,0 +1,6 @@
+#version 440 core
+
+// depth only, the shadow framebuffer has no color attachments
+void main()
+{
+}
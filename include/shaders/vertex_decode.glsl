@@ -0,0 +1,23 @@
+// decoding helpers for the compact vertex formats in mesh/vertex_format.h. Quantized positions and texture coordinates
+// need nothing here, the vertex fetch normalizes them and the bounds are folded into the model matrix
+
+// inverse of VertexPacker::octEncode, e comes in already mapped to [-1, 1]
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+#ifdef OCT_NORMALS
+vec3 decodeNormal(vec2 n)
+{
+	return octDecode(n);
+}
+#else
+vec3 decodeNormal(vec3 n)
+{
+	return n;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// decouples simulation from frame rate: frame time is accumulated and the simulation runs in whole steps of 1/rate seconds.
+// whatever is left over becomes alpha(), used to interpolate between the last two simulated states when rendering
+class FixedTimestep
+{
+public:
+    // steps per second
+    float Rate;
+    // most steps run in one frame; after a long stall the remaining time is dropped instead of trying to catch up forever
+    unsigned int MaxStepsPerFrame;
+
+    FixedTimestep(float rate = 60.0f, unsigned int maxStepsPerFrame = 8) : Rate(rate), MaxStepsPerFrame(maxStepsPerFrame), accumulator(0.0f), totalSteps(0)
+    {
+    }
+
+    // adds the frame's time and returns how many steps to simulate this frame
+    unsigned int advance(float frameTime)
+    {
+        float step = stepSize();
+        accumulator += frameTime;
+        unsigned int steps = 0;
+        while(accumulator >= step && steps < MaxStepsPerFrame)
+        {
+            accumulator -= step;
+            steps++;
+        }
+        if(steps == MaxStepsPerFrame && accumulator >= step)
+            accumulator = 0.0f;
+        totalSteps += steps;
+        return steps;
+    }
+
+    float stepSize() const
+    {
+        return 1.0f / Rate;
+    }
+
+    // how far we are between the previous and the current simulated state, in [0, 1)
+    float alpha() const
+    {
+        return accumulator / stepSize();
+    }
+
+    // steps run since construction, handy as a deterministic clock
+    unsigned long long stepCount() const
+    {
+        return totalSteps;
+    }
+
+private:
+    float accumulator;
+    unsigned long long totalSteps;
+};
+#endif
@@ -0,0 +1,51 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// fixed size lock-free queue for exactly one producer thread and one consumer thread. Capacity must be a power of two
+template<typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0)
+    {
+    }
+
+    // producer side, returns false (and drops the item) when the ring is full
+    bool push(const T &item)
+    {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if(currentTail - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[currentTail & (Capacity - 1)] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, returns false when there is nothing to read
+    bool pop(T &item)
+    {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if(currentHead == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[currentHead & (Capacity - 1)];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T items[Capacity];
+    // kept on separate cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+#endif
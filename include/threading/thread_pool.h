@@ -0,0 +1,142 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads for CPU side jobs. Nothing submitted here may call GL, the context only lives on the render thread
+class ThreadPool
+{
+public:
+    // threadCount of 0 uses one worker per hardware thread, minus the calling thread
+    ThreadPool(unsigned int threadCount = 0) : stopping(false)
+    {
+        if(threadCount == 0)
+        {
+            unsigned int hardware = std::thread::hardware_concurrency();
+            threadCount = hardware > 1 ? hardware - 1 : 1;
+        }
+        for(unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    // number of threads that take part in parallelFor (the workers plus the caller)
+    unsigned int size() const
+    {
+        return (unsigned int)workers.size() + 1;
+    }
+
+    // queues a background job and returns straight away
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // splits [0, count) into batches of at least minBatch and runs fn(begin, end) on them across the pool.
+    // the calling thread helps out and the call returns once every batch is done. It only ever runs batches of this call,
+    // never other queued jobs, so a long background job (a BVH rebuild, say) can't end up stalling the caller
+    void parallelFor(size_t count, size_t minBatch, const std::function<void(size_t, size_t)> &fn)
+    {
+        if(count == 0)
+            return;
+        minBatch = std::max<size_t>(minBatch, 1);
+        size_t batches = std::min<size_t>(size(), (count + minBatch - 1) / minBatch);
+        if(batches <= 1)
+        {
+            fn(0, count);
+            return;
+        }
+
+        // batches are claimed from a shared counter by the caller and by one queued job per worker; a job that only gets
+        // to run after everything was claimed finds nothing left and returns without touching fn
+        std::shared_ptr<Batches> shared = std::make_shared<Batches>(count, (count + batches - 1) / batches, batches);
+        const std::function<void(size_t, size_t)> *body = &fn;
+        for(size_t helper = 1; helper < batches; helper++)
+            submit([shared, body]() { shared->run(*body); });
+
+        shared->run(fn);
+        std::unique_lock<std::mutex> lock(shared->doneMutex);
+        shared->done.wait(lock, [&]() { return shared->finished == shared->batchCount; });
+    }
+
+private:
+    // one parallelFor call's batches
+    struct Batches
+    {
+        size_t count;
+        size_t batchSize;
+        size_t batchCount;
+        std::atomic<size_t> next;
+        size_t finished;
+        std::mutex doneMutex;
+        std::condition_variable done;
+
+        Batches(size_t count, size_t batchSize, size_t batchCount) : count(count), batchSize(batchSize), batchCount(batchCount), next(0), finished(0)
+        {
+        }
+
+        // runs batches until none are left to claim
+        void run(const std::function<void(size_t, size_t)> &fn)
+        {
+            for(size_t batch = next++; batch < batchCount; batch = next++)
+            {
+                size_t begin = batch * batchSize;
+                size_t end = std::min(count, begin + batchSize);
+                if(begin < end)
+                    fn(begin, end);
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if(++finished == batchCount)
+                    done.notify_one();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void workerLoop()
+    {
+        for(;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if(stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+#endif
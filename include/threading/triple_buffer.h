@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// lock-free triple buffer between one producer and one consumer thread. The producer fills write() and publish()es it,
+// the consumer acquire()s the newest published value and reads it with read(). Neither side ever waits for the other;
+// if the producer publishes twice before the consumer looks, the older value is simply skipped
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : buffers(), back(0), front(1), middle(2)
+    {
+    }
+
+    // producer: the slot to fill, owned by the producer until publish()
+    T &write()
+    {
+        return buffers[back];
+    }
+
+    // producer: hands the filled slot over and takes the old middle one to write into next
+    void publish()
+    {
+        unsigned int previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    // consumer: swaps in the newest published value, returns false if nothing new arrived since the last call
+    bool acquire()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        unsigned int previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    // consumer: the value picked up by the last successful acquire(), owned by the consumer until the next one
+    T &read()
+    {
+        return buffers[front];
+    }
+
+private:
+    static const unsigned int INDEX_MASK = 3;
+    static const unsigned int FRESH = 4;
+
+    T buffers[3];
+    unsigned int back;
+    unsigned int front;
+    std::atomic<unsigned int> middle;
+};
+#endif
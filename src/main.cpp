@@ -6,43 +6,186 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <shaders/shader.h>
+#include <shaders/shader_compiler.h>
+#include <shaders/shader_preprocessor.h>
 #include <camera/camera.h>
+#include <renderer/gl_state.h>
+#include <renderer/render_queue.h>
+#include <renderer/late_latch.h>
+#include <renderer/impostor_renderer.h>
+#include <renderer/lod_selector.h>
+#include <renderer/object_id_buffer.h>
+#include <renderer/clustered_lights.h>
+#include <renderer/shadow_cascades.h>
+#include <threading/thread_pool.h>
+#include <profiler/profiler.h>
+#include <input/input.h>
+#include <input/input_recorder.h>
+#include <simulation/fixed_timestep.h>
+#include <math/transform_kernel.h>
+#include <scene/scene_graph.h>
+#include <scene/bvh.h>
+#include <scene/picking.h>
+#include <mesh/vertex_format.h>
+#include <mesh/mesh_importer.h>
+#include <mesh/meshlet_builder.h>
+#include <renderer/meshlet_renderer.h>
+#include <threading/triple_buffer.h>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
 
 #include <iostream>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void mouse_callback(GLFWwindow* window, double xpos, double yps);
+void handleCursor(double xpos, double ypos);
 void processInput(GLFWwindow *window);
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
-unsigned int createCube();
-unsigned int generateTexture(const  char* texturePath, Shader &ourShader);
-void renderMenu(Shader &menuShader, unsigned int VAO);
-unsigned int createMenuQuad();
-void renderCube(Shader &cubeShader, unsigned int VAO, glm::vec3 cubePositions[], bool isNegative);
-void renderButton(Shader &buttonShader, unsigned int VAO);
-unsigned int createButton();
-unsigned int createRectangle(float vertices[], unsigned int sizeOfVertices);
+void toggleMenu(GLFWwindow *window);
+struct SceneSnapshot;
+struct RenderResources;
+void latchCamera(SceneSnapshot &snapshot, double &frameInputTime);
+void publishSnapshot(glm::vec3 cubePositions[], float alpha);
+void renderLoop(GLFWwindow *window, RenderResources &resources);
+MeshBuffers createCube();
+void createLights();
+MeshBuffers loadMesh(const char *path, glm::mat4 &meshletFit);
+unsigned int generateTexture(const  char* texturePath);
+void renderMenu(const Shader &menuShader, const MeshBuffers &mesh);
+MeshBuffers createMenuQuad();
+unsigned int renderCube(const Shader &cubeShader, const MeshBuffers &mesh, unsigned int texture, SceneSnapshot &snapshot, bool useImpostors);
+DrawItem cubeDrawItem(const Shader &cubeShader, const MeshBuffers &mesh, unsigned int texture, SceneSnapshot &snapshot, unsigned int cube);
+void renderMeshlets(const Shader &cubeShader, unsigned int texture, const glm::mat4 &fit, SceneSnapshot &snapshot);
+unsigned int renderShadowCasters(const Shader &depthShader, const MeshBuffers &mesh, const glm::mat4 *meshletFit, SceneSnapshot &snapshot, unsigned int cascade, bool staticLayer);
+void simulate(float dt);
+void pickCube(GLFWwindow *window);
+void renderButton(const Shader &buttonShader, const MeshBuffers &mesh);
+MeshBuffers createButton();
+MeshBuffers createRectangle(float vertices[], unsigned int sizeOfVertices);
 struct Button;
 
+// what the bound keys and buttons mean, see the bindings in main()
+enum Input_Action {
+    ACTION_QUIT,
+    ACTION_FORWARD,
+    ACTION_BACKWARD,
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_TOGGLE_MENU,
+    ACTION_TOGGLE_LATE_LATCH,
+    ACTION_CLICK
+};
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
-
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+// simulation steps per second, and how fast the cubes turn (radians per second)
+const float SIMULATION_RATE = 60.0f;
+const float CUBE_ROTATION_SPEED = 0.6f;
+// imported meshes with at least this many triangles are split into meshlets and culled per meshlet
+const unsigned int MESHLET_MIN_TRIANGLES = 4096;
+// cubes whose bounding sphere covers fewer pixels across than this are drawn as impostors, up to IMPOSTOR_CAPACITY a frame
+const float IMPOSTOR_PIXELS = 48.0f;
+const unsigned int IMPOSTOR_CAPACITY = 4096;
+// cubes per partition when their draws are recorded across the thread pool, smaller ones cost more to hand off than they save
+const size_t RECORD_PARTITION_SIZE = 256;
+// point lights scattered through the scene, and the box they are scattered over
+const unsigned int LIGHT_COUNT = 2048;
+const glm::vec3 LIGHT_AREA_MIN(-8.0f, -6.0f, -18.0f);
+const glm::vec3 LIGHT_AREA_MAX(8.0f, 8.0f, 3.0f);
+// the sun, the one light that casts shadows: the way it shines and its color
+const glm::vec3 SUN_DIRECTION(-0.4f, -1.0f, -0.3f);
+const glm::vec3 SUN_COLOR(0.6f, 0.58f, 0.52f);
+// the cube in model space, for its world box and for picking
+const Aabb CUBE_BOUNDS(glm::vec3(-0.5f), glm::vec3(0.5f));
+
+// main thread: window events, input and simulation
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+InputSystem input;
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 float delaTime = 0.0f;
 float lastFrame = 0.0f;
 bool firstMouse = true;
 bool hasOpenedMenu = false;
-bool menuKeyPressed = false;
 bool isPaused = false;
+// cube rotations after the last simulation step and the one before it, rendering interpolates between the two
 float cubeRotations[10] = {0.0f};
+float previousCubeRotations[10] = {0.0f};
+// the cubes hang off one root node, their world matrices come out of the graph
+SceneGraph scene;
+uint32_t sceneRoot = 0;
+uint32_t cubeNodes[10];
+// world space boxes of the cubes and a tree over them for spatial queries, refitted whenever the cubes move
+std::vector<Aabb> cubeBoxes(10);
+glm::mat4 cubeModels[10];
+AsyncBvh cubeBvh;
+// clicking a cube stops or restarts its spin
+bool cubeFrozen[10] = {false};
+// where the cursor is, in window coordinates (only meaningful while the menu shows it)
+glm::vec2 cursorPosition(0.0f);
+FixedTimestep simulationClock(SIMULATION_RATE);
 std::vector<Button> buttonPositions;
 bool inButton = false;
-bool buttonPressed = false;
 bool isNegative = false;
+// overwrite the view with the freshest cursor sample right before drawing (toggle with L)
+bool lateLatching = true;
+// glfwGetTime() of the newest input that fed into this frame's view, negative if there was none
+double inputTimestamp = -1.0;
+// --record <file> writes every frame's input out, --replay <file> feeds a recording back instead of live input.
+// both run the main loop at a fixed dt, one simulation step per frame, so a replay reproduces the recorded frames exactly
+InputRecorder inputRecorder;
+InputReplay inputReplay;
+bool replaying = false;
+uint32_t inputFrame = 0;
+
+// render thread: everything that talks to GL
+GLStateCache glState;
+RenderQueue renderQueue;
+CameraUniformRing cameraUniforms;
+// created in main(), so no threads start during static initialization
+ThreadPool *threadPool = nullptr;
+Profiler profiler;
+MeshletRenderer meshletRenderer;
+// level of detail per cube for meshes that have them, a level is dropped to once its error stays under a pixel
+LodSelector lodSelector;
+ImpostorRenderer impostors;
+// what recording a partition of the cubes found besides its draws, see renderCube()
+struct CubePartition
+{
+    unsigned int triangles;
+    // the cubes small enough for an impostor, handed to the impostors once every partition is done
+    std::vector<unsigned int> impostors;
+};
+std::vector<CubePartition> cubePartitions;
+// the scene is drawn through here when picking goes through the GPU
+ObjectIdBuffer objectIds;
+ClusteredLights clusteredLights;
+ShadowCascades shadowCascades;
+// where the meshlets are culled, --gpu-cull moves it to a compute shader
+Meshlet_Cull_Mode meshletCullMode = MESHLET_CULL_CPU;
+
+// shared between the two
+std::atomic<bool> renderRunning(false);
+// width in the high 32 bits, height in the low ones, so both change together
+std::atomic<uint64_t> framebufferSize(((uint64_t)SCR_WIDTH << 32) | SCR_HEIGHT);
+std::mutex titleMutex;
+std::string pendingTitle;
+// frameIndex of the last snapshot the render thread put on screen
+std::atomic<unsigned long long> presentedFrame(0);
+// --id-buffer picks by reading the object id under the cursor back from the GPU instead of ray casting; clicks go to the
+// render thread as framebuffer pixels and the ids come back a frame or two later (0 for no cube, else the cube index + 1).
+// That delay depends on the GPU, so --record and --replay turn it off
+bool objectIdPicking = false;
+std::mutex pickMutex;
+std::vector<glm::ivec2> pickRequests;
+std::vector<uint32_t> pickedIds;
 
 
 struct Button
@@ -53,8 +196,95 @@ struct Button
     glm::vec2 bottomRight;
 };
 
-int main()
+// everything the render thread needs for one frame. Written by the main thread, never touched by it again once published
+struct SceneSnapshot
+{
+    unsigned long long frameIndex;
+    Camera camera;
+    glm::mat4 cubeModels[10];
+    // cubes whose world matrix is the same as in the snapshot before; they go into the cached static shadow layers
+    bool cubeStatic[10];
+    bool menuOpen;
+    // for late latching: whether the view may be latched (enabled and the mouse is steering the camera), and the cursor
+    // position the camera already includes
+    bool latchCursor;
+    float lastX;
+    float lastY;
+    double inputTimestamp;
+};
+
+// GL objects created at startup and used by the render thread
+struct RenderResources
 {
+    ShaderCompiler *shaderCompiler;
+    AsyncShader *cubeShader;
+    AsyncShader *menuShader;
+    AsyncShader *buttonShader;
+    // null when the impostors couldn't be baked
+    AsyncShader *impostorShader;
+    // null when there are no shadow maps
+    const Shader *shadowShader;
+    MeshBuffers cube;
+    // a large imported mesh is drawn through meshletRenderer instead, fit takes its mesh space into the unit cube
+    bool meshlets;
+    glm::mat4 meshletFit;
+    unsigned int cubeTexture;
+    MeshBuffers menu;
+    MeshBuffers button;
+};
+
+TripleBuffer<SceneSnapshot> snapshots;
+
+uint64_t packSize(int width, int height)
+{
+    return ((uint64_t)width << 32) | (uint32_t)height;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    // --mesh <file.obj|.gltf|.glb> draws an imported mesh in place of the cubes
+    const char *meshPath = nullptr;
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], "--gpu-cull") == 0)
+            meshletCullMode = MESHLET_CULL_GPU;
+        else if(std::strcmp(argv[i], "--id-buffer") == 0)
+            objectIdPicking = true;
+        else if(i + 1 == argc)
+            break;
+        else if(std::strcmp(argv[i], "--record") == 0)
+            recordPath = argv[++i];
+        else if(std::strcmp(argv[i], "--replay") == 0)
+            replayPath = argv[++i];
+        else if(std::strcmp(argv[i], "--mesh") == 0)
+            meshPath = argv[++i];
+    }
+    // the workers for CPU side jobs (mesh import, BVH rebuilds, light binning, recording draws); whatever they were
+    // given is finished before the pool goes away with main()
+    ThreadPool pool;
+    threadPool = &pool;
+    if(replayPath)
+    {
+        if(!inputReplay.load(replayPath))
+            return -1;
+        replaying = true;
+        // the recording decides the step, so it plays back the same however this build was configured
+        simulationClock.Rate = 1.0f / inputReplay.stepSize();
+    }
+    else if(recordPath && !inputRecorder.open(recordPath, simulationClock.stepSize()))
+    {
+        return -1;
+    }
+    // id buffer picks come back whenever the GPU is done with them, so the frame a click freezes a cube on isn't in the
+    // recording; recording and replaying ray cast, which acts on the click's own frame
+    if(objectIdPicking && (replaying || inputRecorder.isOpen()))
+    {
+        std::cout << "--id-buffer: picking by ray casting while recording or replaying" << std::endl;
+        objectIdPicking = false;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -80,8 +310,17 @@ int main()
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+
+    // keys, buttons, cursor and scroll all arrive as events through the input system
+    input.attach(window);
+    input.bindKey(ACTION_QUIT, GLFW_KEY_ESCAPE);
+    input.bindKey(ACTION_FORWARD, GLFW_KEY_W);
+    input.bindKey(ACTION_BACKWARD, GLFW_KEY_S);
+    input.bindKey(ACTION_LEFT, GLFW_KEY_A);
+    input.bindKey(ACTION_RIGHT, GLFW_KEY_D);
+    input.bindKey(ACTION_TOGGLE_MENU, GLFW_KEY_M);
+    input.bindKey(ACTION_TOGGLE_LATE_LATCH, GLFW_KEY_L);
+    input.bindMouseButton(ACTION_CLICK, GLFW_MOUSE_BUTTON_LEFT);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -91,12 +330,63 @@ int main()
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable( GL_BLEND );
+    camera.SetPerspective((float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
+
+    glState.enable(GL_DEPTH_TEST);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.enable(GL_BLEND);
+    cameraUniforms.create(glState);
+    if(objectIdPicking && !objectIds.create(glState, SCR_WIDTH, SCR_HEIGHT))
+        objectIdPicking = false;
+    createLights();
+    bool shadows = shadowCascades.create(glState, SUN_DIRECTION, SUN_COLOR);
     // build and compile our shader zprogram
     // ------------------------------------
-    Shader cubeShader("../include/shaders/cube_shader.vs", "../include/shaders/cube_shader.fs");
+    // every program is kicked off up front and built in the background; until the cube shader is ready the cubes
+    // are drawn flat with the fallback, and the overlay is skipped
+    ShaderCompiler shaderCompiler(window);
+    ShaderVariants shaderVariants(shaderCompiler);
+    Shader fallbackShader;
+    glm::mat4 meshletFit(1.0f);
+    MeshBuffers cubeMesh = meshPath ? loadMesh(meshPath, meshletFit) : createCube();
+    // only the container texture is loaded, so the single texture variant is used (define USE_TEXTURE2 for the two texture mix)
+    ShaderDefines cubeDefines;
+    if(cubeMesh.format.octahedralNormals())
+        cubeDefines.push_back({ "OCT_NORMALS", "" });
+    if(objectIdPicking)
+        cubeDefines.push_back({ "OBJECT_ID", "" });
+    // the cubes on screen are lit by the clustered lights, and so are the impostors standing in for them; the fallback
+    // stays unlit
+    ShaderDefines lightingDefines;
+    lightingDefines.push_back({ "CLUSTERED_LIGHTS", "" });
+    if(shadows)
+        lightingDefines.push_back({ "SHADOWS", "" });
+    ShaderDefines litDefines = cubeDefines;
+    litDefines.insert(litDefines.end(), lightingDefines.begin(), lightingDefines.end());
+    AsyncShader *cubeShader = shaderVariants.get("../include/shaders/cube_shader.vs", "../include/shaders/cube_shader.fs", litDefines, &fallbackShader,
+        [](const Shader &shader) { shader.setInt("texture1", 0); });
+
+    // set up an orthographic projection for 2d rendering, it never changes so only upload it once
+    glm::mat4 overlayProjection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.f, static_cast<float>(SCR_HEIGHT));
+    AsyncShader *menuShader = shaderCompiler.request("../include/shaders/menu_shader.vs", "../include/shaders/menu_shader.fs", nullptr,
+        [overlayProjection](const Shader &shader)
+        {
+            shader.setVec3("color", glm::vec3(0.663, 0.8f, 0.95f));
+            shader.setMat4("projection", overlayProjection);
+        });
+    AsyncShader *buttonShader = shaderCompiler.request("../include/shaders/menu_shader.vs", "../include/shaders/menu_shader.fs", nullptr,
+        [overlayProjection](const Shader &shader)
+        {
+            shader.setVec3("color", glm::vec3(0.0, 0.0, 0.0));
+            shader.setMat4("projection", overlayProjection);
+        });
+
+    // the fallback is tiny, build it synchronously while the others compile
+    fallbackShader.build(ShaderPreprocessor::expand("../include/shaders/cube_shader.vs", cubeDefines).code, Shader::readFile("../include/shaders/fallback_shader.fs"));
+    // and so is the shadow depth pass, which every frame needs from the start
+    Shader shadowShader;
+    if(shadows)
+        shadows = shadowShader.build(Shader::readFile("../include/shaders/shadow_depth.vs"), Shader::readFile("../include/shaders/shadow_depth.fs"));
 
     glm::vec3 cubePositions[] = {
         glm::vec3(0.0f, 0.0f, 0.0f),
@@ -110,85 +400,354 @@ int main()
         glm::vec3(1.5f, 0.2f, -1.5f),
         glm::vec3(-1.3f, 1.0f, -1.5f)
     };
+    sceneRoot = scene.create();
+    for(unsigned int i = 0; i < 10; i++)
+        cubeNodes[i] = scene.create(sceneRoot);
+
+    RenderResources resources;
+    resources.shaderCompiler = &shaderCompiler;
+    resources.cubeShader = cubeShader;
+    resources.menuShader = menuShader;
+    resources.buttonShader = buttonShader;
+    resources.cube = cubeMesh;
+    resources.meshlets = meshletRenderer.meshletCount() > 0;
+    resources.meshletFit = meshletFit;
+    resources.shadowShader = shadows ? &shadowShader : nullptr;
+    resources.cubeTexture = generateTexture("../images/container.jpg");
+    resources.menu = createMenuQuad();
+    resources.button = createButton();
+
+    // the impostor views are baked once, with the cube program built right here since the async one isn't ready yet.
+    // The bake writes unlit colors plus normals instead of object ids, impostor.fs lights them
+    resources.impostorShader = nullptr;
+    ShaderDefines bakeDefines;
+    if(cubeMesh.format.octahedralNormals())
+        bakeDefines.push_back({ "OCT_NORMALS", "" });
+    bakeDefines.push_back({ "IMPOSTOR_BAKE", "" });
+    ExpandedSource bakeVertex = ShaderPreprocessor::expand("../include/shaders/cube_shader.vs", bakeDefines);
+    ExpandedSource bakeFragment = ShaderPreprocessor::expand("../include/shaders/cube_shader.fs", bakeDefines);
+    Shader impostorBakeShader;
+    if(bakeVertex.ok && bakeFragment.ok && impostorBakeShader.build(bakeVertex.code, bakeFragment.code))
+    {
+        impostors.create(glState, IMPOSTOR_CAPACITY);
+        impostors.bake(glState, impostorBakeShader, cubeMesh, resources.cubeTexture, 0.87f);
+        resources.impostorShader = shaderVariants.get("../include/shaders/impostor.vs", "../include/shaders/impostor.fs", lightingDefines, nullptr,
+            [](const Shader &shader) { impostors.setUniforms(shader); });
+    }
+    glDeleteProgram(impostorBakeShader.ID);
 
-    unsigned int cubeVAO = createCube();
-    unsigned int texture1 = generateTexture("../images/container.jpg", cubeShader);
-
-    Shader menuShader("../include/shaders/menu_shader.vs", "../include/shaders/menu_shader.fs");
-    unsigned int menuVAO = createMenuQuad();
-    menuShader.use();
-    menuShader.setVec3("color", glm::vec3(0.663, 0.8f, 0.95f));
-    
-    Shader buttonShader("../include/shaders/menu_shader.vs", "../include/shaders/menu_shader.fs");
-    unsigned int buttonVAO = createButton();
-    buttonShader.use();
-    buttonShader.setVec3("color", glm::vec3(0.0, 0.0, 0.0));
-    
+    // the GL context moves to the render thread, this thread keeps the window events and the simulation
+    glfwMakeContextCurrent(NULL);
+    renderRunning = true;
+    std::thread renderThread(renderLoop, window, std::ref(resources));
 
+    // recording and replaying step the same fixed dt every frame
+    bool fixedStep = replaying || inputRecorder.isOpen();
+    double replayStart = glfwGetTime();
 
-    // render loop
-    // -----------
+    // main loop
+    // ---------
     while (!glfwWindowShouldClose(window))
     {
+        if(replaying)
+        {
+            // as fast as the render thread goes, but without skipping any simulated frame on screen
+            while(renderRunning && presentedFrame.load() < inputFrame)
+                std::this_thread::yield();
+            glfwPollEvents();
+        }
+        else if(fixedStep)
+        {
+            // recording: still paced by the wall clock so the session feels normal
+            double nextTick = replayStart + (inputFrame + 1) * static_cast<double>(simulationClock.stepSize());
+            for(double now = glfwGetTime(); now < nextTick; now = glfwGetTime())
+                glfwWaitEventsTimeout(nextTick - now);
+        }
+        else
+        {
+            // sleep until something happens, but wake up at least every millisecond to keep the simulation going
+            glfwWaitEventsTimeout(0.001);
+        }
+
         float currentFrame = static_cast<float>(glfwGetTime());
-        delaTime = currentFrame - lastFrame;
+        delaTime = fixedStep ? simulationClock.stepSize() : currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        if(replaying && inputReplay.finished(inputFrame))
+        {
+            double seconds = glfwGetTime() - replayStart;
+            std::cout << "replay: " << inputFrame << " frames in " << seconds << " s, " << seconds * 1000.0 / std::max(inputFrame, 1u) << " ms per frame" << std::endl;
+            break;
+        }
+
         // input
         // -----
         processInput(window);
 
+        // simulation
+        // ----------
+        // runs in fixed steps however fast we loop, so animation speed and results don't depend on frame rate
+        unsigned int steps = simulationClock.advance(delaTime);
+        for(unsigned int step = 0; step < steps; step++)
+            simulate(simulationClock.stepSize());
+
+        // hand the render thread a new snapshot of the scene
+        publishSnapshot(cubePositions, simulationClock.alpha());
+        inputFrame++;
+
+        // the title can only be set from this thread
+        {
+            std::lock_guard<std::mutex> lock(titleMutex);
+            if(!pendingTitle.empty())
+            {
+                glfwSetWindowTitle(window, pendingTitle.c_str());
+                pendingTitle.clear();
+            }
+        }
+    }
+
+    renderRunning = false;
+    renderThread.join();
+    inputRecorder.close(inputFrame);
+
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // -----------------------------------------------------------------
+    shaderCompiler.shutdown();
+    glfwTerminate();
+    return 0;
+}
+
+// copies everything the render thread needs into the next snapshot and publishes it
+void publishSnapshot(glm::vec3 cubePositions[], float alpha)
+{
+    SceneSnapshot &snapshot = snapshots.write();
+    snapshot.frameIndex++;
+
+    // build the cached matrices here, so the copy the render thread gets is ready to use
+    camera.GetVersion();
+    snapshot.camera = camera;
+    // all the rotations in one batch; the graph only recomputes the cubes whose transform actually changed
+    float rotations[10], axisX[10], axisY[10], axisZ[10];
+    float qx[10], qy[10], qz[10], qw[10];
+    for(unsigned int i = 0 ; i < 10; i++)
+    {
+        rotations[i] = glm::mix(previousCubeRotations[i], cubeRotations[i], alpha);
+        axisX[i] = 1.0f;
+        axisY[i] = 0.3f;
+        axisZ[i] = 0.5f;
+    }
+    TransformKernel::axisAngleToQuaternions(rotations, Vec3Arrays{ axisX, axisY, axisZ }, qx, qy, qz, qw, 10);
+    for(unsigned int i = 0 ; i < 10; i++)
+        scene.setLocal(cubeNodes[i], cubePositions[i], glm::quat(qw[i], qx[i], qy[i], qz[i]), glm::vec3(1.0f));
+    scene.update();
+    for(unsigned int i = 0 ; i < 10; i++)
+    {
+        // static only while the whole world matrix stays put; whatever moves a cube (its rotation, its position, a
+        // parent) takes it out of the cached shadow layer
+        glm::mat4 world = scene.world(cubeNodes[i]);
+        snapshot.cubeStatic[i] = world == cubeModels[i];
+        cubeModels[i] = world;
+        snapshot.cubeModels[i] = world;
+        cubeBoxes[i] = Aabb::transformed(cubeModels[i], CUBE_BOUNDS);
+    }
+    // the pool is the render thread's, but its jobs don't touch GL and rebuilds are rare
+    if(scene.updatedCount() > 0 || cubeBvh.current().objectCount() == 0)
+        cubeBvh.update(cubeBoxes, *threadPool);
+    snapshot.menuOpen = hasOpenedMenu;
+    // a replay has to show exactly what was simulated, the live cursor has no business there
+    snapshot.latchCursor = lateLatching && !replaying && !hasOpenedMenu && !firstMouse;
+    snapshot.lastX = lastX;
+    snapshot.lastY = lastY;
+    snapshot.inputTimestamp = inputTimestamp;
+    inputTimestamp = -1.0;
+
+    // publishing swaps buffers, so carry the frame counter over to the one we'll write next
+    unsigned long long frameIndex = snapshot.frameIndex;
+    snapshots.publish();
+    snapshots.write().frameIndex = frameIndex;
+}
+
+// render thread: owns the GL context, draws the newest scene snapshot as fast as the swap allows
+void renderLoop(GLFWwindow *window, RenderResources &resources)
+{
+    glfwMakeContextCurrent(window);
+
+    unsigned long long renderedFrame = 0;
+    // which cubes were in the static shadow layers, one bit each
+    unsigned int shadowStaticMask = ~0u;
+    uint64_t appliedFramebufferSize = packSize(SCR_WIDTH, SCR_HEIGHT);
+    float lastRenderTime = static_cast<float>(glfwGetTime());
+    while(renderRunning)
+    {
+        float now = static_cast<float>(glfwGetTime());
+        float frameTime = now - lastRenderTime;
+        lastRenderTime = now;
+
+        snapshots.acquire();
+        SceneSnapshot &snapshot = snapshots.read();
+        // nothing published yet
+        if(snapshot.frameIndex == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // the input behind a snapshot only counts towards latency the first time it is shown
+        double frameInputTime = snapshot.frameIndex != renderedFrame ? snapshot.inputTimestamp : -1.0;
+        renderedFrame = snapshot.frameIndex;
+
+        // the resize callback runs on the main thread, the viewport is applied here
+        uint64_t size = framebufferSize.load();
+        if(size != appliedFramebufferSize)
+        {
+            glViewport(0, 0, static_cast<int>(size >> 32), static_cast<int>(size & 0xFFFFFFFF));
+            if(objectIdPicking)
+                objectIds.resize(static_cast<int>(size >> 32), static_cast<int>(size & 0xFFFFFFFF));
+            appliedFramebufferSize = size;
+        }
+
+        // pick up any programs that finished compiling since last frame, and any ids read back since
+        resources.shaderCompiler->poll(glState);
+        if(objectIdPicking)
+            objectIds.poll(glState);
+
+        // shadows first, they leave the window bound again
+        if(resources.shadowShader)
+        {
+            unsigned int staticMask = 0;
+            for(unsigned int i = 0; i < 10; i++)
+                staticMask |= snapshot.cubeStatic[i] ? 1u << i : 0u;
+            if(staticMask != shadowStaticMask)
+            {
+                shadowCascades.invalidateStatic();
+                shadowStaticMask = staticMask;
+            }
+            shadowCascades.update(glState, snapshot.camera, *resources.shadowShader, static_cast<int>(appliedFramebufferSize >> 32), static_cast<int>(appliedFramebufferSize & 0xFFFFFFFF),
+                [&](unsigned int cascade, bool staticLayer)
+                {
+                    return renderShadowCasters(*resources.shadowShader, resources.cube, resources.meshlets ? &resources.meshletFit : nullptr, snapshot, cascade, staticLayer);
+                });
+        }
+
         // render
         // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // also clear the depth buffer now!
-
-        // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
+        const float clearColor[4] = { 0.2f, 0.3f, 0.3f, 1.0f };
+        if(objectIdPicking)
+            objectIds.begin(glState, clearColor);
+        else
+        {
+            glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // also clear the depth buffer now!
+        }
 
         // activate shader
-        cubeShader.use();
+        const Shader &cubeProgram = *resources.cubeShader->current();
+        cubeProgram.use(glState);
 
-        // pass projection to shader(note that in this case it could change every frame)
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        cubeShader.setMat4("projection", projection);
+        // pass projection and view to the shader through this frame's slot of the camera uniform ring
+        // (the camera caches both, this is just a copy)
+        cameraUniforms.beginFrame();
+        cameraUniforms.write(snapshot.camera.GetViewMatrix(), snapshot.camera.GetProjectionMatrix(), glState);
 
-        // cameera/view transformation
-        glm::mat4 view = camera.GetViewMatrix();
-        cubeShader.setMat4("view", view);
+        // queue up this frame's draws, then sort and submit them in one go
+        renderQueue.clear();
 
         // render box
-        glBindVertexArray(cubeVAO);
-        
-        renderCube(cubeShader, cubeVAO, cubePositions, isNegative);
-
-        if(hasOpenedMenu)
+        unsigned int triangles = 0;
+        lodSelector.setView(snapshot.camera.GetProjectionMatrix(), static_cast<float>(appliedFramebufferSize & 0xFFFFFFFF));
+        bool useImpostors = resources.impostorShader && resources.impostorShader->isReady();
+        if(useImpostors)
+            impostors.begin();
+        if(!resources.meshlets)
+            triangles = renderCube(cubeProgram, resources.cube, resources.cubeTexture, snapshot, useImpostors);
+
+        if(snapshot.menuOpen && resources.menuShader->isReady() && resources.buttonShader->isReady())
         {
-            menuShader.use();
-            renderMenu(menuShader, menuVAO);
+            renderMenu(resources.menuShader->Program, resources.menu);
+            renderButton(resources.buttonShader->Program, resources.button);
+        }
 
-            buttonShader.use();
-            renderButton(buttonShader, buttonVAO);
+        // everything up to here used the cursor as of the snapshot, grab a fresher one for the draws
+        latchCamera(snapshot, frameInputTime);
+
+        // bin the lights against the view the draws will actually use
+        clusteredLights.update(glState, cameraUniforms.currentView(), snapshot.camera.GetProjectionMatrix(), snapshot.camera.NearPlane, snapshot.camera.FarPlane,
+            static_cast<int>(appliedFramebufferSize >> 32), static_cast<int>(appliedFramebufferSize & 0xFFFFFFFF), threadPool);
+
+        // the meshlets go straight to GL ahead of the queue, which still draws the overlay on top. Neither they nor the
+        // impostors write object ids
+        if(objectIdPicking)
+            glState.setColorWrites(1, false);
+        if(resources.meshlets)
+            renderMeshlets(cubeProgram, resources.cubeTexture, resources.meshletFit, snapshot);
+        // and so do the impostors, all in one instanced draw
+        if(useImpostors)
+        {
+            glState.enable(GL_DEPTH_TEST);
+            impostors.draw(glState, resources.impostorShader->Program);
         }
 
-        //renderButton(buttonShader, buttonVAO);
+        renderQueue.flush(glState, threadPool);
+        cameraUniforms.endFrame();
+
+        if(objectIdPicking)
+        {
+            std::vector<glm::ivec2> requests;
+            {
+                std::lock_guard<std::mutex> lock(pickMutex);
+                requests.swap(pickRequests);
+            }
+            for(const glm::ivec2 &pixel : requests)
+            {
+                objectIds.read(glState, pixel.x, pixel.y, [](uint32_t id)
+                {
+                    std::lock_guard<std::mutex> lock(pickMutex);
+                    pickedIds.push_back(id);
+                });
+            }
+            objectIds.present(glState);
+        }
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
+        // glfw: swap buffers
+        // ------------------
         glfwSwapBuffers(window);
         glFinish();
-        glfwPollEvents();
+        presentedFrame = renderedFrame;
+
+        // input to swap latency, measured once the GPU has finished the frame
+        if(frameInputTime >= 0.0)
+            profiler.setCounter("input_latency_ms", (glfwGetTime() - frameInputTime) * 1000.0);
+
+        // report how many state changes actually reached the driver
+        profiler.setCounter("gl_issued", glState.issuedCalls());
+        profiler.setCounter("gl_skipped", glState.skippedCalls());
+        profiler.setCounter("draws", renderQueue.size());
+        if(!resources.cube.lods.empty())
+            profiler.setCounter("triangles", triangles);
+        if(useImpostors)
+            profiler.setCounter("impostors", impostors.count());
+        profiler.setCounter("light_indices", clusteredLights.assignedCount());
+        profiler.setCounter("cluster_lights_max", clusteredLights.busiestCluster());
+        if(resources.shadowShader)
+        {
+            profiler.setCounter("shadow_static_redraws", shadowCascades.staticRedrawCount());
+            profiler.setCounter("shadow_casters", shadowCascades.movingCasterCount());
+        }
+        if(resources.meshlets && meshletCullMode == MESHLET_CULL_CPU)
+            profiler.setCounter("meshlets", meshletRenderer.visibleMeshlets());
+        glState.resetFrameCounters();
+        if(profiler.endFrame(frameTime))
+        {
+            std::lock_guard<std::mutex> lock(titleMutex);
+            pendingTitle = "LearnOpenGL | " + profiler.GetReport();
+        }
     }
 
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // -----------------------------------------------------------------
-    glfwTerminate();
-    return 0;
+    glfwMakeContextCurrent(NULL);
 }
 
 
-void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+// cursor moves look around, or hover the buttons while the menu is open
+void handleCursor(double xposIn, double yposIn)
 {
     float xPos = static_cast<float>(xposIn);
     float yPos = static_cast<float>(yposIn);
@@ -199,6 +758,7 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     // Handle menu state
     if(hasOpenedMenu)
     {
+        inButton = false;
         for(const Button& button : buttonPositions)
         {
             if((xPos > button.topLeft.x && xPos < button.topRight.x) && (yPos > button.bottomLeft.y && yPos < button.topLeft.y))
@@ -240,71 +800,196 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // the context lives on the render thread, which applies the new size at the start of its next frame
+    framebufferSize = packSize(width, height);
+    if(height > 0)
+        camera.SetAspectRatio(static_cast<float>(width) / static_cast<float>(height));
 }
 
-void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+// overlay draws are translucent, the depth field is used as the layer so the menu lands behind the button. They are
+// no object (id 0), so clicks on them never pick a cube
+void renderMenu(const Shader &menuShader, const MeshBuffers &mesh)
 {
-    camera.ProcessMouseScroll(static_cast<float>(yoffset));
-}
-
-void renderMenu(Shader &menuShader, unsigned int VAO)
-{
-    glDisable(GL_DEPTH_TEST);
-    // set up an orthographic projection for 2d rendering
-    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.f, static_cast<float>(SCR_HEIGHT));
-    menuShader.use();
-    menuShader.setMat4("projection", projection);
-
-    // Draw the quad
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
-
-    glEnable(GL_DEPTH_TEST);
-
+    DrawItem item = { SortKey::make(PASS_OVERLAY, true, menuShader.ID, 0, 0, 1.0f, 0.0f, 1.0f), menuShader.ID, mesh.vertexArray, 0, GL_TRIANGLES, 0, mesh.drawCount(), mesh.dequantize, mesh.indexType, 0 };
+    renderQueue.submit(item);
 }
 
-void renderButton(Shader &buttonShader, unsigned int VAO)
+void renderButton(const Shader &buttonShader, const MeshBuffers &mesh)
 {
-    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.f, static_cast<float>(SCR_HEIGHT));
-    buttonShader.use();
-    buttonShader.setMat4("projection", projection);
-
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    DrawItem item = { SortKey::make(PASS_OVERLAY, true, buttonShader.ID, 0, 0, 0.0f, 0.0f, 1.0f), buttonShader.ID, mesh.vertexArray, 0, GL_TRIANGLES, 0, mesh.drawCount(), mesh.dequantize, mesh.indexType, 0 };
+    renderQueue.submit(item);
 }
 
-void renderCube(Shader &cubeShader, unsigned int VAO, glm::vec3 cubePositions[], bool isNegative)
+// advances the cubes by one fixed step of dt seconds
+void simulate(float dt)
 {
     for(unsigned int i = 0 ; i < 10; i++)
     {
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, cubePositions[i]);
-        if(!hasOpenedMenu)
+        previousCubeRotations[i] = cubeRotations[i];
+        if(!hasOpenedMenu && !cubeFrozen[i])
         {
             if(isNegative)
             {
-                cubeRotations[i] -= 0.01f;
+                cubeRotations[i] -= CUBE_ROTATION_SPEED * dt;
             }
             else
             {
-                cubeRotations[i] += 0.01f;
+                cubeRotations[i] += CUBE_ROTATION_SPEED * dt;
             }
         }
-        model = glm::rotate(model, cubeRotations[i], glm::vec3(1.0f, 0.3f, 0.5f));
-        cubeShader.setMat4("model", model);
+    }
+}
 
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+// ray casts from the cursor (or from the middle of the window while the cursor is hidden) into the cube tree and
+// freezes or unfreezes the nearest cube it hits. The tree and matrices are the ones last published, what is on screen.
+// With the id buffer the render thread reads the cube under that pixel instead, see processInput for the answer
+void pickCube(GLFWwindow *window)
+{
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+    if(width <= 0 || height <= 0)
+        return;
+    glm::vec2 at = hasOpenedMenu ? cursorPosition : glm::vec2(width * 0.5f, height * 0.5f);
+    if(objectIdPicking)
+    {
+        // window coordinates to framebuffer pixels, which count from the bottom
+        uint64_t size = framebufferSize.load();
+        int framebufferWidth = static_cast<int>(size >> 32);
+        int framebufferHeight = static_cast<int>(size & 0xFFFFFFFF);
+        glm::ivec2 pixel(static_cast<int>(at.x * framebufferWidth / width), framebufferHeight - 1 - static_cast<int>(at.y * framebufferHeight / height));
+        std::lock_guard<std::mutex> lock(pickMutex);
+        pickRequests.push_back(pixel);
+        return;
     }
+    BvhHit hit;
+    if(ScenePicker::pick(cubeBvh.current(), camera, at.x, at.y, static_cast<float>(width), static_cast<float>(height), cubeModels, CUBE_BOUNDS, hit))
+        cubeFrozen[hit.object] = !cubeFrozen[hit.object];
+}
+
+// queues the visible cubes, at the level of detail the selector picks when the mesh has levels, and hands the ones too
+// small on screen to the impostors; returns the triangles queued. The cubes are split into partitions whose draws
+// (culling, level of detail, sort keys) are recorded across the pool, then merged ahead of the sort
+unsigned int renderCube(const Shader &cubeShader, const MeshBuffers &mesh, unsigned int texture, SceneSnapshot &snapshot, bool useImpostors)
+{
+    // everything the partitions share is brought up to date here, so they only read it: the camera's cached planes and
+    // the selector's per cube levels (each partition only writes its own cubes')
+    snapshot.camera.GetFrustumPlanes();
+    lodSelector.reserve(10);
+    size_t partitions = RenderQueue::partitionCount(10, RECORD_PARTITION_SIZE, threadPool);
+    if(cubePartitions.size() < partitions)
+        cubePartitions.resize(partitions);
+
+    renderQueue.submitPartitioned(10, RECORD_PARTITION_SIZE, threadPool, [&](std::vector<DrawItem> &bucket, size_t partition, size_t begin, size_t end)
+    {
+        CubePartition &result = cubePartitions[partition];
+        result.triangles = 0;
+        result.impostors.clear();
+        for(size_t i = begin; i < end; i++)
+        {
+            glm::vec3 position = glm::vec3(snapshot.cubeModels[i][3]);
+
+            // skip cubes outside the view, 0.87 is the radius of a sphere around a unit cube
+            if(!snapshot.camera.IsSphereVisible(position, 0.87f))
+                continue;
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0 ,36);
-    glBindVertexArray(0);
+            float depth = glm::length(position - snapshot.camera.Position);
+            // the bounding sphere's diameter in pixels
+            if(useImpostors && lodSelector.screenError(2.0f * 0.87f, glm::length(glm::vec3(snapshot.cubeModels[i][0])), depth) < IMPOSTOR_PIXELS)
+            {
+                result.impostors.push_back(static_cast<unsigned int>(i));
+                continue;
+            }
+
+            bucket.push_back(cubeDrawItem(cubeShader, mesh, texture, snapshot, static_cast<unsigned int>(i)));
+            result.triangles += bucket.back().count / 3;
+        }
+    });
+
+    // the impostor batch fills up in cube order; a cube that no longer fits in it is drawn in full after all
+    unsigned int triangles = 0;
+    for(size_t partition = 0; partition < partitions; partition++)
+    {
+        triangles += cubePartitions[partition].triangles;
+        for(unsigned int i : cubePartitions[partition].impostors)
+        {
+            if(impostors.add(snapshot.cubeModels[i]))
+                continue;
+            DrawItem item = cubeDrawItem(cubeShader, mesh, texture, snapshot, i);
+            renderQueue.submit(item);
+            triangles += item.count / 3;
+        }
+    }
+    return triangles;
+}
+
+// the draw of one visible cube, at the level of detail the selector picks for it
+DrawItem cubeDrawItem(const Shader &cubeShader, const MeshBuffers &mesh, unsigned int texture, SceneSnapshot &snapshot, unsigned int cube)
+{
+    // opaque, so the queue draws these front to back
+    float depth = glm::length(glm::vec3(snapshot.cubeModels[cube][3]) - snapshot.camera.Position);
+    // the mesh's positions are quantized to its bounds, dequantizing is folded into the model matrix
+    glm::mat4 model = snapshot.cubeModels[cube] * mesh.dequantize;
+    int first = 0;
+    int count = mesh.drawCount();
+    if(!mesh.lods.empty())
+    {
+        // the distance to the cube's surface, near enough from its bounding sphere
+        const MeshLod &lod = mesh.lods[lodSelector.select(cube, mesh.lods, glm::length(glm::vec3(model[0])), depth - 0.87f)];
+        first = static_cast<int>(lod.firstIndex);
+        count = static_cast<int>(lod.indexCount);
+    }
+    DrawItem item = { SortKey::make(PASS_WORLD, false, cubeShader.ID, 0, texture, depth, snapshot.camera.NearPlane, snapshot.camera.FarPlane), cubeShader.ID, mesh.vertexArray, texture, GL_TRIANGLES, first, count, model, mesh.indexType, cube + 1 };
+    return item;
+}
+
+// the objects that survive the whole-object test are culled again per meshlet, then drawn with one indirect multi-draw each
+void renderMeshlets(const Shader &cubeShader, unsigned int texture, const glm::mat4 &fit, SceneSnapshot &snapshot)
+{
+    glm::mat4 models[10];
+    unsigned int count = 0;
+    for(unsigned int i = 0 ; i < 10; i++)
+    {
+        if(snapshot.camera.IsSphereVisible(glm::vec3(snapshot.cubeModels[i][3]), 0.87f))
+            models[count++] = snapshot.cubeModels[i] * fit;
+    }
+    if(count == 0)
+        return;
+
+    meshletRenderer.cull(glState, meshletCullMode, models, count, snapshot.camera.GetFrustumPlanes(), snapshot.camera.Position);
+    glState.enable(GL_DEPTH_TEST);
+    cubeShader.use(glState);
+    glState.bindTexture(0, GL_TEXTURE_2D, texture);
+    meshletRenderer.draw(glState, glGetUniformLocation(cubeShader.ID, "model"), models, count);
 }
 
-unsigned int createButton()
+// draws the cubes that are (or aren't) static and can shadow the given cascade, with its depth pass already set up;
+// returns how many were drawn. With meshletFit they are drawn from the meshlets like the visible pass does (through the
+// same model matrix, so the shadows line up with what is on screen), otherwise from mesh like renderCube
+unsigned int renderShadowCasters(const Shader &depthShader, const MeshBuffers &mesh, const glm::mat4 *meshletFit, SceneSnapshot &snapshot, unsigned int cascade, bool staticLayer)
+{
+    int modelLocation = meshletFit ? glGetUniformLocation(depthShader.ID, "model") : -1;
+    unsigned int drawn = 0;
+    for(unsigned int i = 0 ; i < 10; i++)
+    {
+        if(snapshot.cubeStatic[i] != staticLayer || !shadowCascades.overlaps(cascade, glm::vec3(snapshot.cubeModels[i][3]), 0.87f))
+            continue;
+        drawn++;
+        if(meshletFit)
+        {
+            meshletRenderer.drawAll(glState, modelLocation, snapshot.cubeModels[i] * *meshletFit);
+            continue;
+        }
+        depthShader.setMat4("model", snapshot.cubeModels[i] * mesh.dequantize);
+        glState.bindVertexArray(mesh.vertexArray);
+        if(mesh.indexType != 0)
+            glDrawElements(GL_TRIANGLES, mesh.drawCount(), mesh.indexType, 0);
+        else
+            glDrawArrays(GL_TRIANGLES, 0, mesh.drawCount());
+    }
+    return drawn;
+}
+
+MeshBuffers createButton()
 {
     float vertices[] = 
     { 
@@ -326,12 +1011,11 @@ unsigned int createButton()
 
 
     buttonPositions.push_back(buttonPosition);
-    unsigned int VAO = createRectangle(vertices, sizeof(vertices));
-    return VAO;
+    return createRectangle(vertices, sizeof(vertices));
 }
 
 
-unsigned int createMenuQuad()
+MeshBuffers createMenuQuad()
 {
     float vertices[] = {
         // positions        // texture coords
@@ -344,34 +1028,42 @@ unsigned int createMenuQuad()
         0.0f,  0.0f, 0.0f,  0.0f, 0.0f
     };
 
-    unsigned int VAO = createRectangle(vertices, sizeof(vertices));
-    return VAO;
+    return createRectangle(vertices, sizeof(vertices));
 
 }
 
-unsigned int createRectangle(float vertices[], unsigned int sizeOfVertices)
+MeshBuffers createRectangle(float vertices[], unsigned int sizeOfVertices)
 {
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeOfVertices, vertices, GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // rows of position and texture coords, repacked to quantized positions and unorm16 texture coords (12 bytes instead of 20)
+    std::vector<MeshVertex> mesh;
+    for(unsigned int i = 0; i < sizeOfVertices / (5 * sizeof(float)); i++)
+    {
+        const float *row = &vertices[i * 5];
+        MeshVertex vertex = { glm::vec3(row[0], row[1], row[2]), glm::vec2(row[3], row[4]), glm::vec3(0.0f, 0.0f, 1.0f) };
+        mesh.push_back(vertex);
+    }
+    return VertexPacker::upload(glState, mesh, VertexFormat::compact(false, false));
+}
 
-    return VAO;
+// scatters LIGHT_COUNT small colored point lights through the box the cubes sit in
+void createLights()
+{
+    clusteredLights.create();
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<PointLight> &lights = clusteredLights.lights();
+    lights.resize(LIGHT_COUNT);
+    for(PointLight &light : lights)
+    {
+        glm::vec3 position = LIGHT_AREA_MIN + (LIGHT_AREA_MAX - LIGHT_AREA_MIN) * glm::vec3(unit(random), unit(random), unit(random));
+        float radius = 1.0f + unit(random);
+        glm::vec3 color = glm::vec3(unit(random), unit(random), unit(random)) * 1.5f;
+        light.positionRadius = glm::vec4(position, radius);
+        light.color = glm::vec4(color, 1.0f);
+    }
 }
 
-unsigned int createCube()
+MeshBuffers createCube()
 {
     float vertices[] = {
         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -417,32 +1109,56 @@ unsigned int createCube()
         -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
     };
 
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    // the faces above in order: back, front, left, right, bottom, top
+    glm::vec3 faceNormals[] = {
+        glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+        glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)
+    };
+
+    std::vector<MeshVertex> mesh;
+    for(unsigned int i = 0; i < 36; i++)
+    {
+        const float *row = &vertices[i * 5];
+        MeshVertex vertex = { glm::vec3(row[0], row[1], row[2]), glm::vec2(row[3], row[4]), faceNormals[i / 6] };
+        mesh.push_back(vertex);
+    }
 
-    glBindVertexArray(VAO);
+    // 16 bytes a vertex with normals, against 20 for the float positions and texture coords alone
+    return VertexPacker::upload(glState, mesh, VertexFormat::compact());
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,  GL_STATIC_DRAW);
+// imports (or reads back from its cache) a mesh and fits it into the unit cube the cubes occupy, falls back to the cube.
+// A large mesh is also split into meshlets for meshletRenderer, meshletFit is then set to its mesh space to cube transform
+MeshBuffers loadMesh(const char *path, glm::mat4 &meshletFit)
+{
+    ImportedMesh imported;
+    if(!MeshImporter::import(path, VertexFormat::compact(true), imported, threadPool))
+        return createCube();
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // texture attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE,  5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    MeshBuffers mesh = MeshImporter::upload(glState, imported);
+    // the quantized positions fill [-1, 1] on their longest axis, half of that is the cube
+    mesh.dequantize = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
 
-    return VAO;
+    if(imported.lods[0].indexCount / 3 >= MESHLET_MIN_TRIANGLES)
+    {
+        MeshData data;
+        MeshImporter::unpack(imported, data);
+        MeshletMesh meshlets;
+        MeshletBuilder::build(data, meshlets);
+        if(meshletRenderer.create(glState, data, meshlets, imported.format, 10, "../include/shaders/meshlet_cull.cs"))
+            meshletFit = mesh.dequantize * glm::inverse(imported.dequantize);
+    }
+    return mesh;
 }
 
-unsigned int generateTexture(const char* texturePath, Shader &ourShader)
+unsigned int generateTexture(const char* texturePath)
 {
     // load and create the texture
     unsigned int texture;
 
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glState.bindTexture(0, GL_TEXTURE_2D, texture);
 
     // set the texture wrapping parameters
     glTextureParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -468,60 +1184,96 @@ unsigned int generateTexture(const char* texturePath, Shader &ourShader)
     }
     stbi_image_free(data);
 
-    ourShader.use();
-    ourShader.setInt("texture1", 0);
-    
     return texture;
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-// ---------------------------------------------------------------------------------------------------------
+// process all input: drain the events that arrived since last frame and react to them
+// ---------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
 {
-    const float cameraSpeed = 2.5f * delaTime;
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-    if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboard(FORWARD, delaTime);
-    if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboard(BACKWARD, delaTime);
-    if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboard(LEFT, delaTime);
-    if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboard(RIGHT, delaTime);
+    if(replaying)
+        input.beginFrame(inputReplay.eventsFor(inputFrame, glfwGetTime()));
+    else
+        input.beginFrame();
+    inputRecorder.record(inputFrame, input.events());
 
-    // Handle menu toggle
-    if(glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !menuKeyPressed)
+    // cubes the render thread found under earlier clicks
+    if(objectIdPicking)
     {
-        hasOpenedMenu = !hasOpenedMenu; // Togle menu state
-        menuKeyPressed = true;
-        
-        if(hasOpenedMenu)
-        {
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-        }
-        else
+        std::lock_guard<std::mutex> lock(pickMutex);
+        for(uint32_t id : pickedIds)
         {
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            if(id >= 1 && id <= 10)
+                cubeFrozen[id - 1] = !cubeFrozen[id - 1];
         }
-    }
-    if(glfwGetKey(window, GLFW_KEY_M) == GLFW_RELEASE)
-    {
-        menuKeyPressed = false; // Reset the key state when released
+        pickedIds.clear();
     }
 
-    // Handle button press
-    if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && inButton)
+    // handled in the order they happened, so a click acts on whatever the cursor was over at that moment
+    for(const InputEvent &event : input.events())
     {
-        if(!buttonPressed)
+        inputTimestamp = std::max(inputTimestamp, event.time);
+        if(event.type == INPUT_CURSOR)
         {
+            cursorPosition = glm::vec2(static_cast<float>(event.x), static_cast<float>(event.y));
+            handleCursor(event.x, event.y);
+        }
+        else if(event.action == GLFW_PRESS && input.matches(event, ACTION_TOGGLE_MENU))
+            toggleMenu(window);
+        else if(event.action == GLFW_PRESS && input.matches(event, ACTION_CLICK) && inButton)
             isNegative = !isNegative;
-            buttonPressed = true;
+        else if(event.action == GLFW_PRESS && input.matches(event, ACTION_CLICK))
+            pickCube(window);
+        else if(event.action == GLFW_PRESS && input.matches(event, ACTION_TOGGLE_LATE_LATCH))
+            lateLatching = !lateLatching;
+    }
 
-        }
+    if(input.isDown(ACTION_QUIT))
+        glfwSetWindowShouldClose(window, true);
+    if(input.isDown(ACTION_FORWARD))
+        camera.ProcessKeyboard(FORWARD, delaTime);
+    if(input.isDown(ACTION_BACKWARD))
+        camera.ProcessKeyboard(BACKWARD, delaTime);
+    if(input.isDown(ACTION_LEFT))
+        camera.ProcessKeyboard(LEFT, delaTime);
+    if(input.isDown(ACTION_RIGHT))
+        camera.ProcessKeyboard(RIGHT, delaTime);
+
+    if(input.scrollOffset() != 0.0)
+        camera.ProcessMouseScroll(static_cast<float>(input.scrollOffset()));
+}
+
+void toggleMenu(GLFWwindow *window)
+{
+    hasOpenedMenu = !hasOpenedMenu; // Togle menu state
+
+    if(hasOpenedMenu)
+    {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
-    if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
+    else
     {
-        buttonPressed = false;
+        inButton = false;
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
 }
+
+// late latch: overwrite this frame's view with the newest cursor position the input callbacks have seen.
+// the snapshot isn't changed, the main thread applies the same motion to the real camera when it processes the events;
+// this only previews it so the frame on screen doesn't lag behind the mouse
+void latchCamera(SceneSnapshot &snapshot, double &frameInputTime)
+{
+    CursorSample cursor;
+    if(!snapshot.latchCursor || !input.latestCursor(cursor))
+        return;
+
+    float xoffset = static_cast<float>(cursor.x) - snapshot.lastX;
+    float yoffset = (SCR_HEIGHT - static_cast<float>(cursor.y)) - snapshot.lastY;
+    if(xoffset == 0.0f && yoffset == 0.0f)
+        return;
+
+    Camera latched = snapshot.camera;
+    latched.ProcessMouseMovement(xoffset, yoffset);
+    cameraUniforms.latchView(latched.GetViewMatrix());
+    frameInputTime = cursor.time;
+}
@@ -0,0 +1,366 @@
+// the BVH's queries and picks against checking every object in turn, and AsyncBvh's background rebuilds
+#include "test_check.h"
+
+#include <camera/camera.h>
+#include <scene/bvh.h>
+#include <scene/picking.h>
+#include <threading/thread_pool.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+const Aabb UNIT_BOX(glm::vec3(-0.5f), glm::vec3(0.5f));
+
+struct Scene
+{
+    std::vector<glm::mat4> models;
+    std::vector<Aabb> boxes;
+};
+
+Scene randomScene(std::mt19937 &random, size_t count, float extent)
+{
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.2f, 2.0f);
+    Scene scene;
+    for(size_t i = 0; i < count; i++)
+    {
+        glm::vec3 axis(unit(random), unit(random), unit(random));
+        if(glm::length(axis) < 0.01f)
+            axis = glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+        model = glm::rotate(model, unit(random) * 3.14159f, glm::normalize(axis));
+        model = glm::scale(model, glm::vec3(size(random)));
+        scene.models.push_back(model);
+        scene.boxes.push_back(Aabb::transformed(model, UNIT_BOX));
+    }
+    return scene;
+}
+
+glm::vec3 randomDirection(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    glm::vec3 direction;
+    do
+        direction = glm::vec3(unit(random), unit(random), unit(random));
+    while(glm::length(direction) < 0.1f);
+    return glm::normalize(direction);
+}
+
+// slab test: where the ray enters box (0 if it starts inside), negative if it misses it within maxDistance
+float rayBox(const Aabb &box, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+{
+    float enter = 0.0f, exit = maxDistance;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        float t1 = (box.min[axis] - origin[axis]) / direction[axis];
+        float t2 = (box.max[axis] - origin[axis]) / direction[axis];
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+    }
+    return enter <= exit ? enter : -1.0f;
+}
+
+// the nearest oriented box the ray hits, by trying all of them
+bool linearPick(const Scene &scene, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, BvhHit &hit)
+{
+    hit.object = Bvh::NO_OBJECT;
+    hit.distance = maxDistance;
+    for(uint32_t i = 0; i < scene.models.size(); i++)
+    {
+        float distance = ScenePicker::rayOrientedBox(scene.models[i], UNIT_BOX, origin, direction);
+        if(distance >= 0.0f && distance <= hit.distance)
+        {
+            hit.object = i;
+            hit.distance = distance;
+        }
+    }
+    return hit.object != Bvh::NO_OBJECT;
+}
+
+bool overlaps(const Aabb &a, const Aabb &b)
+{
+    return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::greaterThanEqual(a.max, b.min));
+}
+
+// the same conservative test the tree makes: outside if the box is wholly behind any one plane
+bool boxInFrustum(const Aabb &box, const glm::vec4 planes[6])
+{
+    for(int p = 0; p < 6; p++)
+    {
+        glm::vec3 corner(planes[p].x > 0.0f ? box.max.x : box.min.x, planes[p].y > 0.0f ? box.max.y : box.min.y, planes[p].z > 0.0f ? box.max.z : box.min.z);
+        if(glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// found holds every object at most once, and exactly those expected() says
+template<typename Expected>
+void checkFound(const std::vector<uint32_t> &found, size_t objectCount, Expected expected)
+{
+    std::vector<uint8_t> seen(objectCount, 0);
+    size_t invalid = 0, duplicates = 0, wrong = 0;
+    for(uint32_t object : found)
+    {
+        if(object >= objectCount)
+        {
+            invalid++;
+            continue;
+        }
+        if(seen[object])
+            duplicates++;
+        seen[object] = 1;
+    }
+    for(uint32_t i = 0; i < objectCount; i++)
+        if((seen[i] != 0) != expected(i))
+            wrong++;
+    CHECK(invalid == 0);
+    CHECK(duplicates == 0);
+    CHECK(wrong == 0);
+}
+
+// ray casts agree with the linear scan on whether a box was hit and how far away; the object only has to match where
+// two boxes aren't entered at the same distance
+void checkRays(const Bvh &bvh, const std::vector<Aabb> &boxes, std::mt19937 &random, float extent)
+{
+    std::uniform_real_distribution<float> position(-extent * 1.5f, extent * 1.5f);
+    for(int ray = 0; ray < 300; ray++)
+    {
+        glm::vec3 origin(position(random), position(random), position(random));
+        glm::vec3 direction = randomDirection(random);
+        float nearest = 1000.0f;
+        bool expectedHit = false;
+        for(const Aabb &box : boxes)
+        {
+            float distance = rayBox(box, origin, direction, nearest);
+            if(distance >= 0.0f)
+            {
+                nearest = distance;
+                expectedHit = true;
+            }
+        }
+        BvhHit hit;
+        bool gotHit = bvh.raycast(origin, direction, 1000.0f, hit);
+        CHECK(gotHit == expectedHit);
+        if(!gotHit || !expectedHit)
+            continue;
+        float tolerance = 1e-4f * std::max(1.0f, nearest);
+        CHECK(std::abs(hit.distance - nearest) <= tolerance);
+        CHECK(hit.object < boxes.size() && std::abs(rayBox(boxes[hit.object], origin, direction, 1000.0f) - nearest) <= tolerance);
+    }
+}
+
+// picks from random rays agree with the linear scan on whether something was hit and how far away; the object only has
+// to match where two boxes aren't hit at the same distance
+void checkPicks(const Bvh &bvh, const Scene &scene, std::mt19937 &random, float extent)
+{
+    std::uniform_real_distribution<float> position(-extent * 1.5f, extent * 1.5f);
+    for(int ray = 0; ray < 150; ray++)
+    {
+        glm::vec3 origin(position(random), position(random), position(random));
+        glm::vec3 direction = randomDirection(random);
+        BvhHit expected, hit;
+        bool expectedHit = linearPick(scene, origin, direction, 1000.0f, expected);
+        bool gotHit = ScenePicker::pick(bvh, origin, direction, 1000.0f, scene.models.data(), UNIT_BOX, hit);
+        CHECK(gotHit == expectedHit);
+        if(!gotHit || !expectedHit)
+            continue;
+        CHECK(std::abs(hit.distance - expected.distance) <= 1e-4f * std::max(1.0f, expected.distance));
+        if(hit.object != expected.object)
+            CHECK(std::abs(ScenePicker::rayOrientedBox(scene.models[hit.object], UNIT_BOX, origin, direction) - expected.distance) <= 1e-4f * std::max(1.0f, expected.distance));
+    }
+}
+
+void checkOverlaps(const Bvh &bvh, const std::vector<Aabb> &boxes, std::mt19937 &random, float extent, int queries = 200)
+{
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> size(0.0f, extent * 0.3f);
+    for(int query = 0; query < queries; query++)
+    {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 half(size(random), size(random), size(random));
+        Aabb box(center - half, center + half);
+        std::vector<uint32_t> found;
+        bvh.queryOverlap(box, found);
+        checkFound(found, boxes.size(), [&](uint32_t i) { return overlaps(boxes[i], box); });
+    }
+}
+
+// frusta from cameras inside the scene, which cut through many nodes, and from far outside it looking back, which see
+// whole subtrees at once (those are collected without testing their objects)
+void checkFrusta(const Bvh &bvh, const std::vector<Aabb> &boxes, std::mt19937 &random, float extent)
+{
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+    std::uniform_real_distribution<float> pitch(-89.0f, 89.0f);
+    std::uniform_real_distribution<float> far(extent * 0.2f, extent * 3.0f);
+    for(int query = 0; query < 100; query++)
+    {
+        Camera camera(glm::vec3(position(random), position(random), position(random)), glm::vec3(0.0f, 1.0f, 0.0f), angle(random), pitch(random));
+        camera.SetPerspective(1.5f, 0.1f, far(random));
+        if(query % 4 == 0)
+        {
+            // looking at the middle from outside, far enough to take in everything
+            camera = Camera(glm::vec3(0.0f, 0.0f, extent * 5.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+            camera.SetPerspective(1.0f, 0.1f, extent * 20.0f);
+        }
+        const glm::vec4 *planes = camera.GetFrustumPlanes();
+        std::vector<uint32_t> found;
+        bvh.queryFrustum(planes, found);
+        checkFound(found, boxes.size(), [&](uint32_t i) { return boxInFrustum(boxes[i], planes); });
+        if(query % 4 == 0)
+            CHECK(found.size() == boxes.size());
+    }
+}
+
+void testEmpty()
+{
+    Bvh bvh;
+    bvh.build(std::vector<Aabb>());
+    BvhHit hit;
+    CHECK(!bvh.raycast(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, hit));
+    CHECK(hit.object == Bvh::NO_OBJECT);
+    std::vector<uint32_t> found;
+    bvh.queryOverlap(Aabb(glm::vec3(-1.0f), glm::vec3(1.0f)), found);
+    CHECK(found.empty());
+    Camera camera;
+    bvh.queryFrustum(camera.GetFrustumPlanes(), found);
+    CHECK(found.empty());
+}
+
+void testAgainstLinearScan()
+{
+    std::mt19937 random(7);
+    const float extent = 30.0f;
+    for(size_t count : { 1u, 3u, 17u, 300u, 3000u })
+    {
+        Scene scene = randomScene(random, count, extent);
+        Bvh bvh;
+        bvh.build(scene.boxes);
+        CHECK(bvh.objectCount() == count);
+        checkRays(bvh, scene.boxes, random, extent);
+        checkOverlaps(bvh, scene.boxes, random, extent);
+        checkFrusta(bvh, scene.boxes, random, extent);
+        checkPicks(bvh, scene, random, extent);
+
+        // moved objects: the refitted tree answers for the new boxes
+        Scene moved = randomScene(random, count, extent);
+        bvh.refit(moved.boxes);
+        CHECK(bvh.cost() >= 0.0f);
+        checkRays(bvh, moved.boxes, random, extent);
+        checkOverlaps(bvh, moved.boxes, random, extent);
+        checkFrusta(bvh, moved.boxes, random, extent);
+        checkPicks(bvh, moved, random, extent);
+    }
+}
+
+// every box nudged a little, like a frame of simulation
+void jitter(std::vector<Aabb> &boxes, std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> step(-0.2f, 0.2f);
+    for(Aabb &box : boxes)
+    {
+        glm::vec3 offset(step(random), step(random), step(random));
+        box = Aabb(box.min + offset, box.max + offset);
+    }
+}
+
+// updates with slightly moved boxes until the tree being rebuilt is swapped in (it's built from boxes a few frames old
+// and gets refitted to the update's), checking queries every frame
+void waitForSwap(AsyncBvh &bvh, std::vector<Aabb> &boxes, ThreadPool &pool, std::mt19937 &random, float extent)
+{
+    bool swapped = false;
+    for(int frame = 0; frame < 5000 && !swapped; frame++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        jitter(boxes, random);
+        bvh.update(boxes, pool);
+        // boxes this close to the ones it was built from don't start another rebuild
+        swapped = !bvh.rebuilding();
+        checkOverlaps(bvh.current(), boxes, random, extent, 5);
+        checkRays(bvh.current(), boxes, random, extent);
+    }
+    CHECK(swapped);
+}
+
+// the background rebuild starts after REBUILD_INTERVAL updates or once refitting made the tree too expensive
+void testAsyncRebuild()
+{
+    std::mt19937 random(11);
+    const float extent = 30.0f;
+    ThreadPool pool(2);
+    AsyncBvh bvh;
+
+    // a new object count is built right away
+    std::vector<Aabb> boxes = randomScene(random, 500, extent).boxes;
+    bvh.update(boxes, pool);
+    CHECK(bvh.current().objectCount() == boxes.size());
+    CHECK(!bvh.rebuilding());
+    checkOverlaps(bvh.current(), boxes, random, extent, 20);
+
+    // objects that stay put never make the tree worse, so only the interval starts a rebuild
+    for(unsigned int i = 1; i < AsyncBvh::REBUILD_INTERVAL; i++)
+        bvh.update(boxes, pool);
+    CHECK(!bvh.rebuilding());
+    bvh.update(boxes, pool);
+    CHECK(bvh.rebuilding());
+
+    // the rebuilt tree comes in on a later update; until then, and from then on, queries answer for the current boxes
+    waitForSwap(bvh, boxes, pool, random, extent);
+
+    // every object somewhere else: the refitted tree is far too loose and the next update starts a rebuild
+    boxes = randomScene(random, boxes.size(), extent).boxes;
+    bvh.update(boxes, pool);
+    CHECK(bvh.current().cost() > bvh.current().buildCost() * BVH_REBUILD_COST_RATIO);
+    CHECK(bvh.rebuilding());
+    checkOverlaps(bvh.current(), boxes, random, extent, 20);
+    waitForSwap(bvh, boxes, pool, random, extent);
+    CHECK(bvh.current().cost() <= bvh.current().buildCost() * BVH_REBUILD_COST_RATIO);
+
+    // a different count is built right away even while a rebuild is running, and the stale tree that rebuild makes
+    // never answers a query
+    boxes = randomScene(random, boxes.size(), extent).boxes;
+    bvh.update(boxes, pool);
+    CHECK(bvh.rebuilding());
+    boxes.resize(120);
+    bvh.update(boxes, pool);
+    CHECK(bvh.current().objectCount() == boxes.size());
+    checkOverlaps(bvh.current(), boxes, random, extent, 20);
+    waitForSwap(bvh, boxes, pool, random, extent);
+    CHECK(bvh.current().objectCount() == boxes.size());
+}
+
+// a ray that starts inside a box hits it at 0, and nothing past maxDistance counts
+void testRayLimits()
+{
+    Scene scene;
+    scene.models.push_back(glm::mat4(1.0f));
+    scene.models.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -10.0f)));
+    for(const glm::mat4 &model : scene.models)
+        scene.boxes.push_back(Aabb::transformed(model, UNIT_BOX));
+    Bvh bvh;
+    bvh.build(scene.boxes);
+
+    BvhHit hit;
+    CHECK(ScenePicker::pick(bvh, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, scene.models.data(), UNIT_BOX, hit));
+    CHECK(hit.object == 0 && hit.distance == 0.0f);
+    CHECK(ScenePicker::pick(bvh, glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 0.0f, -1.0f), 100.0f, scene.models.data(), UNIT_BOX, hit));
+    CHECK(hit.object == 1 && std::abs(hit.distance - 7.5f) < 1e-5f);
+    CHECK(!ScenePicker::pick(bvh, glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 0.0f, -1.0f), 7.0f, scene.models.data(), UNIT_BOX, hit));
+    CHECK(!ScenePicker::pick(bvh, glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.4f, scene.models.data(), UNIT_BOX, hit));
+}
+
+int main()
+{
+    testEmpty();
+    testAgainstLinearScan();
+    testRayLimits();
+    testAsyncRebuild();
+    return testResult();
+}
@@ -0,0 +1,26 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+// the tests are plain executables run by ctest: a CHECK that fails prints where, and main() returns testResult(),
+// non zero once anything failed
+int testFailures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            std::cout << "FAILED " << __FILE__ << ":" << __LINE__ << ": " << #condition << std::endl; \
+            testFailures++; \
+        } \
+    } while(0)
+
+int testResult()
+{
+    if(testFailures > 0)
+        std::cout << testFailures << " checks failed" << std::endl;
+    return testFailures == 0 ? 0 : 1;
+}
+#endif
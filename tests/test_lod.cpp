@@ -0,0 +1,214 @@
+// the simplifier's level of detail chain: fewer triangles every level, errors that never go down, and a closed manifold
+// that stays one
+#include "test_check.h"
+
+#include <mesh/mesh_simplifier.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// an icosahedron split subdivisions times and pushed onto the unit sphere, with shared vertices: closed and manifold
+MeshData icosphere(int subdivisions)
+{
+    const float t = 1.6180339f;
+    std::vector<glm::vec3> positions = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 }, { 0, -1, t }, { 0, 1, t },
+        { 0, -1, -t }, { 0, 1, -t }, { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+    };
+    std::vector<uint32_t> indices = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+    };
+    for(int level = 0; level < subdivisions; level++)
+    {
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+        auto midpoint = [&](uint32_t a, uint32_t b)
+        {
+            std::pair<uint32_t, uint32_t> edge(std::min(a, b), std::max(a, b));
+            auto found = midpoints.find(edge);
+            if(found != midpoints.end())
+                return found->second;
+            positions.push_back((positions[a] + positions[b]) * 0.5f);
+            uint32_t index = static_cast<uint32_t>(positions.size() - 1);
+            midpoints[edge] = index;
+            return index;
+        };
+        std::vector<uint32_t> split;
+        for(size_t i = 0; i < indices.size(); i += 3)
+        {
+            uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            split.insert(split.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+        }
+        indices.swap(split);
+    }
+
+    MeshData mesh;
+    for(const glm::vec3 &position : positions)
+    {
+        glm::vec3 p = glm::normalize(position);
+        MeshVertex vertex = { p, glm::vec2(0.0f), p };
+        mesh.vertices.push_back(vertex);
+    }
+    mesh.indices = indices;
+    return mesh;
+}
+
+// a flat size x size grid of quads, an open mesh with a border
+MeshData grid(uint32_t size)
+{
+    MeshData mesh;
+    for(uint32_t y = 0; y <= size; y++)
+    {
+        for(uint32_t x = 0; x <= size; x++)
+        {
+            MeshVertex vertex = { glm::vec3(static_cast<float>(x), 0.0f, static_cast<float>(y)), glm::vec2(0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for(uint32_t y = 0; y < size; y++)
+    {
+        for(uint32_t x = 0; x < size; x++)
+        {
+            uint32_t a = y * (size + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), { a, a + size + 1, a + 1, a + 1, a + size + 1, a + size + 2 });
+        }
+    }
+    return mesh;
+}
+
+struct Topology
+{
+    bool indicesValid = true;
+    size_t degenerate = 0;
+    // edges used by more than two triangles, or twice in the same direction
+    size_t nonManifold = 0;
+    // edges used by a single triangle
+    size_t border = 0;
+};
+
+Topology topology(const MeshData &mesh, const MeshLod &lod)
+{
+    Topology result;
+    std::map<std::pair<uint32_t, uint32_t>, int> directed;
+    for(uint32_t i = lod.firstIndex; i + 2 < lod.firstIndex + lod.indexCount; i += 3)
+    {
+        uint32_t corners[3] = { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+        for(uint32_t corner : corners)
+            if(corner >= mesh.vertices.size())
+                result.indicesValid = false;
+        if(corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+        {
+            result.degenerate++;
+            continue;
+        }
+        for(int e = 0; e < 3; e++)
+            directed[std::make_pair(corners[e], corners[(e + 1) % 3])]++;
+    }
+    for(const auto &edge : directed)
+    {
+        auto reverse = directed.find(std::make_pair(edge.first.second, edge.first.first));
+        int opposite = reverse == directed.end() ? 0 : reverse->second;
+        if(edge.second > 1 || opposite > 1)
+            result.nonManifold++;
+        else if(opposite == 0)
+            result.border++;
+    }
+    return result;
+}
+
+void checkChain(MeshData mesh, bool closed)
+{
+    size_t baseIndices = mesh.indices.size();
+    std::vector<MeshLod> lods;
+    MeshSimplifier::buildLods(mesh, lods);
+
+    CHECK(lods.size() >= 3);
+    CHECK(lods.size() <= MeshSimplifier::MAX_LODS);
+    CHECK(!lods.empty() && lods[0].firstIndex == 0 && lods[0].indexCount == baseIndices && lods[0].error == 0.0f);
+    for(size_t level = 0; level < lods.size(); level++)
+    {
+        const MeshLod &lod = lods[level];
+        CHECK(lod.indexCount % 3 == 0);
+        CHECK(static_cast<size_t>(lod.firstIndex) + lod.indexCount <= mesh.indices.size());
+        if(level > 0)
+        {
+            // at least a tenth fewer triangles than the level before, and never a smaller error
+            CHECK(static_cast<size_t>(lod.indexCount) * 10 <= static_cast<size_t>(lods[level - 1].indexCount) * 9);
+            CHECK(lod.error >= lods[level - 1].error);
+            CHECK(lod.indexCount / 3 >= MeshSimplifier::MIN_LOD_TRIANGLES / 2);
+        }
+
+        Topology shape = topology(mesh, lod);
+        CHECK(shape.indicesValid);
+        CHECK(shape.degenerate == 0);
+        CHECK(shape.nonManifold == 0);
+        if(closed)
+            CHECK(shape.border == 0);
+    }
+}
+
+// the closest point of triangle abc to p
+glm::vec3 closestOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 normal = glm::cross(b - a, c - a);
+    float area = glm::dot(normal, normal);
+    if(area > 0.0f)
+    {
+        // inside the triangle, the foot of the perpendicular
+        glm::vec3 foot = p - normal * (glm::dot(p - a, normal) / area);
+        float u = glm::dot(glm::cross(c - b, foot - b), normal);
+        float v = glm::dot(glm::cross(a - c, foot - c), normal);
+        float w = glm::dot(glm::cross(b - a, foot - a), normal);
+        if(u >= 0.0f && v >= 0.0f && w >= 0.0f)
+            return foot;
+    }
+    // otherwise on one of the edges
+    glm::vec3 best = a;
+    const glm::vec3 *ends[3][2] = { { &a, &b }, { &b, &c }, { &c, &a } };
+    for(const auto &edge : ends)
+    {
+        glm::vec3 direction = *edge[1] - *edge[0];
+        float length = glm::dot(direction, direction);
+        float t = length > 0.0f ? glm::clamp(glm::dot(p - *edge[0], direction) / length, 0.0f, 1.0f) : 0.0f;
+        glm::vec3 point = *edge[0] + direction * t;
+        if(glm::length(point - p) < glm::length(best - p))
+            best = point;
+    }
+    return best;
+}
+
+// a single simplification lands at or under its target, and no vertex of the original ends up further from the
+// result than the error it reports
+void testSimplify()
+{
+    MeshData sphere = icosphere(3);
+    std::vector<uint32_t> indices;
+    float error = MeshSimplifier::simplify(sphere, 200, indices);
+    CHECK(indices.size() / 3 <= 200);
+    CHECK(indices.size() / 3 >= 100);
+    CHECK(error > 0.0f && error < 0.5f);
+    size_t outside = 0;
+    for(const MeshVertex &vertex : sphere.vertices)
+    {
+        float distance = 1e30f;
+        for(size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            glm::vec3 closest = closestOnTriangle(vertex.position, sphere.vertices[indices[i]].position, sphere.vertices[indices[i + 1]].position,
+                sphere.vertices[indices[i + 2]].position);
+            distance = std::min(distance, glm::length(closest - vertex.position));
+        }
+        if(distance > error + 1e-4f)
+            outside++;
+    }
+    CHECK(outside == 0);
+}
+
+int main()
+{
+    checkChain(icosphere(4), true);
+    checkChain(grid(48), false);
+    testSimplify();
+    return testResult();
+}
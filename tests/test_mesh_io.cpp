@@ -0,0 +1,638 @@
+// the importers against files written here: OBJ and glTF round trips, with and without a pool, malformed files that
+// have to be rejected, the JSON parser on its own and the binary mesh cache
+#include "test_check.h"
+
+#include <mesh/gltf_loader.h>
+#include <mesh/json.h>
+#include <mesh/mesh_importer.h>
+#include <mesh/obj_loader.h>
+#include <threading/thread_pool.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+std::filesystem::path testDirectory;
+
+std::string testPath(const std::string &name)
+{
+    return (testDirectory / name).string();
+}
+
+void writeFile(const std::string &path, const std::string &contents)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+MeshVertex randomVertex(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    MeshVertex vertex;
+    vertex.position = glm::vec3(value(random), value(random), value(random));
+    vertex.texCoord = glm::vec2(unit(random), unit(random));
+    vertex.normal = glm::normalize(glm::vec3(value(random), value(random), value(random)) + glm::vec3(0.0f, 0.0f, 0.01f));
+    return vertex;
+}
+
+bool sameVertex(const MeshVertex &a, const MeshVertex &b, float epsilon)
+{
+    return glm::all(glm::lessThanEqual(glm::abs(a.position - b.position), glm::vec3(epsilon)))
+        && glm::all(glm::lessThanEqual(glm::abs(a.texCoord - b.texCoord), glm::vec2(epsilon)))
+        && glm::all(glm::lessThanEqual(glm::abs(a.normal - b.normal), glm::vec3(epsilon)));
+}
+
+// the loaders weld and renumber, so meshes are compared corner by corner in triangle order
+void checkCorners(const MeshData &mesh, const std::vector<MeshVertex> &corners, float epsilon = 1e-5f)
+{
+    CHECK(mesh.indices.size() == corners.size());
+    if(mesh.indices.size() != corners.size())
+        return;
+    size_t wrong = 0;
+    for(size_t i = 0; i < corners.size(); i++)
+        if(mesh.indices[i] >= mesh.vertices.size() || !sameVertex(mesh.vertices[mesh.indices[i]], corners[i], epsilon))
+            wrong++;
+    CHECK(wrong == 0);
+}
+
+bool identical(const MeshData &a, const MeshData &b)
+{
+    if(a.indices != b.indices || a.vertices.size() != b.vertices.size())
+        return false;
+    for(size_t i = 0; i < a.vertices.size(); i++)
+        if(!sameVertex(a.vertices[i], b.vertices[i], 0.0f))
+            return false;
+    return true;
+}
+
+// a size by size grid of random vertices written as quads, with absolute v/vt/vn indices
+void testObjQuads(ThreadPool &pool)
+{
+    std::mt19937 random(3);
+    const int size = 40;
+    std::vector<MeshVertex> vertices;
+    std::ostringstream obj;
+    obj << std::setprecision(9) << "# grid\no grid\n";
+    for(int i = 0; i < size * size; i++)
+    {
+        vertices.push_back(randomVertex(random));
+        const MeshVertex &v = vertices.back();
+        obj << "v " << v.position.x << " " << v.position.y << " " << v.position.z << "\n";
+        obj << "vt " << v.texCoord.x << " " << v.texCoord.y << "\n";
+        obj << "vn " << v.normal.x << " " << v.normal.y << " " << v.normal.z << "\n";
+    }
+    std::vector<MeshVertex> corners;
+    for(int y = 0; y + 1 < size; y++)
+        for(int x = 0; x + 1 < size; x++)
+        {
+            int quad[4] = { y * size + x, y * size + x + 1, (y + 1) * size + x + 1, (y + 1) * size + x };
+            obj << "f";
+            for(int corner : quad)
+                obj << " " << corner + 1 << "/" << corner + 1 << "/" << corner + 1;
+            obj << "\r\n";
+            // fanned from the first corner
+            for(int c : { 0, 1, 2, 0, 2, 3 })
+                corners.push_back(vertices[quad[c]]);
+        }
+    std::string path = testPath("grid.obj");
+    writeFile(path, obj.str());
+
+    MeshData serial, parallel;
+    CHECK(ObjLoader::load(path, serial));
+    CHECK(ObjLoader::load(path, parallel, &pool));
+    checkCorners(serial, corners);
+    CHECK(identical(serial, parallel));
+    // every corner is shared by up to four quads and welded into one vertex
+    CHECK(serial.vertices.size() == vertices.size());
+}
+
+// a triangle soup where every face refers back to the vertices just before it, large enough to be parsed in many ranges
+void testObjRelative(ThreadPool &pool)
+{
+    std::mt19937 random(5);
+    std::vector<MeshVertex> corners;
+    std::ostringstream obj;
+    obj << std::setprecision(9);
+    for(int triangle = 0; triangle < 20000; triangle++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            corners.push_back(randomVertex(random));
+            const MeshVertex &v = corners.back();
+            obj << "v " << v.position.x << " " << v.position.y << " " << v.position.z << "\n";
+            obj << "vt " << v.texCoord.x << " " << v.texCoord.y << "\n";
+            obj << "vn " << v.normal.x << " " << v.normal.y << " " << v.normal.z << "\n";
+        }
+        obj << "f -3/-3/-3 -2/-2/-2 -1/-1/-1\n";
+    }
+    std::string path = testPath("soup.obj");
+    writeFile(path, obj.str());
+    CHECK(obj.str().size() > 4 * ObjLoader::MIN_RANGE_SIZE);
+
+    MeshData serial, parallel;
+    CHECK(ObjLoader::load(path, serial));
+    CHECK(ObjLoader::load(path, parallel, &pool));
+    checkCorners(serial, corners);
+    CHECK(identical(serial, parallel));
+}
+
+// positions only: the normals are generated, facing the side the triangles wind counter clockwise to
+void testObjGeneratedNormals()
+{
+    std::string path = testPath("flat.obj");
+    writeFile(path, "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n");
+    MeshData mesh;
+    CHECK(ObjLoader::load(path, mesh));
+    CHECK(mesh.indices.size() == 6);
+    CHECK(mesh.vertices.size() == 4);
+    for(const MeshVertex &vertex : mesh.vertices)
+    {
+        CHECK(std::abs(vertex.normal.z - 1.0f) < 1e-5f);
+        CHECK(vertex.texCoord == glm::vec2(0.0f));
+    }
+}
+
+void testObjRejected()
+{
+    MeshData mesh;
+    CHECK(!ObjLoader::load(testPath("missing.obj"), mesh));
+
+    const char *files[] = {
+        // no faces at all
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\n",
+        // past the last vertex
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n",
+        // before the first one
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 -2 -1\n",
+        // OBJ indices start at 1
+        "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n"
+    };
+    std::string path = testPath("bad.obj");
+    for(const char *contents : files)
+    {
+        writeFile(path, contents);
+        CHECK(!ObjLoader::load(path, mesh));
+    }
+}
+
+// a glTF document around one indexed primitive, under a parent node that translates and a child that rotates and
+// scales. bufferUri is written as the buffer's uri, none for the glb's own chunk
+struct GltfAsset
+{
+    std::string json;
+    std::string binary;
+    glm::mat4 transform;
+};
+
+void append(std::string &bytes, const void *data, size_t size)
+{
+    bytes.append(static_cast<const char*>(data), size);
+}
+
+GltfAsset gltfAsset(const MeshData &mesh, bool wideIndices, const std::string &bufferUri)
+{
+    GltfAsset asset;
+    size_t count = mesh.vertices.size();
+    for(const MeshVertex &vertex : mesh.vertices)
+        append(asset.binary, &vertex.position, 12);
+    for(const MeshVertex &vertex : mesh.vertices)
+        append(asset.binary, &vertex.normal, 12);
+    for(const MeshVertex &vertex : mesh.vertices)
+        append(asset.binary, &vertex.texCoord, 8);
+    for(uint32_t index : mesh.indices)
+    {
+        if(wideIndices)
+            append(asset.binary, &index, 4);
+        else
+        {
+            uint16_t narrow = static_cast<uint16_t>(index);
+            append(asset.binary, &narrow, 2);
+        }
+    }
+    size_t indexBytes = mesh.indices.size() * (wideIndices ? 4 : 2);
+    while(asset.binary.size() % 4 != 0)
+        asset.binary += '\0';
+
+    std::ostringstream json;
+    json << "{ \"asset\": { \"version\": \"2.0\" }, \"scene\": 0, \"scenes\": [ { \"nodes\": [ 0 ] } ],\n"
+        << "  \"nodes\": [ { \"translation\": [ 1, -2, 3 ], \"children\": [ 1 ] },\n"
+        << "             { \"mesh\": 0, \"rotation\": [ 0, 0.6, 0, 0.8 ], \"scale\": [ 2, 0.5, 1 ] } ],\n"
+        << "  \"meshes\": [ { \"primitives\": [ { \"attributes\": { \"POSITION\": 0, \"NORMAL\": 1, \"TEXCOORD_0\": 2 }, \"indices\": 3 } ] } ],\n"
+        << "  \"buffers\": [ { \"byteLength\": " << asset.binary.size();
+    if(!bufferUri.empty())
+        json << ", \"uri\": \"" << bufferUri << "\"";
+    json << " } ],\n"
+        << "  \"bufferViews\": [\n"
+        << "    { \"buffer\": 0, \"byteOffset\": 0, \"byteLength\": " << count * 12 << " },\n"
+        << "    { \"buffer\": 0, \"byteOffset\": " << count * 12 << ", \"byteLength\": " << count * 12 << " },\n"
+        << "    { \"buffer\": 0, \"byteOffset\": " << count * 24 << ", \"byteLength\": " << count * 8 << " },\n"
+        << "    { \"buffer\": 0, \"byteOffset\": " << count * 32 << ", \"byteLength\": " << indexBytes << " } ],\n"
+        << "  \"accessors\": [\n"
+        << "    { \"bufferView\": 0, \"componentType\": 5126, \"count\": " << count << ", \"type\": \"VEC3\" },\n"
+        << "    { \"bufferView\": 1, \"componentType\": 5126, \"count\": " << count << ", \"type\": \"VEC3\" },\n"
+        << "    { \"bufferView\": 2, \"componentType\": 5126, \"count\": " << count << ", \"type\": \"VEC2\" },\n"
+        << "    { \"bufferView\": 3, \"componentType\": " << (wideIndices ? 5125 : 5123) << ", \"count\": " << mesh.indices.size() << ", \"type\": \"SCALAR\" } ] }\n";
+    asset.json = json.str();
+    asset.transform = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, -2.0f, 3.0f))
+        * glm::mat4_cast(glm::quat(0.8f, 0.0f, 0.6f, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(2.0f, 0.5f, 1.0f));
+    return asset;
+}
+
+std::string base64(const std::string &bytes)
+{
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for(size_t i = 0; i < bytes.size(); i += 3)
+    {
+        uint32_t bits = static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << 16;
+        if(i + 1 < bytes.size())
+            bits |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i + 1])) << 8;
+        if(i + 2 < bytes.size())
+            bits |= static_cast<unsigned char>(bytes[i + 2]);
+        out += alphabet[(bits >> 18) & 63];
+        out += alphabet[(bits >> 12) & 63];
+        out += i + 1 < bytes.size() ? alphabet[(bits >> 6) & 63] : '=';
+        out += i + 2 < bytes.size() ? alphabet[bits & 63] : '=';
+    }
+    return out;
+}
+
+void appendChunk(std::string &glb, std::string chunk, uint32_t type, char padding)
+{
+    while(chunk.size() % 4 != 0)
+        chunk += padding;
+    uint32_t length = static_cast<uint32_t>(chunk.size());
+    append(glb, &length, 4);
+    append(glb, &type, 4);
+    glb += chunk;
+}
+
+std::string glb(const GltfAsset &asset)
+{
+    std::string file("glTF", 4);
+    uint32_t version = 2, length = 0;
+    append(file, &version, 4);
+    append(file, &length, 4);
+    appendChunk(file, asset.json, 0x4E4F534A, ' ');
+    appendChunk(file, asset.binary, 0x004E4942, '\0');
+    length = static_cast<uint32_t>(file.size());
+    std::memcpy(&file[8], &length, 4);
+    return file;
+}
+
+MeshData randomIndexedMesh(size_t vertexCount, size_t triangleCount, unsigned int seed)
+{
+    std::mt19937 random(seed);
+    MeshData mesh;
+    for(size_t i = 0; i < vertexCount; i++)
+        mesh.vertices.push_back(randomVertex(random));
+    std::uniform_int_distribution<uint32_t> vertex(0, static_cast<uint32_t>(vertexCount - 1));
+    for(size_t i = 0; i < triangleCount * 3; i++)
+        mesh.indices.push_back(vertex(random));
+    return mesh;
+}
+
+// the source's corners moved into the scene by the node transforms
+std::vector<MeshVertex> transformedCorners(const MeshData &mesh, const glm::mat4 &transform)
+{
+    glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+    std::vector<MeshVertex> corners;
+    for(uint32_t index : mesh.indices)
+    {
+        MeshVertex vertex = mesh.vertices[index];
+        vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+        vertex.normal = glm::normalize(normalTransform * vertex.normal);
+        corners.push_back(vertex);
+    }
+    return corners;
+}
+
+void testGltf(ThreadPool &pool)
+{
+    // past 16 bits of indices and past the loader's batch size, so the wide indices and the parallel decode both run
+    MeshData small = randomIndexedMesh(500, 900, 7);
+    MeshData large = randomIndexedMesh(70000, 40000, 11);
+    for(int wide = 0; wide < 2; wide++)
+    {
+        const MeshData &source = wide ? large : small;
+        GltfAsset binary = gltfAsset(source, wide != 0, std::string());
+        GltfAsset embedded = gltfAsset(source, wide != 0, "data:application/octet-stream;base64," + base64(binary.binary));
+        GltfAsset external = gltfAsset(source, wide != 0, "mesh.bin");
+        writeFile(testPath("embedded.gltf"), embedded.json);
+        writeFile(testPath("external.gltf"), external.json);
+        writeFile(testPath("mesh.bin"), external.binary);
+        writeFile(testPath("binary.glb"), glb(binary));
+
+        std::vector<MeshVertex> corners = transformedCorners(source, embedded.transform);
+        for(const char *name : { "embedded.gltf", "external.gltf", "binary.glb" })
+        {
+            MeshData serial, parallel;
+            CHECK(GltfLoader::load(testPath(name), serial));
+            CHECK(GltfLoader::load(testPath(name), parallel, &pool));
+            checkCorners(serial, corners, 1e-4f);
+            CHECK(identical(serial, parallel));
+        }
+    }
+}
+
+void testGltfRejected()
+{
+    MeshData source = randomIndexedMesh(50, 40, 13);
+    GltfAsset asset = gltfAsset(source, false, "mesh.bin");
+    writeFile(testPath("mesh.bin"), asset.binary);
+    std::string path = testPath("bad.gltf");
+    MeshData mesh;
+
+    CHECK(!GltfLoader::load(testPath("missing.gltf"), mesh));
+
+    // sanity: the untouched document loads
+    writeFile(path, asset.json);
+    CHECK(GltfLoader::load(path, mesh));
+
+    // JSON cut off half way
+    writeFile(path, asset.json.substr(0, asset.json.size() / 2));
+    CHECK(!GltfLoader::load(path, mesh));
+
+    // a buffer file that isn't there
+    GltfAsset missingBuffer = gltfAsset(source, false, "nowhere.bin");
+    writeFile(path, missingBuffer.json);
+    CHECK(!GltfLoader::load(path, mesh));
+
+    // a base64 buffer with characters outside the alphabet
+    GltfAsset badBase64 = gltfAsset(source, false, "data:application/octet-stream;base64,AAAA*AAA");
+    writeFile(path, badBase64.json);
+    CHECK(!GltfLoader::load(path, mesh));
+
+    // an index past the last vertex
+    MeshData badIndex = source;
+    badIndex.indices[17] = static_cast<uint32_t>(source.vertices.size());
+    GltfAsset badIndexAsset = gltfAsset(badIndex, false, "bad_index.bin");
+    writeFile(testPath("bad_index.bin"), badIndexAsset.binary);
+    writeFile(path, badIndexAsset.json);
+    CHECK(!GltfLoader::load(path, mesh));
+
+    // a buffer shorter than its views
+    writeFile(testPath("short.bin"), asset.binary.substr(0, asset.binary.size() - 8));
+    GltfAsset shortBuffer = gltfAsset(source, false, "short.bin");
+    writeFile(path, shortBuffer.json);
+    CHECK(!GltfLoader::load(path, mesh));
+
+    // an accessor that counts more elements than its view holds
+    std::string overrun = asset.json;
+    std::string count = "\"count\": " + std::to_string(source.vertices.size());
+    overrun.replace(overrun.find(count), count.size(), "\"count\": " + std::to_string(source.vertices.size() + 1));
+    writeFile(path, overrun);
+    CHECK(!GltfLoader::load(path, mesh));
+
+    // a glb whose chunk claims more bytes than the file has
+    std::string binary = glb(gltfAsset(source, false, std::string()));
+    std::string truncatedPath = testPath("bad.glb");
+    writeFile(truncatedPath, binary.substr(0, binary.size() - 4));
+    CHECK(!GltfLoader::load(truncatedPath, mesh));
+
+    // nothing but the header
+    writeFile(truncatedPath, binary.substr(0, 12));
+    CHECK(!GltfLoader::load(truncatedPath, mesh));
+}
+
+std::string quote(const std::string &text)
+{
+    std::string out = "\"";
+    for(char c : text)
+    {
+        if(c == '"' || c == '\\')
+            out += '\\';
+        if(c == '\n')
+            out += "\\n";
+        else if(c == '\t')
+            out += "\\t";
+        else
+            out += c;
+    }
+    return out + "\"";
+}
+
+// writes a parsed value back out, so a round trip can be compared as text
+std::string serialize(const JsonValue &value)
+{
+    std::ostringstream out;
+    out << std::setprecision(17);
+    switch(value.type)
+    {
+    case JSON_NULL: out << "null"; break;
+    case JSON_BOOL: out << (value.boolean ? "true" : "false"); break;
+    case JSON_NUMBER: out << value.number; break;
+    case JSON_STRING: out << quote(value.string); break;
+    case JSON_ARRAY:
+        out << '[';
+        for(size_t i = 0; i < value.items.size(); i++)
+            out << (i > 0 ? "," : "") << serialize(value.items[i]);
+        out << ']';
+        break;
+    case JSON_OBJECT:
+        out << '{';
+        for(size_t i = 0; i < value.members.size(); i++)
+            out << (i > 0 ? "," : "") << quote(value.members[i].first) << ":" << serialize(value.members[i].second);
+        out << '}';
+        break;
+    }
+    return out.str();
+}
+
+void testJson()
+{
+    const std::string text =
+        "{ \"name\": \"a \\\"quoted\\\" \\\\ name\\n\", \"count\": 42, \"scale\": -1.5e-3,\n"
+        "  \"flags\": [ true, false, null ], \"nested\": { \"empty\": [], \"object\": {} },\n"
+        "  \"unicode\": \"\\u00e9\\u20ac\\u0041\", \"deep\": [ [ [ 1, [ 2 ] ] ] ] }";
+    JsonValue value;
+    CHECK(JsonParser::parse(text, value));
+    CHECK(value.type == JSON_OBJECT);
+    CHECK(value.size() == 7);
+    CHECK(value["name"].string == "a \"quoted\" \\ name\n");
+    CHECK(value["count"].asInt() == 42);
+    CHECK(value["scale"].asNumber() == -1.5e-3);
+    CHECK(value["flags"].size() == 3);
+    CHECK(value["flags"][0].asBool() && !value["flags"][1].asBool(true) && value["flags"][2].type == JSON_NULL);
+    CHECK(value["nested"]["empty"].type == JSON_ARRAY && value["nested"]["empty"].size() == 0);
+    CHECK(value["nested"]["object"].type == JSON_OBJECT && value["nested"]["object"].size() == 0);
+    CHECK(value["unicode"].string == "\xC3\xA9\xE2\x82\xAC" "A");
+    CHECK(value["deep"][0][0][1][0].asInt() == 2);
+    // missing keys and indices chain into null
+    CHECK(value["missing"]["deeper"][3].type == JSON_NULL);
+    CHECK(value["count"].asBool(true));
+    CHECK(value["name"].asNumber(7.0) == 7.0);
+
+    std::string written = serialize(value);
+    JsonValue reparsed;
+    CHECK(JsonParser::parse(written, reparsed));
+    CHECK(serialize(reparsed) == written);
+
+    const char *scalars[] = { "0", "-0.25", "1e10", "\"\"", "true", "null", " [ ] ", "\t{ }\n" };
+    for(const char *scalar : scalars)
+        CHECK(JsonParser::parse(scalar, value));
+
+    const char *malformed[] = {
+        "", " ", "{", "[", "[1,]", "{\"a\":1,}", "{\"a\"}", "{\"a\":}", "{1:2}", "[1 2]", "\"unterminated",
+        "\"escape at the end\\", "[1] x", "{} {}", "tru", "nul", "nan", "-", "[\"a\" : 1]"
+    };
+    for(const char *text : malformed)
+    {
+        bool parsed = JsonParser::parse(text, value);
+        CHECK(!parsed);
+        if(parsed)
+            std::cout << "  accepted: " << text << std::endl;
+    }
+
+    // nesting is capped so a hostile file can't run the parser out of stack
+    std::string shallow = std::string(32, '[') + std::string(32, ']');
+    std::string deep = std::string(100000, '[') + std::string(100000, ']');
+    CHECK(JsonParser::parse(shallow, value));
+    CHECK(!JsonParser::parse(deep, value));
+}
+
+// the first import writes the cache, the second reads it back bit for bit, and a cache whose size doesn't match its
+// header is ignored and rewritten
+void testMeshCache(ThreadPool &pool)
+{
+    std::ostringstream obj;
+    obj << std::setprecision(9);
+    const int size = 33;
+    for(int y = 0; y < size; y++)
+        for(int x = 0; x < size; x++)
+            obj << "v " << x * 0.1f << " " << std::sin(x * 0.3f) * std::cos(y * 0.2f) << " " << y * 0.1f << "\nvt " << x / 32.0f << " " << y / 32.0f << "\n";
+    for(int y = 0; y + 1 < size; y++)
+        for(int x = 0; x + 1 < size; x++)
+        {
+            int a = y * size + x + 1;
+            obj << "f " << a << "/" << a << " " << a + size << "/" << a + size << " " << a + size + 1 << "/" << a + size + 1 << " " << a + 1 << "/" << a + 1 << "\n";
+        }
+    std::string path = testPath("terrain.obj");
+    std::string cachePath = testPath("terrain.cache");
+    writeFile(path, obj.str());
+    std::filesystem::remove(cachePath);
+
+    VertexFormat format = VertexFormat::compact(true);
+    ImportedMesh first;
+    CHECK(MeshImporter::import(path, format, first, &pool, cachePath));
+    CHECK(!first.fromCache);
+    CHECK(first.indexSize == 2);
+    CHECK(first.lods.size() > 1);
+    CHECK(first.lods[0].firstIndex == 0 && first.lods[0].indexCount == (size - 1) * (size - 1) * 6);
+    CHECK(std::filesystem::exists(cachePath));
+
+    auto sameImport = [&](const ImportedMesh &mesh)
+    {
+        return mesh.vertexCount == first.vertexCount && mesh.indexCount == first.indexCount && mesh.indexSize == first.indexSize
+            && mesh.payload == first.payload && mesh.dequantize == first.dequantize && mesh.lods.size() == first.lods.size()
+            && std::equal(mesh.lods.begin(), mesh.lods.end(), first.lods.begin(), [](const MeshLod &a, const MeshLod &b)
+            {
+                return a.firstIndex == b.firstIndex && a.indexCount == b.indexCount && a.error == b.error;
+            });
+    };
+
+    ImportedMesh cached;
+    CHECK(MeshImporter::import(path, format, cached, nullptr, cachePath));
+    CHECK(cached.fromCache);
+    CHECK(sameImport(cached));
+
+    // the geometry survives the packing within the quantization
+    MeshData unpacked;
+    MeshImporter::unpack(cached, unpacked);
+    CHECK(unpacked.vertices.size() == static_cast<size_t>(size * size));
+    float worst = 0.0f;
+    for(const MeshVertex &vertex : unpacked.vertices)
+    {
+        glm::vec3 grid = vertex.position / 0.1f;
+        worst = std::max(worst, std::abs(vertex.position.y - std::sin(std::round(grid.x) * 0.3f) * std::cos(std::round(grid.z) * 0.2f)));
+    }
+    CHECK(worst < 1e-3f);
+
+    // another format can't use the cache
+    ImportedMesh full;
+    CHECK(MeshImporter::import(path, VertexFormat::full(), full, nullptr, cachePath));
+    CHECK(!full.fromCache);
+    CHECK(full.vertexCount == first.vertexCount);
+
+    // the full format's cache is in place now; the compact import rewrites it
+    ImportedMesh rewritten;
+    CHECK(MeshImporter::import(path, format, rewritten, nullptr, cachePath));
+    CHECK(!rewritten.fromCache);
+    uintmax_t cacheSize = std::filesystem::file_size(cachePath);
+
+    // cut short, padded, with a header that claims more levels than there are bytes for, or with an index past the
+    // vertices
+    std::string intact;
+    {
+        std::ifstream file(cachePath, std::ios::binary);
+        intact.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    CHECK(intact.size() == cacheSize);
+    // magic, version, size, time, attribute count and the attributes, counts and index size, dequantize
+    size_t lodCountOffset = 4 + 4 + 8 + 8 + 4 + format.attributes.size() * 8 + 12 + 64;
+    std::string hugeLods = intact;
+    uint32_t lodCount = 0x40000000;
+    std::memcpy(&hugeLods[lodCountOffset], &lodCount, 4);
+    std::string hugeVertices = intact;
+    uint32_t vertexCount = 0x7FFFFFFF;
+    std::memcpy(&hugeVertices[lodCountOffset - 76], &vertexCount, 4);
+    // the payload ends in the 16 bit indices; one of them pointing past the last vertex
+    std::string badIndex = intact;
+    uint16_t pastTheEnd = static_cast<uint16_t>(first.vertexCount);
+    std::memcpy(&badIndex[intact.size() - first.indexBytes() / 2], &pastTheEnd, 2);
+    const std::string corrupted[] = {
+        intact.substr(0, intact.size() - 1),
+        intact.substr(0, lodCountOffset + 2),
+        intact + std::string(7, '\0'),
+        hugeLods,
+        hugeVertices,
+        badIndex,
+        "MSHC"
+    };
+    for(const std::string &cache : corrupted)
+    {
+        writeFile(cachePath, cache);
+        ImportedMesh again;
+        CHECK(MeshImporter::import(path, format, again, nullptr, cachePath));
+        CHECK(!again.fromCache);
+        CHECK(again.payload == first.payload);
+        CHECK(std::filesystem::file_size(cachePath) == cacheSize);
+    }
+
+    // a changed source isn't served from the old cache
+    writeFile(path, obj.str() + "# edited\n");
+    ImportedMesh edited;
+    CHECK(MeshImporter::import(path, format, edited, nullptr, cachePath));
+    CHECK(!edited.fromCache);
+
+    CHECK(!MeshImporter::import(testPath("missing.obj"), format, edited, nullptr, cachePath));
+}
+
+int main()
+{
+    testDirectory = std::filesystem::temp_directory_path() / "learning_opengl_test_mesh_io";
+    std::filesystem::remove_all(testDirectory);
+    std::filesystem::create_directories(testDirectory);
+
+    ThreadPool pool(4);
+    testObjQuads(pool);
+    testObjRelative(pool);
+    testObjGeneratedNormals();
+    testObjRejected();
+    testGltf(pool);
+    testGltfRejected();
+    testJson();
+    testMeshCache(pool);
+
+    std::filesystem::remove_all(testDirectory);
+    return testResult();
+}
@@ -0,0 +1,166 @@
+// the meshlet builder: limits, every triangle exactly once, bounds that hold every vertex, and cones that only cull
+// meshlets that really face away
+#include "test_check.h"
+
+#include <mesh/meshlet_builder.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// a closed, bumpy surface: a sphere whose radius changes with direction, so neighbouring meshlets face different ways
+MeshData bumpySphere(uint32_t rings, uint32_t segments)
+{
+    MeshData mesh;
+    for(uint32_t ring = 0; ring <= rings; ring++)
+    {
+        for(uint32_t segment = 0; segment <= segments; segment++)
+        {
+            float v = static_cast<float>(ring) / rings * 3.14159265f;
+            float u = static_cast<float>(segment) / segments * 6.2831853f;
+            glm::vec3 direction(std::sin(v) * std::cos(u), std::cos(v), std::sin(v) * std::sin(u));
+            float radius = 1.0f + 0.15f * std::sin(u * 5.0f) * std::sin(v * 4.0f);
+            MeshVertex vertex = { direction * radius, glm::vec2(u, v), direction };
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for(uint32_t ring = 0; ring < rings; ring++)
+    {
+        for(uint32_t segment = 0; segment < segments; segment++)
+        {
+            uint32_t a = ring * (segments + 1) + segment;
+            uint32_t b = a + segments + 1;
+            // the rows at the poles are single points, leave out their zero area halves
+            if(ring > 0)
+                mesh.indices.insert(mesh.indices.end(), { a, a + 1, b });
+            if(ring + 1 < rings)
+                mesh.indices.insert(mesh.indices.end(), { a + 1, b + 1, b });
+        }
+    }
+    return mesh;
+}
+
+// a triangle with its corners rotated so the smallest index comes first, the winding kept
+std::array<uint32_t, 3> canonical(uint32_t a, uint32_t b, uint32_t c)
+{
+    if(b < a && b < c)
+        return { b, c, a };
+    if(c < a && c < b)
+        return { c, a, b };
+    return { a, b, c };
+}
+
+void checkMeshlets(const MeshData &mesh, uint32_t maxVertices, uint32_t maxTriangles)
+{
+    MeshletMesh out;
+    MeshletBuilder::build(mesh, out, maxVertices, maxTriangles);
+    CHECK(!out.meshlets.empty());
+    CHECK(out.bounds.size() == out.meshlets.size());
+
+    std::vector<std::array<uint32_t, 3>> expected, built;
+    for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+        expected.push_back(canonical(mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]));
+
+    uint32_t vertexOffset = 0, triangleOffset = 0;
+    size_t badBounds = 0;
+    for(size_t m = 0; m < out.meshlets.size(); m++)
+    {
+        const Meshlet &meshlet = out.meshlets[m];
+        CHECK(meshlet.vertexCount > 0 && meshlet.vertexCount <= maxVertices);
+        CHECK(meshlet.triangleCount > 0 && meshlet.triangleCount <= maxTriangles);
+        // packed one after the other
+        CHECK(meshlet.vertexOffset == vertexOffset);
+        CHECK(meshlet.triangleOffset == triangleOffset);
+        vertexOffset += meshlet.vertexCount;
+        triangleOffset += meshlet.triangleCount;
+        if(meshlet.vertexOffset + meshlet.vertexCount > out.vertices.size() || (meshlet.triangleOffset + meshlet.triangleCount) * 3 > out.triangles.size())
+        {
+            CHECK(false);
+            continue;
+        }
+
+        for(uint32_t t = 0; t < meshlet.triangleCount; t++)
+        {
+            uint32_t corners[3];
+            for(int corner = 0; corner < 3; corner++)
+            {
+                uint8_t local = out.triangles[(meshlet.triangleOffset + t) * 3 + corner];
+                CHECK(local < meshlet.vertexCount);
+                corners[corner] = out.vertices[meshlet.vertexOffset + std::min<uint32_t>(local, meshlet.vertexCount - 1)];
+            }
+            built.push_back(canonical(corners[0], corners[1], corners[2]));
+        }
+
+        const MeshletBounds &bounds = out.bounds[m];
+        for(uint32_t v = 0; v < meshlet.vertexCount; v++)
+            if(glm::length(mesh.vertices[out.vertices[meshlet.vertexOffset + v]].position - bounds.center) > bounds.radius * 1.0001f + 1e-5f)
+                badBounds++;
+    }
+    CHECK(vertexOffset == out.vertices.size());
+    CHECK(triangleOffset * 3 == out.triangles.size());
+    CHECK(badBounds == 0);
+
+    // the same triangles with the same winding, each once
+    std::sort(expected.begin(), expected.end());
+    std::sort(built.begin(), built.end());
+    CHECK(built == expected);
+}
+
+// from random camera positions: whenever a cone says its meshlet faces away, every triangle of it has to face away
+void checkCones(const MeshData &mesh)
+{
+    MeshletMesh out;
+    MeshletBuilder::build(mesh, out);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    size_t culled = 0, wrong = 0, cullable = 0;
+    for(size_t m = 0; m < out.meshlets.size(); m++)
+    {
+        const Meshlet &meshlet = out.meshlets[m];
+        const MeshletBounds &bounds = out.bounds[m];
+        CHECK(bounds.coneCutoff <= 1.0f);
+        if(bounds.coneCutoff >= 1.0f)
+            continue;
+        cullable++;
+        CHECK(std::abs(glm::length(bounds.coneAxis) - 1.0f) < 1e-3f);
+        for(int view = 0; view < 200; view++)
+        {
+            glm::vec3 camera = glm::vec3(unit(random), unit(random), unit(random)) * 4.0f;
+            glm::vec3 toApex = bounds.coneApex - camera;
+            if(glm::length(toApex) == 0.0f || glm::dot(glm::normalize(toApex), bounds.coneAxis) < bounds.coneCutoff)
+                continue;
+            culled++;
+            for(uint32_t t = 0; t < meshlet.triangleCount; t++)
+            {
+                glm::vec3 p[3];
+                for(int corner = 0; corner < 3; corner++)
+                    p[corner] = mesh.vertices[out.vertices[meshlet.vertexOffset + out.triangles[(meshlet.triangleOffset + t) * 3 + corner]]].position;
+                glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+                // seen from the front when the camera is on the side the normal points to
+                if(glm::dot(normal, camera - p[0]) > 1e-6f * glm::length(normal))
+                    wrong++;
+            }
+        }
+    }
+    // the surface is smooth enough that most meshlets get a cone, and some views get culled
+    CHECK(cullable * 2 > out.meshlets.size());
+    CHECK(culled > 0);
+    CHECK(wrong == 0);
+}
+
+int main()
+{
+    MeshData sphere = bumpySphere(48, 96);
+    checkMeshlets(sphere, MeshletBuilder::MAX_VERTICES, MeshletBuilder::MAX_TRIANGLES);
+    checkMeshlets(sphere, 16, 8);
+    checkMeshlets(sphere, 3, 1);
+    checkCones(sphere);
+
+    // nothing to cluster
+    MeshletMesh empty;
+    MeshletBuilder::build(MeshData(), empty);
+    CHECK(empty.meshlets.empty());
+    return testResult();
+}
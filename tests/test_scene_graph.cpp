@@ -0,0 +1,141 @@
+// the scene graph's world matrices against multiplying the hierarchy out with glm, through edits, reparenting and the
+// parallel path
+#include "test_check.h"
+
+#include <scene/scene_graph.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+struct Local
+{
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+struct Reference
+{
+    std::vector<uint32_t> parents;
+    std::vector<Local> locals;
+
+    glm::mat4 world(uint32_t node) const
+    {
+        const Local &local = locals[node];
+        glm::mat4 matrix = glm::translate(glm::mat4(1.0f), local.position) * glm::mat4_cast(local.rotation) * glm::scale(glm::mat4(1.0f), local.scale);
+        return parents[node] == SceneGraph::NO_PARENT ? matrix : world(parents[node]) * matrix;
+    }
+};
+
+Local randomLocal(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.5f, 1.5f);
+    glm::vec3 axis(unit(random), unit(random), unit(random) + 2.0f);
+    Local local = { glm::vec3(unit(random), unit(random), unit(random)) * 3.0f, glm::angleAxis(unit(random) * 3.0f, glm::normalize(axis)),
+        glm::vec3(size(random), size(random), size(random)) };
+    return local;
+}
+
+bool near(const glm::mat4 &a, const glm::mat4 &b)
+{
+    for(int column = 0; column < 4; column++)
+        for(int row = 0; row < 4; row++)
+            if(std::abs(a[column][row] - b[column][row]) > 1e-3f * std::max(1.0f, std::abs(b[column][row])))
+                return false;
+    return true;
+}
+
+void checkWorlds(const SceneGraph &graph, const Reference &reference)
+{
+    size_t wrong = 0;
+    for(uint32_t node = 0; node < reference.parents.size(); node++)
+        if(!near(graph.world(node), reference.world(node)))
+            wrong++;
+    CHECK(wrong == 0);
+}
+
+bool isAncestor(const Reference &reference, uint32_t ancestor, uint32_t node)
+{
+    for(uint32_t at = node; at != SceneGraph::NO_PARENT; at = reference.parents[at])
+        if(at == ancestor)
+            return true;
+    return false;
+}
+
+// parents are created before their children here, but reparenting later breaks that order on purpose
+void testHierarchy(ThreadPool *pool, size_t count)
+{
+    std::mt19937 random(11);
+    SceneGraph graph;
+    Reference reference;
+    for(uint32_t node = 0; node < count; node++)
+    {
+        uint32_t parent = node == 0 || random() % 8 == 0 ? SceneGraph::NO_PARENT : static_cast<uint32_t>(random() % node);
+        CHECK(graph.create(parent) == node);
+        reference.parents.push_back(parent);
+        Local local = randomLocal(random);
+        reference.locals.push_back(local);
+        graph.setLocal(node, local.position, local.rotation, local.scale);
+    }
+    graph.update(pool);
+    CHECK(graph.size() == count);
+    CHECK(graph.updatedCount() == count);
+    checkWorlds(graph, reference);
+
+    // nothing changed, nothing recomputed
+    graph.update(pool);
+    CHECK(graph.updatedCount() == 0);
+    // the same value again doesn't count as a change
+    graph.setLocal(0, reference.locals[0].position, reference.locals[0].rotation, reference.locals[0].scale);
+    graph.update(pool);
+    CHECK(graph.updatedCount() == 0);
+
+    // one node moves: it and everything below it, nothing else
+    uint32_t moved = static_cast<uint32_t>(count / 3);
+    reference.locals[moved] = randomLocal(random);
+    graph.setLocal(moved, reference.locals[moved].position, reference.locals[moved].rotation, reference.locals[moved].scale);
+    graph.update(pool);
+    size_t below = 0;
+    for(uint32_t node = 0; node < count; node++)
+        below += isAncestor(reference, moved, node) ? 1 : 0;
+    CHECK(graph.updatedCount() == below);
+    checkWorlds(graph, reference);
+
+    // a batch of edits and moves to other parents (never under the node itself or its descendants)
+    for(int edit = 0; edit < 200; edit++)
+    {
+        uint32_t node = static_cast<uint32_t>(random() % count);
+        if(edit % 4 == 0)
+        {
+            uint32_t parent = static_cast<uint32_t>(random() % count);
+            if(isAncestor(reference, node, parent))
+                parent = SceneGraph::NO_PARENT;
+            graph.setParent(node, parent);
+            reference.parents[node] = parent;
+            CHECK(graph.parent(node) == parent);
+        }
+        else
+        {
+            reference.locals[node] = randomLocal(random);
+            graph.setLocal(node, reference.locals[node].position, reference.locals[node].rotation, reference.locals[node].scale);
+        }
+    }
+    graph.update(pool);
+    checkWorlds(graph, reference);
+    graph.update(pool);
+    CHECK(graph.updatedCount() == 0);
+}
+
+int main()
+{
+    testHierarchy(nullptr, 50);
+    testHierarchy(nullptr, 5000);
+    ThreadPool pool(3);
+    testHierarchy(&pool, 5000);
+    testHierarchy(&pool, 20000);
+    return testResult();
+}
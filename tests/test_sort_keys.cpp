@@ -0,0 +1,138 @@
+// the order SortKey puts draws in, and the render queue's radix sort against std::stable_sort
+#include "test_check.h"
+
+#include <renderer/render_queue.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+
+uint64_t opaque(unsigned int pass, unsigned int program, unsigned int texture, float depth)
+{
+    return SortKey::make(pass, false, program, 0, texture, depth, NEAR_PLANE, FAR_PLANE);
+}
+
+uint64_t translucent(unsigned int pass, unsigned int program, float depth)
+{
+    return SortKey::make(pass, true, program, 0, 0, depth, NEAR_PLANE, FAR_PLANE);
+}
+
+void testKeyOrder()
+{
+    // passes go in order whatever else differs
+    CHECK(opaque(PASS_WORLD, 2047, 4095, FAR_PLANE) < opaque(PASS_OVERLAY, 0, 0, NEAR_PLANE));
+    CHECK(translucent(PASS_WORLD, 5, NEAR_PLANE) < opaque(PASS_OVERLAY, 0, 0, FAR_PLANE));
+    CHECK(SortKey::pass(opaque(PASS_OVERLAY, 7, 3, 5.0f)) == PASS_OVERLAY);
+    CHECK(SortKey::pass(translucent(PASS_WORLD, 7, 5.0f)) == PASS_WORLD);
+
+    // opaque: grouped by program, then texture, then front to back
+    CHECK(opaque(PASS_WORLD, 1, 9, 90.0f) < opaque(PASS_WORLD, 2, 1, 1.0f));
+    CHECK(opaque(PASS_WORLD, 1, 1, 90.0f) < opaque(PASS_WORLD, 1, 2, 1.0f));
+    CHECK(opaque(PASS_WORLD, 1, 1, 1.0f) < opaque(PASS_WORLD, 1, 1, 2.0f));
+
+    // translucent: after every opaque draw of the pass, back to front
+    CHECK(opaque(PASS_WORLD, 2047, 4095, FAR_PLANE) < translucent(PASS_WORLD, 0, FAR_PLANE));
+    CHECK(translucent(PASS_WORLD, 1, 50.0f) < translucent(PASS_WORLD, 1, 10.0f));
+    CHECK(translucent(PASS_WORLD, 9, 50.0f) < translucent(PASS_WORLD, 1, 10.0f));
+
+    // depths outside the planes clamp to them
+    CHECK(opaque(PASS_WORLD, 1, 1, -5.0f) == opaque(PASS_WORLD, 1, 1, NEAR_PLANE));
+    CHECK(opaque(PASS_WORLD, 1, 1, 1000.0f) == opaque(PASS_WORLD, 1, 1, FAR_PLANE));
+
+    // depths a little apart still get keys apart
+    std::vector<uint64_t> keys;
+    for(float depth = NEAR_PLANE; depth < FAR_PLANE; depth += 0.01f)
+        keys.push_back(opaque(PASS_WORLD, 3, 3, depth));
+    CHECK(std::adjacent_find(keys.begin(), keys.end(), [](uint64_t a, uint64_t b) { return a >= b; }) == keys.end());
+}
+
+DrawItem itemWithKey(uint64_t key, int tag)
+{
+    DrawItem item = {};
+    item.key = key;
+    item.first = tag;
+    return item;
+}
+
+// sorted like a stable sort on the keys: equal keys keep the order they were submitted in
+void checkSort(RenderQueue &queue, const std::vector<DrawItem> &submitted)
+{
+    std::vector<DrawItem> expected = submitted;
+    std::stable_sort(expected.begin(), expected.end(), [](const DrawItem &a, const DrawItem &b) { return a.key < b.key; });
+    queue.sort();
+    CHECK(queue.size() == expected.size());
+    size_t wrong = 0;
+    for(size_t i = 0; i < expected.size(); i++)
+        if(queue.sorted(i).key != expected[i].key || queue.sorted(i).first != expected[i].first)
+            wrong++;
+    CHECK(wrong == 0);
+}
+
+void testQueueSort()
+{
+    std::mt19937_64 random(5);
+    RenderQueue queue;
+    for(size_t count : { 0u, 1u, 2u, 100u, 10000u })
+    {
+        // full width random keys, then realistic ones where most bytes are the same (the sort skips those passes)
+        for(int realistic = 0; realistic < 2; realistic++)
+        {
+            std::vector<DrawItem> submitted;
+            queue.clear();
+            for(size_t i = 0; i < count; i++)
+            {
+                uint64_t key = realistic ? opaque(PASS_WORLD, 1 + random() % 3, 1, static_cast<float>(random() % 1000) * 0.1f) : random();
+                // plenty of duplicates, to see the sort is stable
+                if(i % 5 == 0 && i > 0)
+                    key = submitted[random() % i].key;
+                submitted.push_back(itemWithKey(key, static_cast<int>(i)));
+                queue.submit(submitted.back());
+            }
+            checkSort(queue, submitted);
+        }
+    }
+}
+
+// recording the draws in partitions on the pool queues the same draws in the same order as recording them in one go
+void testPartitionedRecording()
+{
+    std::mt19937_64 random(9);
+    ThreadPool pool(3);
+    for(size_t count : { 0u, 5u, 1000u, 50000u })
+    {
+        std::vector<uint64_t> keys(count);
+        for(uint64_t &key : keys)
+            key = random() % 64;
+        auto record = [&](std::vector<DrawItem> &bucket, size_t, size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; i++)
+                if(keys[i] % 3 != 0)
+                    bucket.push_back(itemWithKey(keys[i], static_cast<int>(i)));
+        };
+        RenderQueue serial, partitioned;
+        serial.submitPartitioned(count, 64, nullptr, record);
+        partitioned.submitPartitioned(count, 64, &pool, record);
+        CHECK(serial.size() == partitioned.size());
+        serial.sort();
+        partitioned.sort();
+        size_t wrong = 0;
+        for(size_t i = 0; i < serial.size() && i < partitioned.size(); i++)
+            if(serial.sorted(i).first != partitioned.sorted(i).first)
+                wrong++;
+        CHECK(wrong == 0);
+    }
+    CHECK(RenderQueue::partitionCount(100000, 64, nullptr) == 1);
+    CHECK(RenderQueue::partitionCount(100000, 64, &pool) == pool.size());
+    CHECK(RenderQueue::partitionCount(10, 64, &pool) == 1);
+}
+
+int main()
+{
+    testKeyOrder();
+    testQueueSort();
+    testPartitionedRecording();
+    return testResult();
+}